@@ -16,11 +16,12 @@
 #include "BinaryFile.h"
 #include "frontend.h"
 #include "signature.h"
-//#include "transformer.h"
+#include "transformer.h"
 #include "log.h"
 #include "xmlprogparser.h"
 #include "codegen/chllcode.h"
 #include "project.h"
+#include "decompilestats.h"
 
 // For the -nG switch to disable the garbage collector
 #ifdef HAVE_LIBGC
@@ -28,10 +29,18 @@
 #endif
 
 #include <QtCore/QDebug>
+#include <QtCore/QMutex>
+#include <QtCore/QSaveFile>
 #include <ctime>
 
 Boomerang *Boomerang::boomerang = nullptr;
 
+namespace {
+//! Per-thread replacements for LogStream/ErrStream, set while a worker thread decompiles procedures.
+thread_local QTextStream *threadLogStream = nullptr;
+thread_local QTextStream *threadErrStream = nullptr;
+}
+
 /**
  * Initializes the Boomerang object.
  * The default settings are:
@@ -58,12 +67,9 @@ Log &Boomerang::log() { return *logger; }
 SeparateLogger Boomerang::separate_log(const QString &v) { return SeparateLogger(v); }
 Log &Boomerang::if_verbose_log(int verbosity_level) {
     static NullLogger null_log;
-    if (verbosity_level == 2)
+    if (isVerboseLogged(verbosity_level))
         return *logger;
-    if ((verbosity_level == 1) && VERBOSE)
-        return *logger;
-    else
-        return null_log;
+    return null_log;
 }
 
 void Boomerang::setLogger(Log *l) {
@@ -71,18 +77,29 @@ void Boomerang::setLogger(Log *l) {
     logger = l;
 }
 
+/**
+ * Log to the file "log" in the output directory, and have a crash write out what is still queued for the log files
+ * (the signal handlers for that are process wide, so they are installed here rather than by the log writer).
+ */
+void Boomerang::startFileLog() {
+    setLogger(new FileLogger());
+    LogWriter::installCrashHandlers();
+}
+
 /**
  * Sets the outputfile to be the file "log" in the default output directory.
  */
-FileLogger::FileLogger() : out((Boomerang::get()->getOutputPath() + "log").toStdString()) {}
+FileLogger::FileLogger() : channel(LogWriter::get().open(Boomerang::get()->getOutputPath() + "log")) {}
 
 SeparateLogger::SeparateLogger(const QString &v) {
     static QMap<QString, int> versions;
+    static QMutex versions_lock;
+    QMutexLocker lock(&versions_lock);
     if (!versions.contains(v))
         versions[v] = 0;
     QDir outDir(Boomerang::get()->getOutputPath());
     QString full_path = outDir.absoluteFilePath(QString("%1_%2.log").arg(v).arg(versions[v]++, 2, 10, QChar('0')));
-    out = new std::ofstream(full_path.toStdString());
+    channel = LogWriter::get().open(full_path);
 }
 
 /**
@@ -220,18 +237,16 @@ int Boomerang::processCommand(QStringList &args) {
             return 1;
         }
         QString fname = args[1];
-        assert(!"TODO: use cereal");
-//        XMLProgParser *p = new XMLProgParser();
-//        Prog *pr = p->parse(fname);
-//        if (pr == nullptr) {
-//            // try guessing
-//            pr = p->parse(outputPath + fname + "/" + fname + ".xml");
-//            if (pr == nullptr) {
-//                err_stream << "failed to read xml " << fname << "\n";
-//                return 1;
-//            }
-//        }
-//        prog = pr;
+        Prog *pr = loadProject(fname);
+        if (pr == nullptr) {
+            // try guessing
+            pr = loadProject(outputPath + fname + "/" + fname + ".bpj");
+            if (pr == nullptr) {
+                err_stream << "failed to read project " << fname << "\n";
+                return 1;
+            }
+        }
+        prog = pr;
         break;
     }
     case CT_save: {
@@ -239,9 +254,10 @@ int Boomerang::processCommand(QStringList &args) {
             err_stream << "need to load or decode before save!\n";
             return 1;
         }
-        assert(!"TODO: use cereal");
-//        XMLProgParser *p = new XMLProgParser();
-//        p->persistToXML(prog);
+        if (!saveProject(prog)) {
+            err_stream << "failed to save project\n";
+            return 1;
+        }
         break;
     }
     case CT_decompile: {
@@ -628,7 +644,7 @@ bool Boomerang::setOutputDirectory(const QString &path) {
         return false;
     }
     if (logger == nullptr)
-        setLogger(new FileLogger());
+        startFileLog();
     return true;
 }
 
@@ -671,6 +687,26 @@ void Boomerang::objcDecode(const std::map<QString, ObjcModule> &modules, Prog *p
     LOG_VERBOSE(1) << "\n";
 }
 
+/**
+ * Adds the symbols given with -s, reads the library catalog and the symbol files given with -sf.
+ *
+ * \param prog The program, with \a fe as its front end.
+ * \param fe The front end of the loaded executable.
+ */
+void Boomerang::loadSymbols(Prog *prog, FrontEnd *fe) {
+    QTextStream q_cout(stdout);
+    // Add symbols from -s switch(es)
+    for (const std::pair<ADDRESS,QString > &elem : symbols) {
+        fe->AddSymbol(elem.first, elem.second);
+    }
+    fe->readLibraryCatalog(); // Needed before readSymbolFile()
+
+    for (auto &elem : symbolFiles) {
+        q_cout << "reading symbol file " << elem << "\n";
+        prog->readSymbolFile(elem);
+    }
+}
+
 /**
  * Loads the executable file and decodes it.
  *
@@ -689,17 +725,7 @@ Prog *Boomerang::loadAndDecode(const QString &fname, const char *pname) {
         return nullptr;
     }
     prog->setFrontEnd(fe);
-
-    // Add symbols from -s switch(es)
-    for (const std::pair<ADDRESS,QString > &elem : symbols) {
-        fe->AddSymbol(elem.first, elem.second);
-    }
-    fe->readLibraryCatalog(); // Needed before readSymbolFile()
-
-    for (auto &elem : symbolFiles) {
-        q_cout << "reading symbol file " << elem << "\n";
-        prog->readSymbolFile(elem);
-    }
+    loadSymbols(prog, fe);
     ObjcAccessInterface *objc = qobject_cast<ObjcAccessInterface *>(fe->getBinaryFile());
     if (objc) {
         std::map<QString, ObjcModule> &objcmodules(objc->getObjcModules());
@@ -760,17 +786,19 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
     time_t start;
     time(&start);
     if (logger == nullptr)
-        setLogger(new FileLogger());
+        startFileLog();
     QTextStream q_cout(stdout);
 
-//    std::cout << "setting up transformers...\n";
-//    ExpTransformer::loadAll();
+    if (useRules) {
+        LOG_STREAM() << "setting up transformers...\n";
+        ExpTransformer::loadAll();
+    }
 
     if (loadBeforeDecompile) {
         LOG_STREAM() << "loading persisted state...\n";
-        assert(!"TODO: use cereal");
-//        XMLProgParser *p = new XMLProgParser();
-//        prog = p->parse(fname);
+        prog = loadProject(fname);
+        if (prog == nullptr)
+            return 1;
     } else
     {
         prog = loadAndDecode(fname, pname);
@@ -780,9 +808,8 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
 
     if (saveBeforeDecompile) {
         LOG_STREAM() << "saving persistable state...\n";
-        assert(!"TODO: use cereal");
-//        XMLProgParser *p = new XMLProgParser();
-//        p->persistToXML(prog);
+        if (!saveProject(prog))
+            LOG_STREAM() << "failed to save persistable state\n";
     }
 
     if (stopBeforeDecompile)
@@ -798,7 +825,7 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
         LOG_STREAM() << "printing AST...\n";
         for(const Module *module : *prog) {
             for(Function *func : *module) {
-                if (!func->isLib()) {
+                if (!func->isLib() && !((UserProc *)func)->isReleased()) {
                     UserProc *u = (UserProc *)func;
                     u->getCFG()->compressCfg();
                     u->printAST();
@@ -810,6 +837,11 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
     prog->generateCode();
 
     q_cout << "output written to " << outputPath << prog->getRootCluster()->getName() << "\n";
+    if (DecompileStats *stats = prog->getStats()) {
+        QString path = prog->getRootCluster()->getOutPath("stats.json");
+        if (stats->writeJson(path))
+            q_cout << "statistics written to " << path << "\n";
+    }
 
     time_t end;
     time(&end);
@@ -827,26 +859,39 @@ int Boomerang::decompile(const QString &fname, const char *pname) {
 }
 
 /**
- * Saves the state of the Prog object to a XML file.
- * \param prog The Prog object to save.
+ * Saves the state of the Prog object to a project file, <output>/<name>/<name>.bpj.
+ * \param prog The Prog object to save; it must not have been decompiled yet.
+ * \return True on success.
  */
-void Boomerang::persistToXML(Prog *prog) {
-    assert(!"TODO: use cereal");
-//    LOG << "saving persistable state...\n";
-//    XMLProgParser *p = new XMLProgParser();
-//    p->persistToXML(prog);
+bool Boomerang::saveProject(Prog *prog) {
+    QString path = prog->getRootCluster()->getOutPath("bpj");
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_STREAM() << "cannot open " << path << " for writing\n";
+        return false;
+    }
+    Project *project = static_cast<Project *>(currentProject);
+    project->setProg(prog);
+    if (!project->serializeTo(file)) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
 }
 /**
- * Loads the state of a Prog object from a XML file.
- * \param fname The name of the XML file.
- * \return The loaded Prog object.
+ * Loads the state of a Prog object from a project file written by saveProject.
+ * The binary the project was made from is loaded again from its original path.
+ * \param fname The name of the project file.
+ * \return The loaded Prog object, or nullptr on failure.
  */
-Prog *Boomerang::loadFromXML(const char *fname) {
-    assert(!"TODO: use cereal");
-//    LOG << "loading persistable state...\n";
-//    XMLProgParser *p = new XMLProgParser();
-//    return p->parse(fname);
-    return nullptr;
+Prog *Boomerang::loadProject(const QString &fname) {
+    QFile file(fname);
+    if (!file.open(QIODevice::ReadOnly))
+        return nullptr;
+    Project *project = static_cast<Project *>(currentProject);
+    if (!project->serializeFrom(file))
+        return nullptr;
+    return project->prog();
 }
 
 void Boomerang::miniDebugger(UserProc *p, const char *description)
@@ -919,6 +964,10 @@ IBinarySymbolTable *Boomerang::getSymbols()
 }
 
 void Boomerang::alertDecompileDebugPoint(UserProc *p, const char *description) {
+    // With --threads, debug points are reached from several workers; watchers are not thread safe, so they are
+    // told about one point at a time. (The command line refuses -k and -ds together with --threads.)
+    static QMutex debug_point_lock;
+    QMutexLocker lock(&debug_point_lock);
     if (stopAtDebugPoints) {
         miniDebugger(p,description);
     }
@@ -930,8 +979,15 @@ void Boomerang::alertDecompileDebugPoint(UserProc *p, const char *description) {
 QTextStream &Boomerang::getLogStream(int level)
 {
     if(level>=LL_Error)
-        return ErrStream;
-    return LogStream;
+        return threadErrStream ? *threadErrStream : ErrStream;
+    return threadLogStream ? *threadLogStream : LogStream;
+}
+//! Redirect the streams returned by getLogStream for the calling thread only; pass nullptr to restore the defaults.
+//! Used by the parallel decompiler, so that output from concurrent workers can be replayed in a deterministic order.
+void Boomerang::redirectThreadLog(QTextStream *log_strm, QTextStream *err_strm)
+{
+    threadLogStream = log_strm;
+    threadErrStream = err_strm;
 }
 
 QString Boomerang::filename() const
@@ -35,7 +35,7 @@
 #include <cstdlib>
 #include <memory>
 using namespace std;
-static int codegen_progress = 0;
+static thread_local int codegen_progress = 0; // per thread, as procedures can be generated in parallel
 static bool isBareMemof(const Exp &e, UserProc *proc);
 // extern char *operStrings[];
 
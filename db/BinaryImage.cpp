@@ -1,36 +1,31 @@
 #include "BinaryImage.h"
 #include "types.h"
 #include "config.h"
+#include "decompilecache.h"
 
 #include <QDebug>
 #include <algorithm>
+#include <cstring>
 
 using namespace boost::icl;
 namespace {
 /***************************************************************************/ /**
   *
-  * \brief    Read a 2 or 4 byte quantity from host address (C pointer) p
-  * \note        Takes care of reading the correct endianness, set early on into m_elfEndianness
-  * \param    ps or pi: host pointer to the data
+  * \brief    Read a 2, 4 or 8 byte quantity from host address (C pointer) p
+  * \note        The caller picks the variant matching the section's endianness, so no per-byte test is needed
+  * \param    p: host pointer to the data
   * \returns        An integer representing the data
   ******************************************************************************/
-int Read2(const short *ps,bool bigEndian)  {
-    const unsigned char *p = (const unsigned char *)ps;
-    if (bigEndian) {
-        // Big endian
-        return (int)((p[0] << 8) + p[1]);
-    } else {
-        // Little endian
-        return (int)(p[0] + (p[1] << 8));
-    }
+inline uint16_t ReadLE2(const uint8_t *p) { return uint16_t(p[0] | (p[1] << 8)); }
+inline uint16_t ReadBE2(const uint8_t *p) { return uint16_t((p[0] << 8) | p[1]); }
+inline uint32_t ReadLE4(const uint8_t *p) {
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
 }
-int Read4(const int *pi,bool bigEndian)  {
-    const short *p = (const short *)pi;
-    if (bigEndian) {
-        return (int)((Read2(p,bigEndian) << 16) + Read2(p + 1,bigEndian));
-    } else
-        return (int)(Read2(p,bigEndian) + (Read2(p + 1,bigEndian) << 16));
+inline uint32_t ReadBE4(const uint8_t *p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
 }
+inline QWord ReadLE8(const uint8_t *p) { return QWord(ReadLE4(p)) | (QWord(ReadLE4(p + 4)) << 32); }
+inline QWord ReadBE8(const uint8_t *p) { return (QWord(ReadBE4(p)) << 32) | QWord(ReadBE4(p + 4)); }
 }
 
 void Write4(int *pi, int val,bool bigEndian) {
@@ -58,6 +53,7 @@ BinaryImage::~BinaryImage()
 }
 void BinaryImage::reset()
 {
+    LastSection = nullptr;
     SectionMap.clear();
     for(IBinarySection *si : Sections) {
         delete si;
@@ -65,83 +61,88 @@ void BinaryImage::reset()
     Sections.clear();
 }
 
+/***************************************************************************/ /**
+  * \brief Translate a native address to a host pointer.
+  * \param nat - native address
+  * \param sect - if not null, receives the section containing \a nat
+  * \returns host pointer, or nullptr if \a nat is not in any section
+  ******************************************************************************/
+const uint8_t *BinaryImage::hostPtr(ADDRESS nat, const IBinarySection **sect) const {
+    const IBinarySection *si = getSectionInfoByAddr(nat);
+    if (si == nullptr)
+        return nullptr;
+    if (sect)
+        *sect = si;
+    return (const uint8_t *)(si->hostAddr() - si->sourceAddr() + nat).m_value;
+}
+
+/***************************************************************************/ /**
+  * \brief Give direct access to \a len bytes of the image, e.g. for decoders to fetch a whole instruction at once.
+  * \returns host pointer to the bytes at \a nat, or nullptr if they do not all lie within a single section
+  ******************************************************************************/
+const uint8_t *BinaryImage::readSpan(ADDRESS nat, size_t len) {
+    const IBinarySection *si;
+    const uint8_t *p = hostPtr(nat, &si);
+    if (p == nullptr || (nat - si->sourceAddr()).m_value + len > si->size())
+        return nullptr;
+    DecompileCache::noteRead(nat, len);
+    return p;
+}
+
 char BinaryImage::readNative1(ADDRESS nat) {
-    const IBinarySection * si = getSectionInfoByAddr(nat);
-    if (si == nullptr) {
+    const uint8_t *p = hostPtr(nat);
+    if (p == nullptr) {
         qDebug() << "Target Memory access in unmapped Section " << nat.m_value;
         return -1;
     }
-    ADDRESS host = si->hostAddr() - si->sourceAddr() + nat;
-    return *(char *)host.m_value;
+    DecompileCache::noteRead(nat, 1);
+    return (char)*p;
 }
 
 int BinaryImage::readNative2(ADDRESS nat) {
-    const IBinarySection * si = getSectionInfoByAddr(nat);
-    if (si == nullptr)
+    const IBinarySection *si;
+    const uint8_t *p = hostPtr(nat, &si);
+    if (p == nullptr)
         return 0;
-    ADDRESS host = si->hostAddr() - si->sourceAddr() + nat;
-    return Read2((short *)host.m_value,si->getEndian());
+    DecompileCache::noteRead(nat, 2);
+    return si->getEndian() ? ReadBE2(p) : ReadLE2(p);
 }
 
 int BinaryImage::readNative4(ADDRESS nat) {
-    const IBinarySection * si = getSectionInfoByAddr(nat);
-    if (si == nullptr)
+    const IBinarySection *si;
+    const uint8_t *p = hostPtr(nat, &si);
+    if (p == nullptr)
         return 0;
-    ADDRESS host = si->hostAddr() - si->sourceAddr() + nat;
-    return Read4((int *)host.m_value,si->getEndian());
+    DecompileCache::noteRead(nat, 4);
+    return (int)(si->getEndian() ? ReadBE4(p) : ReadLE4(p));
 }
+
 // Read 8 bytes from given native address
-QWord BinaryImage::readNative8(ADDRESS nat) { // TODO: lifted from Win32 loader, likely wrong
-    const IBinarySection * si = getSectionInfoByAddr(nat);
-    if (si == nullptr)
+QWord BinaryImage::readNative8(ADDRESS nat) {
+    const IBinarySection *si;
+    const uint8_t *p = hostPtr(nat, &si);
+    if (p == nullptr)
         return 0;
-    int raw[2];
-#ifdef WORDS_BIGENDIAN     // This tests the  host     machine
-    if (si->Endiannes) { // This tests the source machine
-#else
-    if (si->getEndian()==0) {
-#endif // Balance }
-        // Source and host are same endianness
-        raw[0] = readNative4(nat);
-        raw[1] = readNative4(nat + 4);
-    } else {
-        // Source and host are different endianness
-        raw[1] = readNative4(nat);
-        raw[0] = readNative4(nat + 4);
-    }
-    // return reinterpret_cast<long long>(*raw);       // Note: cast, not convert!!
-    return *(QWord *)raw;
+    DecompileCache::noteRead(nat, 8);
+    return si->getEndian() ? ReadBE8(p) : ReadLE8(p);
 }
+
 // Read 4 bytes as a float
 float BinaryImage::readNativeFloat4(ADDRESS nat) {
-    int raw = readNative4(nat);
-    // Ugh! gcc says that reinterpreting from int to float is invalid!!
-    // return reinterpret_cast<float>(raw);      // Note: cast, not convert!!
-    return *(float *)&raw; // Note: cast, not convert
+    uint32_t raw = readNative4(nat);
+    float res;
+    memcpy(&res, &raw, sizeof(res)); // Note: reinterpret, not convert
+    return res;
 }
 
 // Read 8 bytes as a float
 double BinaryImage::readNativeFloat8(ADDRESS nat) {
-    const IBinarySection * si = getSectionInfoByAddr(nat);
-    if (si == nullptr)
-        return 0;
-    int raw[2];
-#ifdef WORDS_BIGENDIAN     // This tests the  host     machine
-    if (si->Endiannes) { // This tests the source machine
-#else
-    if (si->getEndian()==0) {
-#endif // Balance }
-        // Source and host are same endianness
-        raw[0] = readNative4(nat);
-        raw[1] = readNative4(nat + 4);
-    } else {
-        // Source and host are different endianness
-        raw[1] = readNative4(nat);
-        raw[0] = readNative4(nat + 4);
-    }
-    // return reinterpret_cast<double>(*raw);    // Note: cast, not convert!!
-    return *(double *)raw;
+    QWord raw = readNative8(nat);
+    double res;
+    memcpy(&res, &raw, sizeof(res)); // Note: reinterpret, not convert
+    return res;
 }
+
 void BinaryImage::writeNative4(ADDRESS nat, uint32_t n) {
     const IBinarySection * si = getSectionInfoByAddr(nat);
     if (si == nullptr) {
@@ -194,11 +195,16 @@ void BinaryImage::calculateTextLimits() {
 const IBinarySection *BinaryImage::getSectionInfoByAddr(ADDRESS uEntry) const {
     if(!uEntry.isSourceAddr())
         qDebug()<<"getSectionInfoByAddr with non-Source ADDRESS";
+    const IBinarySection *last = LastSection.load(std::memory_order_relaxed);
+    if (last && uEntry >= last->sourceAddr() && uEntry < last->sourceAddr() + last->size())
+        return last;
     auto iter = SectionMap.find(uEntry);
     if(iter==SectionMap.end()) {
         return nullptr;
     }
-    return iter->second;
+    const IBinarySection *found = iter->second;
+    LastSection.store(found, std::memory_order_relaxed);
+    return found;
 }
 //! Find section index given name, or -1 if not found
 int BinaryImage::GetSectionIndexByName(const QString &sName) {
@@ -4,6 +4,7 @@
 #include "IBinaryImage.h"
 
 #include <boost/icl/interval_map.hpp>
+#include <atomic>
 
 struct SectionHolder {
     SectionHolder() : val(nullptr) {}
@@ -43,6 +44,7 @@ public:
     float  readNativeFloat4(ADDRESS nat) override;
     double readNativeFloat8(ADDRESS nat) override;
     void   writeNative4(ADDRESS nat, uint32_t n) override;
+    const uint8_t *readSpan(ADDRESS nat, size_t len) override;
     void calculateTextLimits() override;
     //! Find the section, given an address in the section
     const IBinarySection *getSectionInfoByAddr(ADDRESS uEntry) const override;
@@ -65,11 +67,15 @@ public:
     bool                    empty() const override { return Sections.empty(); }
 
 private:
+    const uint8_t *hostPtr(ADDRESS nat, const IBinarySection **sect = nullptr) const;
+
     ADDRESS limitTextLow;
     ADDRESS limitTextHigh;
     ptrdiff_t TextDelta;
     MapAddressRangeToSection SectionMap;
     SectionListType Sections; //!< The section info
+    //! Section that satisfied the last lookup; reads tend to stay in one section, so this avoids most map searches
+    mutable std::atomic<const IBinarySection *> LastSection {nullptr};
 };
 
 
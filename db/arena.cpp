@@ -0,0 +1,164 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       arena.cpp
+  * \brief   Implementation of the Arena class.
+  ******************************************************************************/
+
+#include "arena.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+thread_local Arena *Arena::currentArena = nullptr;
+
+struct Arena::Chunk {
+    std::atomic<size_t> refs; //!< Blocks still live in this chunk, plus one while the arena is filling it
+    size_t size;              //!< Bytes available for blocks after the header
+    size_t total;             //!< Bytes of the whole chunk, a multiple of CHUNK_SIZE
+    Chunk(size_t n, size_t sz, size_t t) : refs(n), size(sz), total(t) {}
+};
+
+namespace {
+const size_t ALIGN = alignof(std::max_align_t);
+size_t roundUp(size_t n, size_t to = ALIGN) { return (n + to - 1) & ~(to - 1); }
+const size_t CHUNK_HEADER = roundUp(sizeof(Arena::Chunk));
+
+//! Chunks are aligned to CHUNK_SIZE and made of whole units of it, so the unit of a block's address is the unit of
+//! its chunk, and no heap block shares a unit with a chunk.
+const unsigned UNIT_BITS = 16;
+const size_t CHUNK_SIZE = size_t(1) << UNIT_BITS;
+
+//! The chunk that owns each unit of the address space, in a two level radix table (like a page map): deallocate()
+//! finds the chunk of a block by reading it, without a lock. Leaves are made when first needed and never freed; the
+//! root is zero initialised static data. Without --arena nothing is entered and deallocate() never reads it.
+const unsigned ADDRESS_BITS = sizeof(void *) == 8 ? 48 : 32;
+const unsigned LEAF_BITS = (ADDRESS_BITS - UNIT_BITS) / 2;
+const unsigned ROOT_BITS = ADDRESS_BITS - UNIT_BITS - LEAF_BITS;
+const uintptr_t LEAF_MASK = (uintptr_t(1) << LEAF_BITS) - 1;
+struct Leaf {
+    std::atomic<Arena::Chunk *> owner[size_t(1) << LEAF_BITS];
+};
+std::atomic<Leaf *> root[size_t(1) << ROOT_BITS];
+std::atomic<size_t> liveChunks(0);
+
+char *blocksOf(Arena::Chunk *c) { return reinterpret_cast<char *>(c) + CHUNK_HEADER; }
+
+Arena::Chunk *ownerOf(const void *p) {
+    uintptr_t unit = uintptr_t(p) >> UNIT_BITS;
+    if (unit >> (LEAF_BITS + ROOT_BITS))
+        return nullptr;
+    Leaf *leaf = root[unit >> LEAF_BITS].load(std::memory_order_acquire);
+    return leaf ? leaf->owner[unit & LEAF_MASK].load(std::memory_order_acquire) : nullptr;
+}
+
+//! Make \a c (or nullptr) the owner of the units of the chunk at \a base
+void setOwner(Arena::Chunk *base, Arena::Chunk *c) {
+    uintptr_t first = uintptr_t(base) >> UNIT_BITS;
+    uintptr_t end = first + (base->total >> UNIT_BITS);
+    assert((end - 1) >> (LEAF_BITS + ROOT_BITS) == 0);
+    for (uintptr_t unit = first; unit < end; ++unit) {
+        std::atomic<Leaf *> &slot = root[unit >> LEAF_BITS];
+        Leaf *leaf = slot.load(std::memory_order_acquire);
+        if (leaf == nullptr) {
+            Leaf *fresh = new Leaf();
+            if (slot.compare_exchange_strong(leaf, fresh, std::memory_order_acq_rel))
+                leaf = fresh;
+            else
+                delete fresh; // Another thread made it first; leaf is now that one
+        }
+        leaf->owner[unit & LEAF_MASK].store(c, std::memory_order_release);
+    }
+}
+
+void *allocateAligned(size_t size) {
+#ifdef _WIN32
+    void *mem = _aligned_malloc(size, CHUNK_SIZE);
+#else
+    void *mem = nullptr;
+    if (posix_memalign(&mem, CHUNK_SIZE, size) != 0)
+        mem = nullptr;
+#endif
+    if (mem == nullptr)
+        throw std::bad_alloc();
+    return mem;
+}
+
+void freeAligned(void *mem) {
+#ifdef _WIN32
+    _aligned_free(mem);
+#else
+    free(mem);
+#endif
+}
+}
+
+Arena::~Arena() {
+    if (chunk)
+        release(chunk);
+}
+
+/// \returns memory for an object of \a size bytes, from the current arena of this thread, or from the heap if none
+void *Arena::allocate(size_t size) {
+    if (currentArena)
+        return currentArena->take(roundUp(size));
+    return ::operator new(size);
+}
+
+/// Free memory from allocate(); its chunk goes back to the heap with the last of its blocks
+void Arena::deallocate(void *p) {
+    if (p == nullptr)
+        return;
+    Chunk *owner = liveChunks.load(std::memory_order_acquire) ? ownerOf(p) : nullptr;
+    if (owner == nullptr)
+        ::operator delete(p);
+    else
+        release(owner);
+}
+
+/// \returns a new chunk with room for at least \a size bytes of blocks, entered in the table of owners
+Arena::Chunk *Arena::newChunk(size_t size, size_t refs) {
+    size_t total = roundUp(CHUNK_HEADER + size, CHUNK_SIZE);
+    Chunk *c = new (allocateAligned(total)) Chunk(refs, total - CHUNK_HEADER, total);
+    liveChunks.fetch_add(1, std::memory_order_release);
+    setOwner(c, c);
+    return c;
+}
+
+/// Take a block of \a need bytes from this arena
+void *Arena::take(size_t need) {
+    if (need > CHUNK_SIZE / 4) {
+        // A chunk of its own, so as not to waste the rest of the current one
+        return blocksOf(newChunk(need, 1));
+    }
+    if (chunk == nullptr || used + need > chunk->size) {
+        if (chunk)
+            release(chunk);
+        chunk = newChunk(CHUNK_SIZE - CHUNK_HEADER, 1);
+        used = 0;
+    }
+    chunk->refs.fetch_add(1, std::memory_order_relaxed);
+    char *block = blocksOf(chunk) + used;
+    used += need;
+    return block;
+}
+
+void Arena::release(Chunk *c) {
+    if (c->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        return;
+    // Out of the table before the memory can be handed out again as heap blocks
+    setOwner(c, nullptr);
+    liveChunks.fetch_sub(1, std::memory_order_relaxed);
+    c->~Chunk();
+    freeAligned(c);
+}
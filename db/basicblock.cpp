@@ -84,8 +84,8 @@ BasicBlock::BasicBlock(const BasicBlock &bb)
       LoopCondType(bb.LoopCondType), StructType(bb.StructType), ImmPDom(bb.ImmPDom),
       LoopHead(bb.LoopHead), CaseHead(bb.CaseHead), CondFollow(bb.CondFollow), LoopFollow(bb.LoopFollow),
       LatchNode(bb.LatchNode), StructuringType(bb.StructuringType), UnstructuredType(bb.UnstructuredType) {
-    setRTLs(bb.ListOfRTLs);
     Parent = bb.Parent;
+    setRTLs(bb.ListOfRTLs);
 }
 
 /***************************************************************************/ /**
@@ -146,6 +146,8 @@ void BasicBlock::setTraversed(bool bTraversed) { TraversedMarker = bTraversed; }
 void BasicBlock::setRTLs(std::list<RTL *> *rtls) {
     // should we delete old ones here? breaks some things - trent
     ListOfRTLs = rtls;
+    if (Parent && !Parent->isLib() && static_cast<UserProc *>(Parent)->getCFG())
+        static_cast<UserProc *>(Parent)->getCFG()->stmtsChanged();
 
     // Used to set the link between the last instruction (a call) and this BB if this is a call BB
 }
@@ -788,9 +790,12 @@ bool BasicBlock::isAncestorOf(BasicBlock *other) {
 /*! Simplify all the expressions in this BB
  */
 void BasicBlock::simplify() {
+    bool changed = false;
     if (ListOfRTLs)
         for (RTL *elem : *ListOfRTLs)
-            elem->simplify();
+            changed |= elem->simplify();
+    if (changed && Parent && !Parent->isLib())
+        static_cast<UserProc *>(Parent)->getCFG()->stmtsChanged();
     if (NodeType == BBTYPE::TWOWAY) {
         assert(OutEdges.size()>1);
         if (ListOfRTLs == nullptr || ListOfRTLs->empty()) {
@@ -1484,6 +1489,7 @@ void BasicBlock::prependStmt(Instruction *s, UserProc *proc) {
     assert(ListOfRTLs);
     s->setBB(this);
     s->setProc(proc);
+    proc->getCFG()->stmtsChanged();
     if (!ListOfRTLs->empty()) {
         RTL *rtl = ListOfRTLs->front();
         if (rtl->getAddress().isZero()) {
@@ -1500,100 +1506,12 @@ void BasicBlock::prependStmt(Instruction *s, UserProc *proc) {
 
 ////////////////////////////////////////////////////
 
-// Check for overlap of liveness between the currently live locations (liveLocs) and the set of locations in ls
-// Also check for type conflicts if DFA_TYPE_ANALYSIS
-// This is a helper function that is not directly declared in the BasicBlock class
-void checkForOverlap(LocationSet &liveLocs, LocationSet &ls, ConnectionGraph &ig, UserProc * /*proc*/) {
-    // For each location to be considered
-    for (SharedExp u : ls) {
-        if (!u->isSubscript())
-            continue; // Only interested in subscripted vars
-        auto r = std::static_pointer_cast<RefExp>(u);
-        // Interference if we can find a live variable which differs only in the reference
-        SharedExp dr;
-        if (liveLocs.findDifferentRef(r, dr)) {
-            assert(dr->access<RefExp>()->getDef()!=nullptr);
-            assert(u->access<RefExp>()->getDef()!=nullptr);
-            // We have an interference between r and dr. Record it
-            ig.connect(r, dr);
-            if (VERBOSE || DEBUG_LIVENESS)
-                LOG << "interference of " << dr << " with " << r << "\n";
-        }
-        // Add the uses one at a time. Note: don't use makeUnion, because then we don't discover interferences
-        // from the same statement, e.g.  blah := r24{2} + r24{3}
-        liveLocs.insert(u);
-    }
-}
-
-bool BasicBlock::calcLiveness(ConnectionGraph &ig, UserProc *myProc) {
-    // Start with the liveness at the bottom of the BB
-    LocationSet liveLocs, phiLocs;
-    getLiveOut(liveLocs, phiLocs);
-    // Do the livensses that result from phi statements at successors first.
-    // FIXME: document why this is necessary
-    checkForOverlap(liveLocs, phiLocs, ig, myProc);
-    // For each RTL in this BB
-    std::list<RTL *>::reverse_iterator rit;
-    if (ListOfRTLs) // this can be nullptr
-        for (rit = ListOfRTLs->rbegin(); rit != ListOfRTLs->rend(); ++rit) {
-            std::list<Instruction *>::reverse_iterator sit;
-            // For each statement this RTL
-            for (sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
-                Instruction *s = *sit;
-                LocationSet defs;
-                s->getDefinitions(defs);
-                // The definitions don't have refs yet
-                defs.addSubscript(s /* , myProc->getCFG() */);
-#if 0
-                // I used to think it necessary to consider definitions as a special case. However, I now believe that
-                // this was either an error of implementation (e.g. it didn't seem to correctly consider the livenesses
-                // causesd by phis) or something to do with renaming but not propagating certain memory locations.
-                // The idea is now to clearly divide locations into those that can be renamed and propagated, and those
-                // which are not renamed or propagated. (Check this.)
-
-                // Also consider it an interference if we define a location that is the same base variable. This can happen
-                // when there is a definition that is unused but for whatever reason not eliminated
-                // This check is done at the "bottom" of the statement, i.e. before we add s's uses and remove s's
-                // definitions to liveLocs
-                // Note that phi assignments don't count
-                if (!s->isPhi())
-                    checkForOverlap(liveLocs, defs, ig, myProc, false);
-#endif
-                // Definitions kill uses. Now we are moving to the "top" of statement s
-                liveLocs.makeDiff(defs);
-                // Phi functions are a special case. The operands of phi functions are uses, but they don't interfere
-                // with each other (since they come via different BBs). However, we don't want to put these uses into
-                // liveLocs, because then the livenesses will flow to all predecessors. Only the appropriate livenesses
-                // from the appropriate phi parameter should flow to the predecessor. This is done in getLiveOut()
-                if (s->isPhi())
-                    continue;
-                // Check for livenesses that overlap
-                LocationSet uses;
-                s->addUsedLocs(uses);
-                checkForOverlap(liveLocs, uses, ig, myProc);
-                if (DEBUG_LIVENESS)
-                    LOG << " ## liveness: at top of " << s << ", liveLocs is " << liveLocs.prints() << "\n";
-            }
-        }
-    // liveIn is what we calculated last time
-    if (!(liveLocs == LiveIn)) {
-        LiveIn = liveLocs;
-        return true; // A change
-    }
-    // No change
-    return false;
-}
-
-// Locations that are live at the end of this BB are the union of the locations that are live at the start of its
-// successors
-// liveout gets all the livenesses, and phiLocs gets a subset of these, which are due to phi statements at the top of
-// successors
-void BasicBlock::getLiveOut(LocationSet &liveout, LocationSet &phiLocs) {
+// The locations that are live at the end of this BB because of phi statements at the top of its successors: for each
+// phi, the operand that flows from this BB. The rest of the liveness at the end of this BB is the union of the
+// liveness at the start of its successors (see Cfg::findInterferences)
+void BasicBlock::getPhiLiveOut(LocationSet &phiLocs) {
     Cfg *cfg(((UserProc *)Parent)->getCFG());
-    liveout.clear();
     for (BasicBlock *currBB : OutEdges) {
-        // First add the non-phi liveness
-        liveout.makeUnion(currBB->LiveIn); // add successor liveIn to this liveout set.
         // The first RTL will have the phi functions, if any
         if (currBB->ListOfRTLs == nullptr || currBB->ListOfRTLs->size() == 0)
             continue;
@@ -1639,7 +1557,6 @@ void BasicBlock::getLiveOut(LocationSet &liveout, LocationSet &phiLocs) {
             }
             SharedExp r = RefExp::get(pa->getLeft()->clone(), def);
             assert(def);
-            liveout.insert(r);
             phiLocs.insert(r);
             if (DEBUG_LIVENESS)
                 LOG << " ## Liveness: adding " << r << " due to ref to phi " << st << " in BB at " << getLowAddr()
@@ -69,12 +69,15 @@
 #include <cassert>
 #include <algorithm> // For find()
 #include <cstring>
+#include <cstdint>
+#include <deque>
+#include <set>
 
 void delete_lrtls(std::list<RTL *> &pLrtl);
 void erase_lrtls(std::list<RTL *> &pLrtl, std::list<RTL *>::iterator begin, std::list<RTL *>::iterator end);
 
 namespace {
-static int progress = 0;
+static thread_local int progress = 0;
 }
 
 /**********************************
@@ -82,7 +85,8 @@ static int progress = 0;
  **********************************/
 
 Cfg::Cfg()
-    : WellFormed(false), structured(false), ImplicitsDone(false), lastLabel(0), entryBB(nullptr), exitBB(nullptr) {}
+    : WellFormed(false), structured(false), ImplicitsDone(false), lastLabel(0), entryBB(nullptr), exitBB(nullptr),
+      stmtGeneration(0) {}
 
 /***************************************************************************/ /**
   *
@@ -102,12 +106,25 @@ Cfg::~Cfg() {
   ******************************************************************************/
 void Cfg::setProc(UserProc *proc) { myProc = proc; }
 
+/***************************************************************************/ /**
+  *
+  * \brief Add the address range of \a bb to the program's index of procedure ranges (see Prog::findContainingProc).
+  * Splitting or joining BBs does not need this, since the union of the ranges stays the same.
+  *
+  ******************************************************************************/
+void Cfg::indexBB(BasicBlock *bb) {
+    if (myProc == nullptr || myProc->getProg() == nullptr || bb->getRTLs() == nullptr || bb->getRTLs()->empty())
+        return;
+    myProc->getProg()->indexProcRange(myProc, bb->getLowAddr(), bb->getHiAddr());
+}
+
 /***************************************************************************/ /**
   *
   * \brief        Clear the CFG of all basic blocks, ready for decode
   *
   ******************************************************************************/
 void Cfg::clear() {
+    stmtsChanged();
     // Don't delete the BBs; this will delete any CaseStatements we want to save for the re-decode. Just let the garbage
     // collection take care of it.
     // for (std::list<PBB>::iterator it = m_listBB.begin(); it != m_listBB.end(); it++)
@@ -129,12 +146,82 @@ void Cfg::clear() {
   *
   ******************************************************************************/
 Cfg &Cfg::operator=(const Cfg &other) {
+    stmtsChanged();
     m_listBB = other.m_listBB;
     m_mapBB = other.m_mapBB;
     WellFormed = other.WellFormed;
     return *this;
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief   Replace the BBs of this CFG by copies of those of \a other, with their RTLs cloned
+  * \note    Meant for CFGs as decoded (see UserProc::makeMemo): the results of analyses (DFT order, structuring,
+  *          liveness, implicit assignments) are not copied
+  * \param   other - the CFG to copy
+  * \param   stmts - receives the copy of each statement of \a other
+  *
+  ******************************************************************************/
+void Cfg::copyBBs(const Cfg &other, std::map<const Instruction *, Instruction *> &stmts) {
+    clear();
+    std::map<const BasicBlock *, BasicBlock *> bbs;
+    bbs[nullptr] = nullptr;
+    for (const BasicBlock *bb : other.m_listBB) {
+        BasicBlock *copy;
+        if (bb->ListOfRTLs == nullptr)
+            copy = new BasicBlock(myProc); // Incomplete
+        else {
+            std::list<RTL *> *rtls = new std::list<RTL *>;
+            for (const RTL *rtl : *bb->ListOfRTLs) {
+                RTL *rtlCopy = rtl->clone();
+                RTL::iterator cc = rtlCopy->begin();
+                for (Instruction *s : *rtl) {
+                    Instruction *c = *cc++;
+                    stmts[s] = c;
+                    if (s->isCall()) {
+                        // Not copied by clone(), but set by the decoder
+                        CallStatement *call = static_cast<CallStatement *>(s);
+                        if (call->getDestProc())
+                            static_cast<CallStatement *>(c)->setDestProc(call->getDestProc());
+                        static_cast<CallStatement *>(c)->setReturnAfterCall(call->isReturnAfterCall());
+                    }
+                }
+                rtls->push_back(rtlCopy);
+            }
+            copy = new BasicBlock(myProc, rtls, bb->NodeType, bb->TargetOutEdges);
+            for (RTL *rtl : *rtls)
+                for (Instruction *s : *rtl)
+                    s->setBB(copy);
+        }
+        copy->NodeType = bb->NodeType;
+        copy->TargetOutEdges = bb->TargetOutEdges;
+        copy->LabelNum = bb->LabelNum;
+        copy->LabelNeeded = bb->LabelNeeded;
+        copy->Incomplete = bb->Incomplete;
+        copy->JumpReqd = bb->JumpReqd;
+        bbs[bb] = copy;
+        m_listBB.push_back(copy);
+    }
+    for (const BasicBlock *bb : other.m_listBB) {
+        BasicBlock *copy = bbs[bb];
+        for (BasicBlock *in : bb->InEdges)
+            copy->InEdges.push_back(bbs[in]);
+        for (BasicBlock *out : bb->OutEdges)
+            copy->OutEdges.push_back(bbs[out]);
+    }
+    for (const std::pair<const ADDRESS, BasicBlock *> &mb : other.m_mapBB)
+        m_mapBB[mb.first] = bbs[mb.second];
+    for (CallStatement *call : other.CallSites) {
+        auto cc = stmts.find(call);
+        if (cc != stmts.end())
+            CallSites.insert(static_cast<CallStatement *>(cc->second));
+    }
+    entryBB = bbs[other.entryBB];
+    exitBB = bbs[other.exitBB];
+    lastLabel = other.lastLabel;
+    WellFormed = other.WellFormed;
+}
+
 /***************************************************************************/ /**
   *
   * \brief        Set the entry and calculate exit BB pointers
@@ -193,6 +280,7 @@ bool Cfg::checkEntryBB() {
   * \returns Pointer to the newly created BB, or 0 if there is already an incomplete BB with the same address
   ******************************************************************************/
 BasicBlock *Cfg::newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutEdges) {
+    stmtsChanged();
     MAPBB::iterator mi;
     BasicBlock *pBB;
 
@@ -249,6 +337,7 @@ BasicBlock *Cfg::newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutE
             mi = m_mapBB.find(addr);
         }
     }
+    indexBB(pBB);
 
     if (!addr.isZero() && (mi != m_mapBB.end())) {
         // Existing New            +---+ Top of new
@@ -399,6 +488,7 @@ bool Cfg::existsBB(ADDRESS uNativeAddr) const {
   ******************************************************************************/
 BasicBlock *Cfg::splitBB(BasicBlock *pBB, ADDRESS uNativeAddr, BasicBlock *pNewBB /* = 0 */,
                          bool bDelRtls /* = false */) {
+    stmtsChanged();
     std::list<RTL *>::iterator ri;
 
     // First find which RTL has the split address; note that this could fail (e.g. label in the middle of an
@@ -645,18 +735,27 @@ bool Cfg::isIncomplete(ADDRESS uAddr) const {
   * if they used iterators to traverse the list of BBs.
   *
   ******************************************************************************/
-void Cfg::sortByAddress() { m_listBB.sort(BasicBlock::lessAddress); }
+void Cfg::sortByAddress() {
+    stmtsChanged();
+    m_listBB.sort(BasicBlock::lessAddress);
+}
 
 /***************************************************************************/ /**
   *
   * \brief        Sorts the BBs in a cfg by their first DFT numbers.
   ******************************************************************************/
-void Cfg::sortByFirstDFT() { m_listBB.sort(BasicBlock::lessFirstDFT); }
+void Cfg::sortByFirstDFT() {
+    stmtsChanged();
+    m_listBB.sort(BasicBlock::lessFirstDFT);
+}
 
 /***************************************************************************/ /**
   * \brief        Sorts the BBs in a cfg by their last DFT numbers.
   ******************************************************************************/
-void Cfg::sortByLastDFT() { m_listBB.sort(BasicBlock::lessLastDFT); }
+void Cfg::sortByLastDFT() {
+    stmtsChanged();
+    m_listBB.sort(BasicBlock::lessLastDFT);
+}
 
 /***************************************************************************/ /**
   *
@@ -769,6 +868,7 @@ bool Cfg::mergeBBs(BasicBlock *pb1, BasicBlock *pb2) {
   *
   ******************************************************************************/
 void Cfg::completeMerge(BasicBlock *pb1, BasicBlock *pb2, bool bDelete) {
+    stmtsChanged();
     // First we replace all of pb1's predecessors' out edges that used to point to pb1 (usually only one of these) with
     // pb2
     for (BasicBlock *pPred : pb1->InEdges) {
@@ -839,6 +939,7 @@ bool Cfg::joinBB(BasicBlock *pb1, BasicBlock *pb2) {
   *
   ******************************************************************************/
 void Cfg::removeBB(BasicBlock *bb) {
+    stmtsChanged();
     BB_IT bbit = std::find(m_listBB.begin(), m_listBB.end(), bb);
     if((*bbit)->getLowAddr()!=ADDRESS::g(0)) {
         m_mapBB.erase((*bbit)->getLowAddr());
@@ -908,6 +1009,7 @@ bool Cfg::compressCfg() {
                                 m_mapBB.erase((*it3)->getLowAddr());
                             }
                             m_listBB.erase(it3);
+                            stmtsChanged();
                             // And delete the BB
                             delete pSucc;
                             break;
@@ -920,6 +1022,7 @@ bool Cfg::compressCfg() {
     return true;
 }
 bool Cfg::removeOrphanBBs() {
+    stmtsChanged();
     std::deque<BasicBlock *> orphans;
     for (BB_IT it = m_listBB.begin(); it != m_listBB.end(); it++) {
         if(*it==this->entryBB) // don't remove entry BasicBlock
@@ -1635,6 +1738,7 @@ void Cfg::structure() {
   * \brief Remove Junction statements
   *******************************************************************************/
 void Cfg::removeJunctionStatements() {
+    stmtsChanged();
     for (BasicBlock *pbb : m_listBB) {
         if (pbb->getFirstStmt() && pbb->getFirstStmt()->isJunction()) {
             assert(pbb->getRTLs());
@@ -1754,62 +1858,220 @@ void Cfg::generateDotFile(QTextStream &of) {
 //            Liveness             //
 ////////////////////////////////////
 
-void updateWorkListRev(BasicBlock *currBB, std::list<BasicBlock *> &workList, std::set<BasicBlock *> &workSet) {
-    // Insert inedges of currBB into the worklist, unless already there
-    for (BasicBlock *currIn : currBB->getInEdges()) {
-        if (workSet.find(currIn) == workSet.end()) {
-            workList.push_front(currIn);
-            workSet.insert(currIn);
-        }
+namespace {
+/// A set of SSA names of one procedure, as bits indexed by the dense numbers of the names
+class NameBits {
+    std::vector<uint64_t> words;
+
+public:
+    explicit NameBits(size_t n = 0) : words((n + 63) / 64, 0) {}
+    void set(int i) { words[i >> 6] |= uint64_t(1) << (i & 63); }
+    void reset(int i) { words[i >> 6] &= ~(uint64_t(1) << (i & 63)); }
+    bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+    void unite(const NameBits &o) {
+        for (size_t i = 0; i < words.size(); ++i)
+            words[i] |= o.words[i];
     }
+    void subtract(const NameBits &o) {
+        for (size_t i = 0; i < words.size(); ++i)
+            words[i] &= ~o.words[i];
+    }
+    bool operator==(const NameBits &o) const { return words == o.words; }
+};
+
+/// What liveness needs to know about one BB, with the SSA names replaced by their numbers
+struct BBLiveness {
+    /// The definitions and uses of each statement, last statement first. Phis have no uses here; their operands
+    /// are live out of the predecessors instead (phiOut)
+    std::vector<std::pair<std::vector<int>, std::vector<int>>> stmts;
+    std::vector<int> phiOut; //!< operands of phis at the top of successors that flow from this BB
+    std::vector<int> succs;
+    std::vector<int> preds;
+    NameBits use; //!< names used before being defined in this BB
+    NameBits def;
+    NameBits liveIn;
+};
 }
+
+/***************************************************************************/ /**
+  *
+  * \brief Find the interferences between the SSA names of this procedure, i.e. the pairs of names with the same
+  * base location that are live at the same time, and so need different variables when translating out of SSA form.
+  *
+  * The names are numbered densely, in lessExpStar order, so that the names of one base location get consecutive
+  * numbers. Liveness is then a backward dataflow over bit sets, iterated to a fixed point, after which one pass
+  * over each BB records every name that is live where another name of the same base is used (or reaches a phi).
+  * \param cg - the interferences are added to this graph with ConnectionGraph::connect, so each name is also
+  * linked to the names already connected to the other; they are added in the order the BBs and statements were
+  * visited by the LocationSet based liveness this replaces (see CfgTest::testInterferences)
+  *
+  ******************************************************************************/
 void Cfg::findInterferences(ConnectionGraph &cg) {
     if (m_listBB.empty())
         return;
 
-    std::list<BasicBlock *> workList; // List of BBs still to be processed
-    // Set of the same; used for quick membership test
-    std::set<BasicBlock *> workSet;
-    appendBBs(workList, workSet);
+    std::map<BasicBlock *, int> bbIds;
+    std::vector<BasicBlock *> bbs(m_listBB.begin(), m_listBB.end());
+    for (size_t i = 0; i < bbs.size(); ++i)
+        bbIds[bbs[i]] = int(i);
+
+    // Collect the names, as expressions for now
+    typedef std::vector<std::pair<LocationSet, LocationSet>> StmtLocs;
+    std::vector<StmtLocs> bbLocs(bbs.size());
+    std::vector<LocationSet> bbPhiOut(bbs.size());
+    std::map<SharedExp, int, lessExpStar> nameIds;
+    for (size_t i = 0; i < bbs.size(); ++i) {
+        BasicBlock *bb = bbs[i];
+        bb->getPhiLiveOut(bbPhiOut[i]);
+        for (const SharedExp &e : bbPhiOut[i])
+            nameIds[e] = 0;
+        if (bb->ListOfRTLs == nullptr)
+            continue;
+        for (auto rit = bb->ListOfRTLs->rbegin(); rit != bb->ListOfRTLs->rend(); ++rit) {
+            for (auto sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
+                Instruction *s = *sit;
+                bbLocs[i].emplace_back();
+                LocationSet &defs = bbLocs[i].back().first;
+                s->getDefinitions(defs);
+                // The definitions don't have refs yet
+                defs.addSubscript(s);
+                for (const SharedExp &e : defs)
+                    nameIds[e] = 0;
+                if (s->isPhi())
+                    continue;
+                LocationSet used;
+                s->addUsedLocs(used);
+                for (const SharedExp &e : used) {
+                    if (!e->isSubscript())
+                        continue; // Only interested in subscripted vars
+                    bbLocs[i].back().second.insert(e);
+                    nameIds[e] = 0;
+                }
+            }
+        }
+    }
+
+    // Number the names. Names with the same base are adjacent; groupLo/groupHi give the range of each name's base
+    std::vector<SharedExp> names;
+    for (auto &ni : nameIds) {
+        ni.second = int(names.size());
+        names.push_back(ni.first);
+    }
+    size_t n = names.size();
+    std::vector<int> groupLo(n), groupHi(n);
+    for (size_t i = 0; i < n; ++i) {
+        bool sameBase = i > 0 && *names[i]->getSubExp1() == *names[i - 1]->getSubExp1();
+        groupLo[i] = sameBase ? groupLo[i - 1] : int(i);
+    }
+    for (size_t i = n; i-- > 0;) {
+        bool sameBase = i + 1 < n && groupLo[i + 1] == groupLo[i];
+        groupHi[i] = sameBase ? groupHi[i + 1] : int(i) + 1;
+    }
 
-    int count = 0;
-    while (workList.size() && count < 100000) {
-        count++; // prevent infinite loop
+    std::vector<BBLiveness> live(bbs.size());
+    // Not const: LocationSet::end() const is broken (it returns begin())
+    auto idsOf = [&nameIds](LocationSet &ls, std::vector<int> &ids) {
+        for (const SharedExp &e : ls)
+            ids.push_back(nameIds[e]);
+    };
+    for (size_t i = 0; i < bbs.size(); ++i) {
+        BBLiveness &bl = live[i];
+        bl.use = bl.def = bl.liveIn = NameBits(n);
+        idsOf(bbPhiOut[i], bl.phiOut);
+        for (auto &sl : bbLocs[i]) {
+            bl.stmts.emplace_back();
+            idsOf(sl.first, bl.stmts.back().first);
+            idsOf(sl.second, bl.stmts.back().second);
+            // Definitions kill uses (each name has only one definition); uses are added one by one below them
+            for (int d : bl.stmts.back().first) {
+                bl.def.set(d);
+                bl.use.reset(d);
+            }
+            for (int u : bl.stmts.back().second)
+                bl.use.set(u);
+        }
+        for (BasicBlock *succ : bbs[i]->OutEdges)
+            if (bbIds.count(succ))
+                bl.succs.push_back(bbIds[succ]);
+        for (BasicBlock *pred : bbs[i]->InEdges)
+            if (bbIds.count(pred))
+                bl.preds.push_back(bbIds[pred]);
+    }
+    bbLocs.clear();
+
+    auto liveOut = [&live, n](int b) {
+        NameBits out(n);
+        for (int s : live[b].succs)
+            out.unite(live[s].liveIn);
+        for (int p : live[b].phiOut)
+            out.set(p);
+        return out;
+    };
+
+    // Iterate liveIn = use | (liveOut - def) to a fixed point, visiting the last BBs first
+    std::deque<int> workList;
+    std::vector<bool> inWorkList(bbs.size(), true);
+    for (size_t i = 0; i < bbs.size(); ++i)
+        workList.push_back(int(i));
+    while (!workList.empty()) {
         if (++progress > 20) {
             LOG_STREAM() << "i";
             LOG_STREAM().flush();
             progress = 0;
         }
-        BasicBlock *currBB = workList.back();
-        workList.erase(--workList.end());
-        workSet.erase(currBB);
-        // Calculate live locations and interferences
-        bool change = currBB->calcLiveness(cg, myProc);
-        if (!change)
+        int b = workList.back();
+        workList.pop_back();
+        inWorkList[b] = false;
+        NameBits in = liveOut(b);
+        in.subtract(live[b].def);
+        in.unite(live[b].use);
+        if (in == live[b].liveIn)
             continue;
-        if (DEBUG_LIVENESS) {
-            LOG << "Revisiting BB ending with stmt ";
-            Instruction *last = nullptr;
-            if (!currBB->ListOfRTLs->empty()) {
-                RTL *lastRtl = currBB->ListOfRTLs->back();
-                if (lastRtl->size())
-                    last = lastRtl->back();
+        live[b].liveIn = in;
+        for (int p : live[b].preds) {
+            if (!inWorkList[p]) {
+                inWorkList[p] = true;
+                workList.push_front(p);
             }
-            if (last)
-                LOG << last->getNumber();
-            else
-                LOG << "<none>";
-            LOG << " due to change\n";
         }
-        updateWorkListRev(currBB, workList, workSet);
     }
-}
 
-void Cfg::appendBBs(std::list<BasicBlock *> &worklist, std::set<BasicBlock *> &workset) {
-    // Append my list of BBs to the worklist
-    worklist.insert(worklist.end(), m_listBB.begin(), m_listBB.end());
-    // Do the same for the workset
-    std::copy(m_listBB.begin(), m_listBB.end(), std::inserter(workset, workset.end()));
+    // Record the interferences. connect() depends on the order it is called in, so this follows the order the
+    // LocationSet based liveness found them in: the BBs last first, and in each the phi operands of the successors,
+    // then the statements bottom up, with the use first. Each pair is connected once
+    std::set<std::pair<int, int>> seen;
+    auto interfere = [&](const NameBits &liveNow, int u) {
+        for (int j = groupLo[u]; j < groupHi[u]; ++j) {
+            if (j == u || !liveNow.test(j))
+                continue;
+            if (!seen.insert(std::make_pair(std::min(u, j), std::max(u, j))).second)
+                continue;
+            assert(names[j]->access<RefExp>()->getDef() != nullptr);
+            assert(names[u]->access<RefExp>()->getDef() != nullptr);
+            cg.connect(names[u], names[j]);
+            if (DEBUG_LIVENESS)
+                LOG << "interference of " << names[j] << " with " << names[u] << "\n";
+        }
+    };
+    for (size_t b = bbs.size(); b-- > 0;) {
+        NameBits liveNow = liveOut(int(b));
+        // The operands of phis in successors first; they flow out of this BB together
+        for (int p : live[b].phiOut)
+            interfere(liveNow, p);
+        for (const auto &st : live[b].stmts) {
+            for (int d : st.first)
+                liveNow.reset(d);
+            // Add the uses one at a time, to find interferences within a statement, e.g. blah := r24{2} + r24{3}
+            for (int u : st.second) {
+                interfere(liveNow, u);
+                liveNow.set(u);
+            }
+        }
+        bbs[b]->LiveIn.clear();
+        for (size_t i = 0; i < n; ++i)
+            if (live[b].liveIn.test(int(i)))
+                bbs[b]->LiveIn.insert(names[i]);
+    }
 }
 
 void dumpBB(BasicBlock *bb) {
@@ -1853,6 +2115,7 @@ void dumpBB(BasicBlock *bb) {
  * edges.
  */
 BasicBlock *Cfg::splitForBranch(BasicBlock *pBB, RTL *rtl, BranchStatement *br1, BranchStatement *br2, BB_IT &it) {
+    stmtsChanged();
 #if 0
     LOG_STREAM() << "splitForBranch before:\n";
     LOG_STREAM() << pBB->prints() << "\n";
@@ -234,9 +234,10 @@ bool DataFlow::canRename(SharedExp e, UserProc *proc) {
 
 // For debugging
 void DataFlow::dumpA_phi() {
+    std::map<SharedExp, std::set<int>, lessExpStar> sorted(A_phi.begin(), A_phi.end());
     std::map<SharedExp, std::set<int>, lessExpStar>::iterator zz;
     LOG_STREAM() << "A_phi:\n";
-    for (zz = A_phi.begin(); zz != A_phi.end(); ++zz) {
+    for (zz = sorted.begin(); zz != sorted.end(); ++zz) {
         LOG_STREAM() << zz->first << " -> ";
         std::set<int> &si = zz->second;
         std::set<int>::iterator qq;
@@ -259,7 +260,7 @@ bool DataFlow::placePhiFunctions(UserProc *proc) {
     bucket.resize(0);
     defsites.clear(); // Clear defsites map,
     defallsites.clear();
-    for(std::set<SharedExp, lessExpStar> &se : A_orig) {
+    for(ExpHashSet &se : A_orig) {
         for(auto iter= se.begin(),fin=se.end(); iter!=fin; ) {
             if(A_phi.find(*iter)==A_phi.end()) {
                 iter = se.erase(iter);
@@ -364,7 +365,7 @@ static SharedExp defineAll = Terminal::get(opDefineAll); // An expression repres
 #define STACKS_EMPTY(q) (Stacks.find(q) == Stacks.end() || Stacks[q].empty())
 
 // Subscript dataflow variables
-static int dataflow_progress = 0;
+static thread_local int dataflow_progress = 0;
 bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = false */) {
     if (++dataflow_progress > 200) {
         LOG_STREAM() << 'r';
@@ -580,7 +581,8 @@ bool DataFlow::renameBlockVars(UserProc *proc, int n, bool clearStacks /* = fals
 
 void DataFlow::dumpStacks() {
     LOG_STREAM() << "Stacks: " << Stacks.size() << " entries\n";
-    for (auto zz = Stacks.begin(); zz != Stacks.end(); zz++) {
+    std::map<SharedExp, std::deque<Instruction *>, lessExpStar> sorted(Stacks.begin(), Stacks.end());
+    for (auto zz = sorted.begin(); zz != sorted.end(); zz++) {
         LOG_STREAM() << "Var " << zz->first << " [ ";
         std::deque<Instruction *> tt = zz->second; // Copy the stack!
         while (!tt.empty()) {
@@ -613,7 +615,7 @@ void DataFlow::dumpA_orig() {
     }
 }
 
-void DefCollector::updateDefs(std::map<SharedExp, std::deque<Instruction *>, lessExpStar> &Stacks, UserProc *proc) {
+void DefCollector::updateDefs(ExpHashMap<std::deque<Instruction *>> &Stacks, UserProc *proc) {
     for (auto it = Stacks.begin(); it != Stacks.end(); it++) {
         if (it->second.empty())
             continue; // This variable's definition doesn't reach here
@@ -775,7 +777,8 @@ void DefCollector::insert(Assign *a) {
 
 void DataFlow::convertImplicits(Cfg *cfg) {
     // Convert statements in A_phi from m[...]{-} to m[...]{0}
-    std::map<SharedExp, std::set<int>, lessExpStar> A_phi_copy = A_phi; // Object copy
+    // Ordered, so that which entry is kept when two convert to the same location does not depend on the hashing
+    std::map<SharedExp, std::set<int>, lessExpStar> A_phi_copy(A_phi.begin(), A_phi.end());
     ImplicitConverter ic(cfg);
     A_phi.clear();
     for (std::pair<SharedExp, std::set<int>> it : A_phi_copy) {
@@ -792,10 +795,10 @@ void DataFlow::convertImplicits(Cfg *cfg) {
         defsites[e] = dd.second; // Copy the set (doesn't have to be deep)
     }
 
-    std::vector<std::set<SharedExp, lessExpStar>> A_orig_copy = A_orig;
+    std::vector<ExpHashSet> A_orig_copy = A_orig;
     A_orig.clear();
-    for (std::set<SharedExp, lessExpStar> &se : A_orig_copy) {
-        std::set<SharedExp, lessExpStar> se_new;
+    for (ExpHashSet &se : A_orig_copy) {
+        ExpHashSet se_new;
         for (const SharedExp &ee : se) {
             SharedExp e = ee->clone();
             e = e->accept(&ic);
@@ -0,0 +1,821 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       decompilecache.cpp
+  * \brief   Implementation of the DecompileCache class.
+  ******************************************************************************/
+
+#include "decompilecache.h"
+
+#include "progserializer.h"
+#include "boomerang.h"
+#include "log.h"
+#include "prog.h"
+#include "proc.h"
+#include "cfg.h"
+#include "basicblock.h"
+#include "rtl.h"
+#include "statement.h"
+#include "signature.h"
+#include "exp.h"
+#include "type.h"
+#include "IBinaryImage.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QRegularExpression>
+#include <QtCore/QSaveFile>
+#include <QtCore/QTextStream>
+#include <algorithm>
+
+namespace {
+const quint32 CACHE_MAGIC = 0x42444331; // "BDC1"
+//! Bump whenever the encoding, or the meaning of a summary, changes
+const quint32 CACHE_VERSION = 2;
+
+QByteArray sha1(const QByteArray &data) { return QCryptographicHash::hash(data, QCryptographicHash::Sha1); }
+
+//! True if \a e contains a subscript with a real definition; such locations cannot be restored
+bool hasDefinedRef(const SharedExp &e) {
+    if (e == nullptr)
+        return false;
+    if (e->isSubscript() && std::static_pointer_cast<RefExp>(e)->getDef() != nullptr)
+        return true;
+    return hasDefinedRef(e->getSubExp1()) || hasDefinedRef(e->getSubExp2()) || hasDefinedRef(e->getSubExp3());
+}
+
+//! The call statement that ends \a bb, if any
+CallStatement *callOf(BasicBlock *bb) {
+    BasicBlock::rtlrit rrit;
+    StatementList::reverse_iterator srit;
+    return dynamic_cast<CallStatement *>(bb->getLastStmt(rrit, srit));
+}
+
+//! Offset of \a a from the entry \a entry of a procedure
+qint64 offsetFrom(ADDRESS entry, ADDRESS a) { return qint64(a.m_value) - qint64(entry.m_value); }
+
+/***************************************************************************/ /**
+  * \brief Print the RTLs of \a bb for the key of a procedure entered at \a entry
+  * Instruction addresses are printed as offsets from \a entry, and so are the integer constants in [\a lo, \a hi]
+  * (branch targets and the other addresses inside the procedure), so that a procedure that only moved keeps its key.
+  ******************************************************************************/
+void printRelocated(QTextStream &os, BasicBlock *bb, ADDRESS entry, ADDRESS lo, ADDRESS hi) {
+    if (bb->getRTLs() == nullptr)
+        return;
+    Terminal wild(opWildIntConst);
+    for (RTL *rtl : *bb->getRTLs()) {
+        os << offsetFrom(entry, rtl->getAddress()) << ":";
+        for (Instruction *s : *rtl) {
+            Instruction *c = s->clone();
+            std::list<SharedExp> consts;
+            c->searchAll(wild, consts);
+            for (const SharedExp &k : consts) {
+                ADDRESS a = k->access<Const>()->getAddr();
+                if (a >= lo && a <= hi)
+                    c->searchAndReplace(*k, Const::get(QString("entry%1").arg(offsetFrom(entry, a))));
+            }
+            os << " ";
+            c->print(os);
+            os << "\n";
+            delete c;
+        }
+    }
+}
+
+//! \a code, generated for a procedure called \a name, as it is for \a proc (see CHLLCode::AddProcStart)
+QString relocateCode(QString code, const QString &name, UserProc *proc) {
+    QString start;
+    QTextStream(&start) << "// address: 0x" << proc->getNativeAddress();
+    code.replace(QRegularExpression("^// address: 0x[0-9a-fA-F]+", QRegularExpression::MultilineOption), start);
+    if (!name.isEmpty() && name != proc->getName())
+        code.replace(QRegularExpression("\\b" + QRegularExpression::escape(name) + "\\b"), proc->getName());
+    return code;
+}
+
+typedef std::pair<SharedType, SharedExp> TypedLoc;
+
+//! \returns false if one of \a stmts has no type, and could not be read back
+bool writeTypedLocs(QDataStream &os, ProgSerializer &ser, StatementList &stmts) {
+    bool typed = true;
+    os << quint32(stmts.size());
+    for (Instruction *s : stmts) {
+        Assignment *as = (Assignment *)s;
+        typed &= as->getType() != nullptr;
+        ser.writeType(os, as->getType());
+        ser.writeExp(os, as->getLeft());
+    }
+    return typed;
+}
+
+bool readTypedLocs(QDataStream &is, ProgSerializer &ser, std::vector<TypedLoc> &locs) {
+    quint32 n;
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        SharedType ty = ser.readType(is);
+        SharedExp lhs = ser.readExp(is);
+        if (ty == nullptr || lhs == nullptr)
+            return false;
+        locs.emplace_back(ty, lhs);
+    }
+    return is.status() == QDataStream::Ok;
+}
+
+//! Delete the statements of \a stmts and empty it
+void deleteAll(std::list<Instruction *> &stmts) {
+    for (Instruction *s : stmts)
+        delete s;
+    stmts.clear();
+}
+}
+
+thread_local std::vector<std::pair<ADDRESS, size_t>> *DecompileCache::currentReads = nullptr;
+
+DecompileCache::ReadScope::ReadScope(DecompileCache *c, UserProc *p) : saved(currentReads), cache(c), proc(p) {
+    bool recording = false;
+    if (cache) {
+        QMutexLocker locker(&cache->lock);
+        recording = cache->pending.count(proc) != 0;
+    }
+    currentReads = recording ? &reads : nullptr;
+}
+
+DecompileCache::ReadScope::~ReadScope() {
+    currentReads = saved;
+    if (cache == nullptr || reads.empty())
+        return;
+    QMutexLocker locker(&cache->lock);
+    auto it = cache->pending.find(proc);
+    if (it != cache->pending.end())
+        it->second.reads.insert(it->second.reads.end(), reads.begin(), reads.end());
+}
+
+DecompileCache::DecompileCache(Prog *_prog, const QString &_dir) : prog(_prog), dir(_dir) {
+    QDir().mkpath(dir);
+    Boomerang *boom = Boomerang::get();
+    QDataStream os(&config, QIODevice::WriteOnly);
+    os << CACHE_VERSION << qint32(prog->getFrontEndId()) << boom->noBranchSimplify << boom->noRemoveNull
+       << boom->noLocals << boom->noRemoveLabels << boom->noDataflow << qint32(boom->numToPropagate)
+       << boom->noPromote << boom->propOnlyToAll << qint32(boom->maxMemDepth) << boom->noParameterNames
+       << boom->noRemoveReturns << boom->decodeThruIndCall << boom->noProve << boom->noChangeSignatures
+       << boom->conTypeAnalysis << boom->dfaTypeAnalysis << qint32(boom->propMaxDepth) << boom->noGlobals
+       << boom->assumeABI << boom->experimental;
+}
+
+DecompileCache::~DecompileCache() {
+    // Restores that were never confirmed by revalidate() still own what they replaced
+    for (auto &c : cached)
+        release(c.second);
+}
+
+QString DecompileCache::entryPath(const QByteArray &key) const {
+    return QDir(dir).filePath(QString::fromLatin1(key.toHex()) + ".bdc");
+}
+
+/***************************************************************************/ /**
+  * \brief Hash what the decompilation of \a proc depends on before the global passes
+  * \returns the key, or an empty array if \a proc cannot be cached (e.g. it calls a procedure that is not final)
+  ******************************************************************************/
+QByteArray DecompileCache::computeKey(UserProc *proc) {
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    h.addData(config);
+    // Nothing in the key depends on where the procedure is or what it is called: blocks are keyed by their offset from
+    // the entry (not by the order they were decoded in), and the callees by the offset of their call
+    ADDRESS entry = proc->getNativeAddress();
+    ADDRESS lo = entry, hi = entry;
+    Cfg *cfg = proc->getCFG();
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        lo = std::min(lo, bb->getLowAddr());
+        hi = std::max(hi, bb->getHiAddr());
+    }
+    std::map<qint64, QString> blocks;
+    std::map<qint64, Function *> callees;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        QString text;
+        QTextStream os(&text);
+        printRelocated(os, bb, entry, lo, hi);
+        os.flush();
+        blocks[offsetFrom(entry, bb->getLowAddr())] += text;
+        CallStatement *call = callOf(bb);
+        if (call && call->getDestProc())
+            callees[offsetFrom(entry, bb->getHiAddr())] = call->getDestProc();
+    }
+    for (auto &b : blocks)
+        h.addData(b.second.toUtf8());
+    // The calls print the name of their callee, which the cached code uses; the summary is what the callee is
+    for (auto &c : callees) {
+        Function *f = c.second;
+        if (!f->isLib() && !((UserProc *)f)->isDecompiled())
+            return QByteArray();
+        QByteArray d = summaryDigest(f);
+        if (d.isEmpty())
+            return QByteArray();
+        h.addData(d);
+    }
+    return h.result();
+}
+
+//! Digest of what callers of \a f see before the global passes; empty if it cannot be serialized
+QByteArray DecompileCache::summaryDigest(Function *f) {
+    QMutexLocker locker(&lock);
+    auto it = summaryDigests.find(f);
+    if (it != summaryDigests.end())
+        return it->second;
+    QByteArray blob;
+    if (f->isLib()) {
+        QDataStream os(&blob, QIODevice::WriteOnly);
+        ProgSerializer ser(prog);
+        os << QString("lib") << f->getName();
+        ser.writeSignature(os, f->getSignature());
+        if (!ser.ok())
+            blob.clear();
+    } else
+        blob = serializeSummary((UserProc *)f);
+    QByteArray d = blob.isEmpty() ? QByteArray() : sha1(blob);
+    summaryDigests[f] = d;
+    return d;
+}
+
+//! Digest of the final signature, parameters and returns of \a f
+QByteArray DecompileCache::interfaceDigest(Function *f) {
+    QMutexLocker locker(&lock);
+    UserProc *proc = f->isLib() ? nullptr : (UserProc *)f;
+    if (proc) {
+        auto it = cached.find(proc);
+        if (it != cached.end())
+            return it->second.entry.finalInterface;
+    }
+    QByteArray blob;
+    QDataStream os(&blob, QIODevice::WriteOnly);
+    ProgSerializer ser(prog, proc);
+    os << f->getName();
+    ser.writeSignature(os, f->getSignature());
+    if (proc) {
+        writeTypedLocs(os, ser, proc->parameters);
+        os << returnLocations(proc);
+    }
+    return ser.ok() ? sha1(blob) : QByteArray();
+}
+
+QByteArray DecompileCache::serializeSummary(UserProc *proc) {
+    QByteArray blob;
+    QDataStream os(&blob, QIODevice::WriteOnly);
+    ProgSerializer ser(prog, proc);
+    // Without the name of the procedure, which applySummary gives back
+    std::shared_ptr<Signature> sig = proc->getSignature()->clone();
+    sig->setName(QString());
+    ser.writeSignature(os, sig);
+    bool typed = writeTypedLocs(os, ser, proc->parameters);
+    ReturnStatement *rs = proc->theReturnStatement;
+    os << bool(rs != nullptr);
+    if (rs) {
+        typed &= writeTypedLocs(os, ser, rs->getReturns());
+        typed &= writeTypedLocs(os, ser, rs->getModifieds());
+    }
+    os << quint32(proc->provenTrue.size());
+    for (auto &pr : proc->provenTrue) {
+        ser.writeExp(os, pr.first);
+        ser.writeExp(os, pr.second);
+    }
+    if (!ser.ok() || !typed)
+        return QByteArray();
+    return blob;
+}
+
+//! The locations of the returns of \a proc, in order
+QByteArray DecompileCache::returnLocations(UserProc *proc) {
+    QByteArray blob;
+    QDataStream os(&blob, QIODevice::WriteOnly);
+    ProgSerializer ser(prog, proc);
+    ReturnStatement *rs = proc->theReturnStatement;
+    os << quint32(rs ? rs->getNumReturns() : 0);
+    if (rs) {
+        for (Instruction *s : rs->getReturns())
+            ser.writeExp(os, ((Assignment *)s)->getLeft());
+    }
+    return blob;
+}
+
+//! Hash the current contents of the image at \a ranges
+QByteArray DecompileCache::readDigest(const std::vector<std::pair<ADDRESS, quint32>> &ranges) {
+    QCryptographicHash h(QCryptographicHash::Sha1);
+    IBinaryImage *image = Boomerang::get()->getImage();
+    std::vector<std::pair<ADDRESS, size_t>> *saved = currentReads;
+    currentReads = nullptr; // checking is not reading
+    for (const std::pair<ADDRESS, quint32> &r : ranges) {
+        h.addData(QByteArray::number(qulonglong(r.first.m_value)) + ':' + QByteArray::number(r.second));
+        const uint8_t *p = image->readSpan(r.first, r.second);
+        if (p)
+            h.addData((const char *)p, r.second);
+        else
+            h.addData("unmapped");
+    }
+    currentReads = saved;
+    return h.result();
+}
+
+bool DecompileCache::readEntry(const QString &path, Entry &e) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QDataStream is(&file);
+    is.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, n;
+    is >> magic >> version;
+    if (magic != CACHE_MAGIC || version != CACHE_VERSION)
+        return false;
+    is >> e.key >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        quint64 addr;
+        quint32 len;
+        is >> addr >> len;
+        e.reads.emplace_back(ADDRESS::g(addr), len);
+    }
+    is >> e.readDigest >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        CalleeRef c;
+        is >> c.name >> c.summary >> c.iface;
+        e.callees.push_back(c);
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        GlobalRef g;
+        quint64 addr;
+        is >> g.name >> addr >> g.type;
+        g.addr = ADDRESS::g(addr);
+        e.globals.push_back(g);
+    }
+    is >> e.summary >> e.summaryDigest >> e.finalReturns >> e.finalInterface >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        qint64 offset;
+        QByteArray blob;
+        is >> offset >> blob;
+        e.liveness.emplace_back(offset, blob);
+    }
+    is >> e.name >> e.signature >> e.code;
+    return is.status() == QDataStream::Ok;
+}
+
+bool DecompileCache::writeEntry(const QString &path, const Entry &e) {
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream os(&file);
+    os.setVersion(QDataStream::Qt_5_0);
+    os << CACHE_MAGIC << CACHE_VERSION << e.key << quint32(e.reads.size());
+    for (auto &r : e.reads)
+        os << quint64(r.first.m_value) << r.second;
+    os << e.readDigest << quint32(e.callees.size());
+    for (const CalleeRef &c : e.callees)
+        os << c.name << c.summary << c.iface;
+    os << quint32(e.globals.size());
+    for (const GlobalRef &g : e.globals)
+        os << g.name << quint64(g.addr.m_value) << g.type;
+    os << e.summary << e.summaryDigest << e.finalReturns << e.finalInterface << quint32(e.liveness.size());
+    for (auto &l : e.liveness)
+        os << l.first << l.second;
+    os << e.name << e.signature << e.code;
+    return os.status() == QDataStream::Ok && file.commit();
+}
+
+/***************************************************************************/ /**
+  * \brief Look \a proc up, and restore its summary on a hit
+  * Called by UserProc::decompile when all the callees of \a proc are final. On a miss, \a proc is recorded so that it
+  * can be stored once its code has been generated.
+  * \returns true if \a proc was restored; the caller then marks it final
+  ******************************************************************************/
+bool DecompileCache::restore(UserProc *proc) {
+    {
+        QMutexLocker locker(&lock);
+        if (proc->cycleGrp || late.count(proc) || cached.count(proc) || pending.count(proc))
+            return false;
+    }
+    QByteArray key = computeKey(proc);
+    if (key.isEmpty())
+        return false;
+
+    Restored r;
+    bool hit = readEntry(entryPath(key), r.entry) && r.entry.key == key;
+    for (const CalleeRef &c : r.entry.callees) {
+        if (!hit)
+            break;
+        Function *f = prog->findProc(c.name);
+        hit = f && (f->isLib() || ((UserProc *)f)->isDecompiled()) && summaryDigest(f) == c.summary;
+    }
+    hit = hit && readDigest(r.entry.reads) == r.entry.readDigest && applySummary(proc, r);
+
+    QMutexLocker locker(&lock);
+    if (!hit) {
+        pending[proc].entry.key = key;
+        ++misses;
+        return false;
+    }
+    LOG_VERBOSE(1) << "restored " << proc->getName() << " from the decompile cache\n";
+    summaryDigests[proc] = r.entry.summaryDigest;
+    cached[proc] = std::move(r);
+    ++hits;
+    return true;
+}
+
+//! Create the globals of a cached procedure that do not exist yet; false if one conflicts with an existing global
+bool DecompileCache::claimGlobals(const std::vector<GlobalRef> &refs) {
+    Prog::waitForSerialTurn(); // Not with the lock held
+    QMutexLocker locker(&prog->m_globalsLock);
+    ProgSerializer ser(prog);
+    std::vector<Global *> created;
+    bool ok = true;
+    for (const GlobalRef &g : refs) {
+        Global *existing = prog->getGlobal(g.name);
+        if (existing) {
+            ok = existing->getAddress() == g.addr;
+        } else {
+            QString other = prog->getGlobalName(g.addr);
+            QDataStream is(g.type);
+            SharedType ty = ser.readType(is);
+            ok = (other.isEmpty() || other == g.name) && ty != nullptr && is.status() == QDataStream::Ok;
+            if (ok)
+                created.push_back(new Global(ty, g.addr, g.name, prog));
+        }
+        if (!ok)
+            break;
+    }
+    if (!ok) {
+        for (Global *g : created)
+            delete g;
+        return false;
+    }
+    for (Global *g : created)
+        prog->globals.insert(g);
+    return true;
+}
+
+//! Decode the entry of \a r and, if all of it is usable, apply it to \a proc
+bool DecompileCache::applySummary(UserProc *proc, Restored &r) {
+    const Entry &e = r.entry;
+    ProgSerializer ser(prog, proc);
+    QDataStream is(e.summary);
+    bool hasReturn;
+    std::vector<TypedLoc> params, returns, modifieds;
+    std::vector<std::pair<SharedExp, SharedExp>> proven;
+    std::shared_ptr<Signature> sig = ser.readSignature(is);
+    if (!readTypedLocs(is, ser, params))
+        return false;
+    is >> hasReturn;
+    if (hasReturn && (!readTypedLocs(is, ser, returns) || !readTypedLocs(is, ser, modifieds)))
+        return false;
+    quint32 n;
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        SharedExp lhs = ser.readExp(is);
+        SharedExp rhs = ser.readExp(is);
+        if (lhs == nullptr || rhs == nullptr)
+            return false;
+        proven.emplace_back(lhs, rhs);
+    }
+    QDataStream ss(e.signature);
+    r.codeSignature = ser.readSignature(ss);
+    std::map<qint64, std::vector<SharedExp>> live;
+    for (auto &l : e.liveness) {
+        QDataStream ls(l.second);
+        std::vector<SharedExp> &locs = live[l.first];
+        ls >> n;
+        for (quint32 i = 0; i < n && ls.status() == QDataStream::Ok; ++i) {
+            SharedExp loc = ser.readExp(ls);
+            if (loc == nullptr)
+                return false;
+            locs.push_back(loc);
+        }
+        if (ls.status() != QDataStream::Ok)
+            return false;
+    }
+    ReturnStatement *rs = proc->theReturnStatement;
+    if (is.status() != QDataStream::Ok || ss.status() != QDataStream::Ok || sig == nullptr ||
+        r.codeSignature == nullptr || hasReturn != (rs != nullptr))
+        return false;
+    if (!claimGlobals(e.globals))
+        return false;
+
+    // The entry may have been stored for a procedure with another name or address
+    sig->setName(proc->getName());
+    r.codeSignature->setName(proc->getName());
+    r.entry.code = relocateCode(e.code, e.name, proc);
+
+    r.oldStatus = proc->status;
+    r.oldSignature = proc->signature;
+    r.oldParameters.assign(proc->parameters.begin(), proc->parameters.end());
+    r.oldProven.assign(proc->provenTrue.begin(), proc->provenTrue.end());
+    proc->setSignature(sig);
+    proc->parameters.clear();
+    for (TypedLoc &p : params) {
+        ImplicitAssign *ia = new ImplicitAssign(p.first, p.second);
+        ia->setProc(proc);
+        proc->parameters.append(ia);
+    }
+    if (rs) {
+        r.oldReturns.assign(rs->getReturns().begin(), rs->getReturns().end());
+        r.oldModifieds.assign(rs->getModifieds().begin(), rs->getModifieds().end());
+        rs->getReturns().clear();
+        rs->getModifieds().clear();
+        for (TypedLoc &ret : returns) {
+            Assign *as = new Assign(ret.first, ret.second, ret.second->clone());
+            as->setProc(proc);
+            as->setBB(rs->getBB());
+            rs->getReturns().append(as);
+        }
+        for (TypedLoc &mod : modifieds) {
+            ImplicitAssign *ia = new ImplicitAssign(mod.first, mod.second);
+            ia->setProc(proc);
+            ia->setBB(rs->getBB());
+            rs->getModifieds().append(ia);
+        }
+    }
+    proc->provenTrue.clear();
+    for (auto &pr : proven)
+        proc->provenTrue[pr.first] = pr.second;
+
+    // The calls are what the callees see of this procedure: register them as callers, and make the liveness the
+    // callees' removeRedundantReturns needs available
+    Cfg *cfg = proc->getCFG();
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        CallStatement *call = callOf(bb);
+        if (call == nullptr)
+            continue;
+        Function *dest = call->getDestProc();
+        if (dest) {
+            call->setSigArguments();
+            if (!dest->isLib())
+                call->setCalleeReturn(((UserProc *)dest)->getTheReturnStatement());
+        }
+        auto lv = live.find(offsetFrom(proc->getNativeAddress(), bb->getHiAddr()));
+        if (lv != live.end()) {
+            for (SharedExp &loc : lv->second)
+                call->getUseCollector()->insert(loc);
+        }
+    }
+    return true;
+}
+
+//! Undo the restore of \a proc, so that it can be decompiled normally. The restored statements are deleted, and
+//! \a proc takes back the ones \a r held
+void DecompileCache::undo(UserProc *proc, Restored &r) {
+    proc->setSignature(r.oldSignature);
+    deleteAll(proc->parameters);
+    proc->parameters.insert(proc->parameters.end(), r.oldParameters.begin(), r.oldParameters.end());
+    r.oldParameters.clear();
+    ReturnStatement *rs = proc->theReturnStatement;
+    if (rs) {
+        deleteAll(rs->getReturns());
+        deleteAll(rs->getModifieds());
+        rs->getReturns().assign(r.oldReturns.begin(), r.oldReturns.end());
+        rs->getModifieds().assign(r.oldModifieds.begin(), r.oldModifieds.end());
+    }
+    r.oldReturns.clear();
+    r.oldModifieds.clear();
+    proc->provenTrue.clear();
+    for (auto &pr : r.oldProven)
+        proc->provenTrue[pr.first] = pr.second;
+    Cfg *cfg = proc->getCFG();
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        CallStatement *call = callOf(bb);
+        if (call)
+            call->getUseCollector()->clear();
+    }
+    proc->setStatus((ProcStatus)r.oldStatus);
+}
+
+//! The restore of \a r is final: delete the statements it replaced
+void DecompileCache::release(Restored &r) {
+    deleteAll(r.oldParameters);
+    deleteAll(r.oldReturns);
+    deleteAll(r.oldModifieds);
+}
+
+bool DecompileCache::isCached(UserProc *proc) {
+    QMutexLocker locker(&lock);
+    return cached.count(proc) != 0;
+}
+
+//! \a proc became final: remember its summary, for the keys of its callers and for its own entry
+void DecompileCache::noteDecompiled(UserProc *proc) {
+    QMutexLocker locker(&lock);
+    // A late procedure keeps the summary digest it was restored with: that is what it is before the global passes
+    if (late.count(proc))
+        return;
+    QByteArray blob = serializeSummary(proc);
+    QByteArray digest = blob.isEmpty() ? QByteArray() : sha1(blob);
+    summaryDigests[proc] = digest;
+    auto it = pending.find(proc);
+    if (it == pending.end())
+        return;
+    if (blob.isEmpty() || proc->cycleGrp) {
+        it->second.failed = true;
+        return;
+    }
+    it->second.entry.summary = blob;
+    it->second.entry.summaryDigest = digest;
+    it->second.summarised = true;
+}
+
+bool DecompileCache::isStale(UserProc *proc, Restored &r) {
+    if (returnLocations(proc) != r.entry.finalReturns)
+        return true;
+    for (const CalleeRef &c : r.entry.callees) {
+        Function *f = prog->findProc(c.name);
+        if (f == nullptr || interfaceDigest(f) != c.iface)
+            return true;
+    }
+    return false;
+}
+
+/***************************************************************************/ /**
+  * \brief Confirm the restored procedures once the returns of the whole program are known
+  * A restored procedure whose final returns or callee interfaces differ from those it was stored with is decompiled
+  * after all, which can in turn change the interfaces its other callees see; repeat until nothing changes.
+  ******************************************************************************/
+void DecompileCache::revalidate() {
+    bool change = true;
+    while (change) {
+        change = false;
+        for (auto it = cached.begin(); it != cached.end(); ++it) {
+            UserProc *proc = it->first;
+            if (!isStale(proc, it->second))
+                continue;
+            LOG_VERBOSE(1) << "cached procedure " << proc->getName() << " is stale, decompiling it\n";
+            Restored r = std::move(it->second);
+            {
+                QMutexLocker locker(&lock);
+                cached.erase(it);
+                late.insert(proc);
+                ++stale;
+            }
+            undo(proc, r);
+            ProcList path;
+            int indent = 0;
+            proc->decompile(&path, indent);
+            proc->typeAnalysis();
+            std::set<UserProc *> removeRetSet;
+            removeRetSet.insert(proc);
+            while (!removeRetSet.empty()) {
+                auto first = removeRetSet.begin();
+                (*first)->removeRedundantReturns(removeRetSet);
+                removeRetSet.erase(first);
+            }
+            change = true;
+            break;
+        }
+    }
+    // The code was generated with the signature as it was at that time; what the restores replaced is not needed
+    // any more
+    for (auto &c : cached) {
+        c.first->setSignature(c.second.codeSignature);
+        release(c.second);
+    }
+}
+
+//! Record the final interfaces, callees and liveness of the procedures that will be stored
+void DecompileCache::captureInterfaces() {
+    QMutexLocker locker(&lock);
+    for (auto &pp : pending) {
+        UserProc *proc = pp.first;
+        Pending &p = pp.second;
+        if (p.failed || !p.summarised || proc->cycleGrp || late.count(proc)) {
+            p.failed = true;
+            continue;
+        }
+        Entry &e = p.entry;
+        e.finalReturns = returnLocations(proc);
+        e.finalInterface = interfaceDigest(proc);
+        std::map<QString, Function *> callees;
+        Cfg *cfg = proc->getCFG();
+        BB_IT it;
+        for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+            CallStatement *call = callOf(bb);
+            if (call == nullptr)
+                continue;
+            if (call->getDestProc())
+                callees[call->getDestProc()->getName()] = call->getDestProc();
+            QByteArray blob;
+            QDataStream os(&blob, QIODevice::WriteOnly);
+            ProgSerializer ser(prog, proc);
+            std::vector<SharedExp> locs;
+            for (const SharedExp &loc : *call->getUseCollector())
+                if (!hasDefinedRef(loc))
+                    locs.push_back(loc);
+            os << quint32(locs.size());
+            for (const SharedExp &loc : locs)
+                ser.writeExp(os, loc);
+            p.failed |= !ser.ok();
+            e.liveness.emplace_back(offsetFrom(proc->getNativeAddress(), bb->getHiAddr()), blob);
+        }
+        for (auto &c : callees) {
+            CalleeRef ref;
+            ref.name = c.first;
+            ref.summary = summaryDigest(c.second);
+            ref.iface = interfaceDigest(c.second);
+            p.failed |= ref.summary.isEmpty() || ref.iface.isEmpty();
+            e.callees.push_back(ref);
+        }
+        p.failed |= e.finalInterface.isEmpty();
+        p.captured = true;
+    }
+}
+
+//! Add the globals used by the cached code of \a proc to \a used
+void DecompileCache::addUsedGlobals(UserProc *proc, std::list<SharedExp> &used) {
+    QMutexLocker locker(&lock);
+    auto it = cached.find(proc);
+    if (it == cached.end())
+        return;
+    for (const GlobalRef &g : it->second.entry.globals)
+        used.push_back(Location::global(g.name, proc));
+}
+
+QString DecompileCache::cachedCode(UserProc *proc) {
+    QMutexLocker locker(&lock);
+    auto it = cached.find(proc);
+    return it == cached.end() ? QString() : it->second.entry.code;
+}
+
+//! The code of \a proc was generated: complete its entry
+void DecompileCache::noteCode(UserProc *proc, const QString &code) {
+    QMutexLocker locker(&lock);
+    auto it = pending.find(proc);
+    if (it == pending.end() || it->second.failed || !it->second.captured)
+        return;
+    Pending &p = it->second;
+    Entry &e = p.entry;
+    ProgSerializer ser(prog, proc);
+    {
+        QDataStream os(&e.signature, QIODevice::WriteOnly);
+        ser.writeSignature(os, proc->getSignature());
+    }
+
+    // The globals the code refers to
+    Location search(opGlobal, Terminal::get(opWild), proc);
+    std::list<SharedExp> found;
+    StatementList stmts;
+    proc->getStatements(stmts);
+    for (Instruction *s : stmts) {
+        if (!s->isImplicit())
+            s->searchAll(search, found);
+    }
+    std::map<QString, Global *> globals;
+    for (const SharedExp &g : found) {
+        QString name = g->access<Const, 1>()->getStr();
+        Global *glob = prog->getGlobal(name);
+        if (glob)
+            globals[name] = glob;
+    }
+    for (auto &g : globals) {
+        GlobalRef ref;
+        ref.name = g.first;
+        ref.addr = g.second->getAddress();
+        QDataStream os(&ref.type, QIODevice::WriteOnly);
+        ser.writeType(os, g.second->getType());
+        e.globals.push_back(ref);
+    }
+
+    // The reads, merged into ranges
+    std::sort(p.reads.begin(), p.reads.end());
+    for (const std::pair<ADDRESS, size_t> &r : p.reads) {
+        if (r.second == 0)
+            continue;
+        quint64 lo = r.first.m_value, hi = lo + r.second;
+        if (!e.reads.empty()) {
+            auto &last = e.reads.back();
+            quint64 lastHi = last.first.m_value + last.second;
+            if (lo <= lastHi) {
+                last.second = quint32(std::max(hi, lastHi) - last.first.m_value);
+                continue;
+            }
+        }
+        e.reads.emplace_back(r.first, quint32(r.second));
+    }
+    e.readDigest = readDigest(e.reads);
+    e.name = proc->getName();
+    e.code = code;
+    p.failed |= !ser.ok();
+    p.generated = true;
+}
+
+//! Store the completed entries
+void DecompileCache::flush() {
+    QMutexLocker locker(&lock);
+    for (auto &pp : pending) {
+        Pending &p = pp.second;
+        if (p.generated && !p.failed && writeEntry(entryPath(p.entry.key), p.entry))
+            ++stored;
+    }
+    pending.clear();
+    LOG_STREAM() << "decompile cache: " << hits << " hits, " << misses << " misses, " << stale << " stale, " << stored
+                 << " stored\n";
+}
@@ -0,0 +1,203 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       decompilestats.cpp
+  * \brief   Implementation of the DecompileStats class.
+  ******************************************************************************/
+
+#include "decompilestats.h"
+
+#include "boomerang.h"
+#include "proc.h"
+#include "statement.h"
+#include "managed.h"
+
+#include <QtCore/QJsonArray>
+#include <QtCore/QJsonDocument>
+#include <QtCore/QJsonObject>
+#include <QtCore/QSaveFile>
+#include <algorithm>
+#include <vector>
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+namespace {
+const char *const phaseNames[DecompileStats::NUM_PHASES] = {
+    "initialise", "early", "middle", "remUnusedStmtEtc", "typeAnalysis", "fromSSAform", "codegen"};
+}
+
+thread_local DecompileStats::Phase *DecompileStats::Phase::current = nullptr;
+
+DecompileStats::Phase::Phase(DecompileStats *s, UserProc *p, PhaseKind k)
+    : stats(s), proc(p), kind(k), outer(nullptr) {
+    if (stats == nullptr)
+        return;
+    outer = current;
+    current = this;
+    timer.start();
+}
+
+DecompileStats::Phase::~Phase() {
+    if (stats == nullptr)
+        return;
+    qint64 elapsed = timer.nsecsElapsed();
+    current = outer;
+    if (outer)
+        outer->nestedNsecs += elapsed;
+    stats->endPhase(proc, kind, elapsed - nestedNsecs);
+}
+
+void DecompileStats::endPhase(UserProc *proc, PhaseKind kind, qint64 nsecs) {
+    // Count outside the lock; the procedure is only worked on by this thread
+    StatementList stmts;
+    proc->getStatements(stmts);
+    int phis = 0;
+    for (Instruction *s : stmts)
+        if (s->isPhi())
+            ++phis;
+    qint64 rss = peakRss();
+    QMutexLocker guard(&lock);
+    PhaseStats &ps = procs[proc].phases[kind];
+    ps.nsecs += nsecs;
+    ++ps.runs;
+    ps.statements = int(stmts.size());
+    ps.phis = phis;
+    ps.peakRss = std::max(ps.peakRss, rss);
+}
+
+void DecompileStats::addPropagations(UserProc *proc, int n) {
+    QMutexLocker guard(&lock);
+    procs[proc].propagations += n;
+}
+
+void DecompileStats::addProverCall(UserProc *proc) {
+    QMutexLocker guard(&lock);
+    ++procs[proc].proverCalls;
+}
+
+void DecompileStats::addProofMemoLookup(UserProc *proc, bool hit) {
+    QMutexLocker guard(&lock);
+    ProcStats &s = procs[proc];
+    ++s.proofMemoLookups;
+    if (hit)
+        ++s.proofMemoHits;
+}
+
+/// \returns the peak resident set size of the process so far, in kB, or 0 where it is not measured
+qint64 DecompileStats::peakRss() {
+#ifdef Q_OS_UNIX
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0)
+        return 0;
+#ifdef Q_OS_MAC
+    return ru.ru_maxrss / 1024; // bytes
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+/***************************************************************************/ /**
+  * \brief Write the statistics as a JSON document to \a path.
+  *
+  * The procedures are listed slowest first. Times are in milliseconds, memory in kB.
+  * \returns false if the file could not be written
+  ******************************************************************************/
+bool DecompileStats::writeJson(const QString &path) {
+    QMutexLocker guard(&lock);
+    auto ms = [](qint64 nsecs) { return double(nsecs) / 1e6; };
+    auto procTime = [](const ProcStats &s) {
+        qint64 t = 0;
+        for (int i = 0; i < NUM_PHASES; ++i)
+            t += s.phases[i].nsecs;
+        return t;
+    };
+    std::vector<std::pair<UserProc *, const ProcStats *>> order;
+    for (const auto &p : procs)
+        order.emplace_back(p.first, &p.second);
+    std::sort(order.begin(), order.end(),
+              [&procTime](const std::pair<UserProc *, const ProcStats *> &a,
+                          const std::pair<UserProc *, const ProcStats *> &b) {
+                  return procTime(*a.second) > procTime(*b.second);
+              });
+
+    PhaseStats totals[NUM_PHASES];
+    qint64 propagations = 0, proverCalls = 0, memoLookups = 0, memoHits = 0;
+    QJsonArray procList;
+    for (const auto &p : order) {
+        const ProcStats &s = *p.second;
+        QJsonObject phases;
+        qint64 peak = 0;
+        int statements = 0, phis = 0;
+        for (int i = 0; i < NUM_PHASES; ++i) {
+            const PhaseStats &ps = s.phases[i];
+            if (ps.runs == 0)
+                continue;
+            QJsonObject phase;
+            phase["ms"] = ms(ps.nsecs);
+            phase["runs"] = ps.runs;
+            phase["statements"] = ps.statements;
+            phase["phis"] = ps.phis;
+            phase["peak_rss_kb"] = double(ps.peakRss);
+            phases[phaseNames[i]] = phase;
+            totals[i].nsecs += ps.nsecs;
+            totals[i].runs += ps.runs;
+            totals[i].peakRss = std::max(totals[i].peakRss, ps.peakRss);
+            statements = std::max(statements, ps.statements);
+            phis = std::max(phis, ps.phis);
+            peak = std::max(peak, ps.peakRss);
+        }
+        QJsonObject proc;
+        proc["name"] = p.first->getName();
+        proc["address"] = QString("0x%1").arg(qulonglong(p.first->getNativeAddress().m_value), 0, 16);
+        proc["ms"] = ms(procTime(s));
+        proc["max_statements"] = statements;
+        proc["max_phis"] = phis;
+        proc["propagations"] = s.propagations;
+        proc["prover_calls"] = s.proverCalls;
+        proc["proof_memo_lookups"] = s.proofMemoLookups;
+        proc["proof_memo_hits"] = s.proofMemoHits;
+        proc["peak_rss_kb"] = double(peak);
+        proc["phases"] = phases;
+        procList.append(proc);
+        propagations += s.propagations;
+        proverCalls += s.proverCalls;
+        memoLookups += s.proofMemoLookups;
+        memoHits += s.proofMemoHits;
+    }
+    QJsonObject phaseTotals;
+    for (int i = 0; i < NUM_PHASES; ++i) {
+        QJsonObject phase;
+        phase["ms"] = ms(totals[i].nsecs);
+        phase["runs"] = totals[i].runs;
+        phase["peak_rss_kb"] = double(totals[i].peakRss);
+        phaseTotals[phaseNames[i]] = phase;
+    }
+    QJsonObject root;
+    root["total_ms"] = ms(total.nsecsElapsed());
+    root["peak_rss_kb"] = double(peakRss());
+    root["procedures_count"] = int(procs.size());
+    root["propagations"] = double(propagations);
+    root["prover_calls"] = double(proverCalls);
+    root["proof_memo_lookups"] = double(memoLookups);
+    root["proof_memo_hits"] = double(memoHits);
+    root["proof_memo_hit_rate"] = memoLookups ? double(memoHits) / memoLookups : 0.0;
+    root["phases"] = phaseTotals;
+    root["procedures"] = procList;
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        LOG_STREAM() << "cannot open " << path << " for writing\n";
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson());
+    return file.commit();
+}
@@ -24,11 +24,13 @@
 #include "operstrings.h" // Defines a large array of strings for the createDotFile etc. functions. Needs -I. to find it
 #include "util.h"
 #include "boomerang.h"
-//#include "transformer.h"
+#include "transformer.h"
 #include "visitor.h"
 #include "log.h"
 #include <QRegularExpression>
+#include <QtCore/QHash>
 #include <iomanip> // For std::setw etc
+#include <atomic>
 
 extern char debug_buffer[]; ///< For prints functions
 static int tlstrchr(const QString &str, char ch);
@@ -108,7 +110,7 @@ FlagDef::FlagDef(SharedExp params, SharedRTL rtl) : Unary(opFlagDef, params), rt
 RefExp::RefExp(SharedExp e, Instruction *d) : Unary(opSubscript, e), def(d) { assert(e); }
 
 std::shared_ptr<RefExp> RefExp::get(SharedExp e, Instruction * def) {
-    return std::make_shared<RefExp>(e, def);
+    return makeArenaShared<RefExp>(e, def);
 }
 
 TypeVal::TypeVal(SharedType ty) : Terminal(opTypeVal), val(ty) {}
@@ -183,6 +185,7 @@ TypeVal::~TypeVal() {
   ******************************************************************************/
 void Unary::setSubExp1(SharedExp e) {
     subExp1 = e;
+    simplifiedIn = 0;
     assert(subExp1);
 }
 void Binary::setSubExp2(SharedExp e) {
@@ -190,6 +193,7 @@ void Binary::setSubExp2(SharedExp e) {
         ; // delete subExp2;
     }
     subExp2 = e;
+    simplifiedIn = 0;
     assert(subExp1 && subExp2);
 }
 void Ternary::setSubExp3(SharedExp e) {
@@ -197,6 +201,7 @@ void Ternary::setSubExp3(SharedExp e) {
         ; // delete subExp3;
     }
     subExp3 = e;
+    simplifiedIn = 0;
     assert(subExp1 && subExp2 && subExp3);
 }
 /***************************************************************************/ /**
@@ -255,6 +260,7 @@ SharedExp & Exp::refSubExp3() { return dummy; }
 /// Swap the two subexpressions.
 void Binary::commute() {
     std::swap(subExp1,subExp2);
+    simplifiedIn = 0;
     assert(subExp1 && subExp2);
 }
 
@@ -270,34 +276,34 @@ SharedExp Const::clone() const {
     // Note: not actually cloning the Type* type pointer. Probably doesn't matter with GC
     return Const::get(*this);
 }
-SharedExp Terminal::clone() const { return std::make_shared<Terminal>(*this); }
+SharedExp Terminal::clone() const { return makeArenaShared<Terminal>(*this); }
 SharedExp Unary::clone() const {
     assert(subExp1);
-    return std::make_shared<Unary>(op,subExp1->clone());
+    return makeArenaShared<Unary>(op,subExp1->clone());
 }
 SharedExp Binary::clone() const {
     assert(subExp1 && subExp2);
-    return std::make_shared<Binary>(op,subExp1->clone(),subExp2->clone());
+    return makeArenaShared<Binary>(op,subExp1->clone(),subExp2->clone());
 }
 
 SharedExp Ternary::clone() const {
     assert(subExp1 && subExp2 && subExp3);
-    std::shared_ptr<Ternary> c = std::make_shared<Ternary>(op,subExp1->clone(),subExp2->clone(),subExp3->clone());
+    std::shared_ptr<Ternary> c = makeArenaShared<Ternary>(op,subExp1->clone(),subExp2->clone(),subExp3->clone());
     return c;
 }
 SharedExp TypedExp::clone() const {
-    return std::make_shared<TypedExp>(type, subExp1->clone());
+    return makeArenaShared<TypedExp>(type, subExp1->clone());
 }
 SharedExp RefExp::clone() const {
     return RefExp::get(subExp1->clone(), def);
 }
 
 SharedExp TypeVal::clone() const {
-    return std::make_shared<TypeVal>(val->clone());
+    return makeArenaShared<TypeVal>(val->clone());
 }
 
 SharedExp Location::clone() const {
-    return std::make_shared<Location>(op, subExp1->clone(), proc);
+    return makeArenaShared<Location>(op, subExp1->clone(), proc);
 }
 
 /***************************************************************************/ /**
@@ -322,10 +328,14 @@ bool Const::operator==(const Exp &o) const {
     switch (op) {
     case opIntConst:
         return u.i == ((Const &)o).u.i;
+    case opLongConst:
+        return u.ll == ((Const &)o).u.ll;
     case opFltConst:
         return u.d == ((Const &)o).u.d;
     case opStrConst:
         return strin == ((Const &)o).strin;
+    case opFuncConst:
+        return u.pp == ((Const &)o).u.pp;
     default:
         LOG << "Operator== invalid operator " << operStrings[op] << "\n";
         assert(false);
@@ -448,10 +458,14 @@ bool Const::operator<(const Exp &o) const {
     switch (op) {
     case opIntConst:
         return u.i < ((Const &)o).u.i;
+    case opLongConst:
+        return u.ll < ((Const &)o).u.ll;
     case opFltConst:
         return u.d < ((Const &)o).u.d;
     case opStrConst:
         return strin < ((Const &)o).strin;
+    case opFuncConst:
+        return std::less<const Function *>()(u.pp, ((Const &)o).u.pp);
     default:
         LOG << "Operator< invalid operator " << operStrings[op] << "\n";
         assert(false);
@@ -465,6 +479,8 @@ bool Unary::operator<(const Exp &o) const {
         return true;
     if (op > o.getOper())
         return false;
+    if (subExp1 == ((Unary &)o).subExp1)
+        return false; // Shared subexpression
     return *subExp1 < *((Unary &)o).getSubExp1();
 }
 
@@ -474,9 +490,14 @@ bool Binary::operator<(const Exp &o) const {
         return true;
     if (op > o.getOper())
         return false;
-    if (*subExp1 < *((Binary &)o).getSubExp1())
-        return true;
-    if (*((Binary &)o).getSubExp1() < *subExp1)
+    // Identical subexpression pointers are equal; skip the deep compare
+    if (subExp1 != ((Binary &)o).subExp1) {
+        if (*subExp1 < *((Binary &)o).getSubExp1())
+            return true;
+        if (*((Binary &)o).getSubExp1() < *subExp1)
+            return false;
+    }
+    if (subExp2 == ((Binary &)o).subExp2)
         return false;
     return *subExp2 < *((Binary &)o).getSubExp2();
 }
@@ -486,13 +507,19 @@ bool Ternary::operator<(const Exp &o) const {
         return true;
     if (op > o.getOper())
         return false;
-    if (*subExp1 < *((Ternary &)o).getSubExp1())
-        return true;
-    if (*((Ternary &)o).getSubExp1() < *subExp1)
-        return false;
-    if (*subExp2 < *((Ternary &)o).getSubExp2())
-        return true;
-    if (*((Ternary &)o).getSubExp2() < *subExp2)
+    if (subExp1 != ((Ternary &)o).subExp1) {
+        if (*subExp1 < *((Ternary &)o).getSubExp1())
+            return true;
+        if (*((Ternary &)o).getSubExp1() < *subExp1)
+            return false;
+    }
+    if (subExp2 != ((Ternary &)o).subExp2) {
+        if (*subExp2 < *((Ternary &)o).getSubExp2())
+            return true;
+        if (*((Ternary &)o).getSubExp2() < *subExp2)
+            return false;
+    }
+    if (subExp3 == ((Ternary &)o).subExp3)
         return false;
     return *subExp3 < *((Ternary &)o).getSubExp3();
 }
@@ -2225,16 +2252,48 @@ SharedExp Exp::Accumulate(std::list<SharedExp> &exprs) {
   * We're trying to do it with a simple iterative algorithm, but the algorithm keeps getting more and more complex.
   * Eventually I will replace this with a simple theorem prover and we'll have something powerful, but until then,
   * dont rely on this code to do anything critical. - trent 8/7/2002
+  *
+  * Simplification is bottom up: polySimplify simplifies each subexpression to a fixed point first (see
+  * simplifySubExp), so the loop below only has to redo this level. Subtrees simplified earlier in the same call
+  * (the outermost simplify() of this thread) are not walked again. Later calls walk them again: between calls,
+  * expressions are changed in place without clearing the marks of the trees that contain them (simplifyArith,
+  * searchReplace, the ExpModifiers, writes through refSubExp1 and doSearch, Const::setInt etc.).
   ******************************************************************************/
 #define DEBUG_SIMP 0                                                              // Set to 1 to print every change
+namespace {
+std::atomic<unsigned> lastSimplifyCall(0);     //!< Numbers the outermost simplify() calls of all threads
+thread_local unsigned currentSimplifyCall = 0; //!< The outermost simplify() running in this thread, 0 if none
+
+//! Numbers the outermost simplify() call of this thread, for the simplifiedIn marks it leaves
+struct SimplifyCall {
+    bool outermost;
+    SimplifyCall() : outermost(currentSimplifyCall == 0) {
+        while (outermost && currentSimplifyCall == 0)
+            currentSimplifyCall = ++lastSimplifyCall; // 0 is skipped when the counter wraps
+    }
+    ~SimplifyCall() {
+        if (outermost)
+            currentSimplifyCall = 0;
+    }
+};
+}
+
 SharedExp Exp::simplify() {
 #if DEBUG_SIMP
     SharedExp save = clone();
 #endif
-    bool bMod = false; // True if simplified at this or lower level
+    SimplifyCall call;
     SharedExp res = shared_from_this();
-    // res = ExpTransformer::applyAllTo(res, bMod);
-    // return res;
+    if (simplifiedIn == currentSimplifyCall)
+        return res; // Already simplified in this call
+    bool bMod = false; // True if simplified at this level, or a subexpression was replaced
+    if (call.outermost && ExpTransformer::isLoaded()) {
+        // The rules (--rules) first, over the whole expression; polySimplify does the rest
+        bool ruled = false;
+        res = ExpTransformer::applyAllTo(res, ruled);
+    }
+    // Redo whenever polySimplify made a change, even if it returned an expression marked as simplified: a rule may
+    // return a marked child that it changed in place, e.g. (x + a) + b sets a to a + b and returns x + a
     do {
         bMod = false;
         // SharedExp before = res->clone();
@@ -2245,7 +2304,8 @@ SharedExp Exp::simplify() {
                                           in the
                                                        // transformations directory to include a rule for the reported transform.
                                                } */
-    } while (bMod);                    // If modified at this (or a lower) level, redo
+    } while (bMod); // If modified at this level, redo
+    res->simplifiedIn = currentSimplifyCall;
 // The below is still important. E.g. want to canonicalise sums, so we know that a + K + b is the same as a + b + K
 // No! This slows everything down, and it's slow enough as it is. Call only where needed:
 // res = res->simplifyArith();
@@ -2257,6 +2317,25 @@ SharedExp Exp::simplify() {
     return res;
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief        Simplify a subexpression of an expression being simplified, to a fixed point
+  * \note         Skips a subexpression already simplified in the current simplify() call; the mark is cleared by
+  *               setOper, setSubExp1 etc. Marks from earlier calls are ignored, as expressions are also changed in
+  *               place through the pointers returned by refSubExp1, doSearch etc.
+  * \param        e the subexpression
+  * \param        bMod set to true if \a e was replaced
+  * \returns      The simplified subexpression
+  ******************************************************************************/
+SharedExp Exp::simplifySubExp(const SharedExp &e, bool &bMod) {
+    if (currentSimplifyCall != 0 && e->simplifiedIn == currentSimplifyCall)
+        return e;
+    SharedExp res = e->simplify();
+    if (res != e)
+        bMod = true;
+    return res;
+}
+
 /***************************************************************************/ /**
   *
   * \brief        Do the work of simplification
@@ -2266,7 +2345,7 @@ SharedExp Exp::simplify() {
   ******************************************************************************/
 SharedExp Unary::polySimplify(bool &bMod) {
     SharedExp res(shared_from_this());
-    subExp1 = subExp1->polySimplify(bMod);
+    subExp1 = simplifySubExp(subExp1, bMod);
 
     if (op == opNot || op == opLNot) {
         switch (subExp1->getOper()) {
@@ -2371,7 +2450,7 @@ SharedExp Unary::polySimplify(bool &bMod) {
         break;
     case opMemOf:
     case opRegOf: {
-        subExp1 = subExp1->polySimplify(bMod);
+        subExp1 = simplifySubExp(subExp1, bMod);
         // The below IS bad now. It undoes the simplification of
         // m[r29 + -4] to m[r29 - 4]
         // If really needed, do another polySimplify, or swap the order
@@ -2424,8 +2503,8 @@ SharedExp Binary::polySimplify(bool &bMod) {
 
     SharedExp res = shared_from_this();
 
-    subExp1 = subExp1->polySimplify(bMod);
-    subExp2 = subExp2->polySimplify(bMod);
+    subExp1 = simplifySubExp(subExp1, bMod);
+    subExp2 = simplifySubExp(subExp2, bMod);
 
     OPER opSub1 = subExp1->getOper();
     OPER opSub2 = subExp2->getOper();
@@ -2538,7 +2617,7 @@ SharedExp Binary::polySimplify(bool &bMod) {
     if (op == opEquals && *subExp1 == *subExp2) {
         // x == x: result is true
         ; // delete this;
-        res = std::make_shared<Terminal>(opTrue);
+        res = makeArenaShared<Terminal>(opTrue);
         bMod = true;
         return res;
     }
@@ -2845,8 +2924,8 @@ SharedExp Binary::polySimplify(bool &bMod) {
 
     // For (a || b) or (a && b) recurse on a and b
     if (op == opOr || op == opAnd) {
-        subExp1 = subExp1->polySimplify(bMod);
-        subExp2 = subExp2->polySimplify(bMod);
+        subExp1 = simplifySubExp(subExp1, bMod);
+        subExp2 = simplifySubExp(subExp2, bMod);
         return res;
     }
 
@@ -3083,9 +3162,9 @@ SharedExp Binary::polySimplify(bool &bMod) {
 SharedExp Ternary::polySimplify(bool &bMod) {
     SharedExp res = shared_from_this();
 
-    subExp1 = subExp1->polySimplify(bMod);
-    subExp2 = subExp2->polySimplify(bMod);
-    subExp3 = subExp3->polySimplify(bMod);
+    subExp1 = simplifySubExp(subExp1, bMod);
+    subExp2 = simplifySubExp(subExp2, bMod);
+    subExp3 = simplifySubExp(subExp3, bMod);
 
     // p ? 1 : 0 -> p
     if (op == opTern && subExp2->getOper() == opIntConst && subExp3->getOper() == opIntConst) {
@@ -3214,7 +3293,7 @@ SharedExp TypedExp::polySimplify(bool &bMod) {
 SharedExp RefExp::polySimplify(bool &bMod) {
     SharedExp res = shared_from_this();
 
-    SharedExp tmp = subExp1->polySimplify(bMod);
+    SharedExp tmp = simplifySubExp(subExp1, bMod);
     if (bMod) {
         subExp1 = tmp;
         return res;
@@ -3234,7 +3313,7 @@ SharedExp RefExp::polySimplify(bool &bMod) {
     // FIXME: do we really want this now? Pentium specific, and only handles ax/eax (not al or ah)
     if (subExp1->isRegN(0) &&                                               // r0 (ax)
         def && def->isAssign() && ((Assign *)def)->getLeft()->isRegN(24)) { // r24 (eax)
-        res = std::make_shared<TypedExp>(IntegerType::get(16), RefExp::get(Location::regOf(24), def));
+        res = makeArenaShared<TypedExp>(IntegerType::get(16), RefExp::get(Location::regOf(24), def));
         bMod = true;
         return res;
     }
@@ -3464,11 +3543,56 @@ SharedExp Exp::fromSSAleft(UserProc *proc, Instruction *d) {
 
 // A helper class for comparing Exp*'s sensibly
 bool lessExpStar::operator()(const SharedConstExp &x, const SharedConstExp &y) const {
+    if (x == y)
+        return false; // Same node; no expression is less than itself
     return (*x < *y); // Compare the actual Exps
 }
 bool lessTI::operator()(const SharedExp &x, const SharedExp &y) const {
+    if (x == y)
+        return false;
     return (*x << *y); // Compare the actual Exps
 }
+size_t hashExpStar::operator()(const SharedConstExp &x) const { return x->hash(); }
+size_t hashExpStar::operator()(const SharedExp &x) const { return x->hash(); }
+bool equalExpStar::operator()(const SharedConstExp &x, const SharedConstExp &y) const {
+    if (x == y)
+        return true;
+    return !(*x < *y) && !(*y < *x);
+}
+bool equalExpStar::operator()(const SharedExp &x, const SharedExp &y) const {
+    if (x == y)
+        return true;
+    return !(*x < *y) && !(*y < *x);
+}
+
+//    //    //    //    //    //
+//    Structural hashing    //
+//    //    //    //    //    //
+
+static inline size_t hashCombine(size_t seed, size_t v) { return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2)); }
+
+size_t Exp::hash() const { return std::hash<int>()(op); }
+
+size_t Const::hash() const {
+    size_t h = hashCombine(std::hash<int>()(op), std::hash<int>()(conscript));
+    switch (op) {
+    case opIntConst:
+        return hashCombine(h, std::hash<int>()(u.i)); // operator< only compares u.i, even for addresses
+    case opLongConst:
+        return hashCombine(h, std::hash<QWord>()(u.ll));
+    case opFltConst:
+        return hashCombine(h, u.d == 0.0 ? 0 : std::hash<double>()(u.d)); // 0.0 == -0.0
+    case opStrConst:
+        return hashCombine(h, qHash(strin));
+    case opFuncConst:
+        return hashCombine(h, std::hash<const void *>()(u.pp));
+    default:
+        return h;
+    }
+}
+size_t Unary::hash() const { return hashCombine(std::hash<int>()(op), subExp1->hash()); }
+size_t Binary::hash() const { return hashCombine(Unary::hash(), subExp2->hash()); }
+size_t Ternary::hash() const { return hashCombine(Binary::hash(), subExp3->hash()); }
 
 //    //    //    //    //    //
 //    genConstraints    //
@@ -4237,7 +4361,7 @@ SharedExp Exp::expSubscriptAllNull(/*Cfg* cfg*/) {
 }
 
 std::shared_ptr<Location> Location::local(const QString &nam, UserProc *p) {
-    return std::make_shared<Location>(opLocal, Const::get(nam), p);
+    return makeArenaShared<Location>(opLocal, Const::get(nam), p);
 }
 
 // Don't put in exp.h, as this would require statement.h including before exp.h
@@ -0,0 +1,86 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       memo.cpp
+  * \brief   Implementation of the Memoisable class.
+  ******************************************************************************/
+
+#include "memo.h"
+
+#include <iterator>
+
+Memoisable::~Memoisable() { clearMemos(); }
+
+/// Take a memo of the current state, for \a mId. The memos after the current one are forgotten
+void Memoisable::takeMemo(int mId) {
+    std::list<Memo *>::iterator it = cur_memo;
+    if (it != memos.end())
+        ++it;
+    while (it != memos.end()) {
+        delete *it;
+        it = memos.erase(it);
+    }
+    cur_memo = memos.insert(memos.end(), makeMemo(mId));
+}
+
+void Memoisable::takeMemo() { takeMemo(-1); }
+
+/// Go back to the latest memo for \a mId, up to the current one. Nothing happens if there is none
+/// \param dec passed to readMemo: true if going back in the history
+void Memoisable::restoreMemo(int mId, bool dec) {
+    if (memos.empty())
+        return;
+    std::list<Memo *>::iterator it = cur_memo;
+    while ((*it)->mId != mId) {
+        if (it == memos.begin())
+            return;
+        --it;
+    }
+    cur_memo = it;
+    readMemo(*cur_memo, dec);
+}
+
+/// True if there is a memo before (\a dec) or after the current one
+bool Memoisable::canRestore(bool dec) {
+    if (memos.empty())
+        return false;
+    if (dec)
+        return cur_memo != memos.begin();
+    return std::next(cur_memo) != memos.end();
+}
+
+/// Step to the memo before (\a dec) or after the current one, and restore it
+void Memoisable::restoreMemo(bool dec) {
+    if (!canRestore(dec))
+        return;
+    if (dec)
+        --cur_memo;
+    else
+        ++cur_memo;
+    readMemo(*cur_memo, dec);
+}
+
+/// True if restoreMemo(\a mId) would find a memo
+bool Memoisable::hasMemo(int mId) {
+    if (memos.empty())
+        return false;
+    for (std::list<Memo *>::iterator it = memos.begin();; ++it) {
+        if ((*it)->mId == mId)
+            return true;
+        if (it == cur_memo)
+            return false;
+    }
+}
+
+/// Forget all the memos
+void Memoisable::clearMemos() {
+    for (Memo *m : memos)
+        delete m;
+    memos.clear();
+    cur_memo = memos.end();
+}
@@ -152,6 +152,8 @@ void Module::setLocationMap(ADDRESS loc, Function *fnc)
     }
     else
         LabelsToProcs[loc] = fnc;
+    if (Parent)
+        Parent->indexProcEntry(loc, fnc);
 }
 
 void Module::eraseFromParent()
@@ -180,6 +182,11 @@ Function *Module::getOrInsertFunction(const QString &name, ADDRESS uNative, bool
         LabelsToProcs[uNative] = pProc;
     }
     FunctionList.push_back(pProc); // Append this to list of procs
+    if (Parent) {
+        if (NO_ADDRESS != uNative)
+            Parent->indexProcEntry(uNative, pProc);
+        Parent->indexProcName(pProc);
+    }
     // alert the watchers of a new proc
     emit newFunction(pProc);
     Boomerang::get()->alertNew(pProc);
@@ -74,13 +74,17 @@
 #include "visitor.h"
 #include "log.h"
 #include "basicblock.h"
+#include "decompilecache.h"
+#include "decompilestats.h"
 
 #include <QtCore/QDebug>
 #include <QtCore/QFile>
+#include <QtCore/QMutex>
 #include <QtCore/QTextStream>
 #include <sstream>
 #include <algorithm> // For find()
 #include <cstring>
+#include <atomic>
 
 #ifdef _WIN32
 #undef NO_ADDRESS
@@ -113,6 +117,8 @@ void Function::eraseFromParent()
 {
     // Replace the entry in the procedure map with -1 as a warning not to decode that address ever again
     Parent->setLocationMap(getNativeAddress(),(Function *)-1);
+    if (prog)
+        prog->unindexProc(this);
     // Delete the cfg etc.
     Parent->getFunctionList().remove(this);
     this->deleteCFG();
@@ -151,7 +157,23 @@ QString Function::getName() const {
   ******************************************************************************/
 void Function::setName(const QString &nam) {
     assert(signature);
+    QString oldName = signature->getName();
     signature->setName(nam);
+    if (prog)
+        prog->indexProcName(this, oldName);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief        Replace the signature (and so possibly the name) of this procedure
+  * \param        sig - the new Signature
+  *
+  ******************************************************************************/
+void Function::setSignature(std::shared_ptr<Signature> sig) {
+    QString oldName = signature ? signature->getName() : QString();
+    signature = sig;
+    if (prog && signature && signature->getName() != oldName)
+        prog->indexProcName(this, oldName);
 }
 
 /***************************************************************************/ /**
@@ -557,8 +579,67 @@ UserProc::~UserProc() { deleteCFG(); }
   *
   ******************************************************************************/
 void UserProc::deleteCFG() {
+    clearMemos();
     delete cfg;
     cfg = nullptr;
+    arena.reset(); // Its chunks go back as the last of their nodes are freed
+}
+
+/// \returns the arena for the IR of this procedure (see Arena::Scope), or nullptr unless --arena was given
+Arena *UserProc::getArena() {
+    if (arena == nullptr && Boomerang::get()->procArenas)
+        arena.reset(new Arena);
+    return arena.get();
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief        Keep only the code of this procedure, now that it has been generated (--stream)
+  *
+  * The C text \a code, the prototype and the names of the globals used are kept with the signature; the Cfg, and the
+  * statements, symbols, locals, collectors and data flow information that go with it, are freed. After this only
+  * the signature of the procedure can be used, which is all its callers need for their code.
+  *
+  ******************************************************************************/
+void UserProc::releaseIR(const QString &code) {
+    released.reset(new Released);
+    released->code = code;
+
+    HLLCode *hll = Boomerang::get()->getHLLCode(this);
+    hll->AddPrototype(this);
+    QTextStream os(&released->prototype);
+    hll->print(os);
+    os.flush();
+    delete hll;
+
+    Location search(opGlobal, Terminal::get(opWild), this);
+    std::list<SharedExp> used;
+    for (Instruction *s : *getStatementIndex()) {
+        if (!s->isImplicit()) // As in Prog::removeUnusedGlobals
+            s->searchAll(search, used);
+    }
+    for (const SharedExp &g : used) {
+        QString name = g->access<Const, 1>()->getStr();
+        if (!released->globals.contains(name))
+            released->globals << name;
+    }
+
+    stmtIndex.reset();
+    theReturnStatement = nullptr; // It is in the Cfg
+    for (Instruction *s : parameters)
+        delete s;
+    parameters.clear();
+    symbolMap.clear();
+    locals.clear();
+    localTable = DataIntervalMap();
+    localTable.setProc(this);
+    procUseCollector.clear();
+    addressEscapedVars.clear();
+    df = DataFlow();
+    provenTrue.clear();
+    recurPremises.clear();
+    proofMemo.clear();
+    deleteCFG();
 }
 
 class lessEvaluate : public std::binary_function<SyntaxNode *, SyntaxNode *, bool> {
@@ -638,11 +719,11 @@ SyntaxNode *UserProc::getAST() {
 
 //! Print ast to a file
 void UserProc::printAST(SyntaxNode *a) {
-    static int count = 1;
+    static std::atomic<int> count(1); // Procedures can be printed from several decompiling threads
     char s[1024];
     if (a == nullptr)
         a = getAST();
-    sprintf(s, "ast%i-%s.dot", count++, qPrintable(getName()));
+    sprintf(s, "ast%i-%s.dot", count.fetch_add(1), qPrintable(getName()));
     QFile tgt(s);
     if(!tgt.open(QFile::WriteOnly)){
         return; //TODO: report error ?
@@ -671,6 +752,7 @@ void UserProc::setDecoded() {
   *
   ******************************************************************************/
 void UserProc::unDecode() {
+    clearMemos();
     cfg->clear();
     setStatus(PROC_UNDECODED);
 }
@@ -718,6 +800,7 @@ void UserProc::addCallee(Function *callee) {
 void UserProc::generateCode(HLLCode *hll) {
     assert(cfg);
     assert(getEntryBB());
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::CODEGEN);
 
     cfg->structure();
     removeUnusedLocals();
@@ -923,6 +1006,62 @@ void UserProc::getStatements(StatementList &stmts) const {
             s->setProc(const_cast<UserProc *>(this));
 }
 
+/***************************************************************************/ /**
+  *
+  * \brief Get all the statements, in the same order as getStatements, as a contiguous vector.
+  *
+  * The vector is kept with the procedure and rebuilt only when the CFG changed since it was last built (see
+  * Cfg::stmtsChanged); removeStatement and insertStatementAfter edit it in place. A pass that holds the returned
+  * pointer sees the statements as they were when it asked, like a StatementList from getStatements would; edits made
+  * while it is held leave it alone, and the index is rebuilt at the next call.
+  * This is for the passes of this procedure; other threads may not call it while the procedure is being decompiled.
+  *
+  ******************************************************************************/
+std::shared_ptr<const std::vector<Instruction *>> UserProc::getStatementIndex() {
+    if (stmtIndex && stmtIndexGeneration == cfg->getStmtGeneration())
+        return stmtIndex;
+    auto index = std::make_shared<std::vector<Instruction *>>();
+    if (stmtIndex)
+        index->reserve(stmtIndex->size());
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        std::list<RTL *> *rtls = bb->getRTLs();
+        if (rtls == nullptr)
+            continue;
+        for (RTL *rtl : *rtls) {
+            for (Instruction *s : *rtl) {
+                if (s->getBB() == nullptr)
+                    s->setBB(bb);
+                if (s->getProc() == nullptr)
+                    s->setProc(this);
+                index->push_back(s);
+            }
+        }
+    }
+    stmtIndex = index;
+    stmtIndexGeneration = cfg->getStmtGeneration();
+    return stmtIndex;
+}
+
+/// Bring a current statement index up to date with the removal of \a stmt from its RTL or, if \a after is given,
+/// with the insertion of \a stmt after \a after. Otherwise, the next getStatementIndex rebuilds it.
+void UserProc::updateStatementIndex(Instruction *stmt, Instruction *after) {
+    bool current = stmtIndex && stmtIndexGeneration == cfg->getStmtGeneration();
+    cfg->stmtsChanged();
+    // If a pass is iterating over the index, leave it alone; it is rebuilt once, when next asked for
+    if (!current || stmtIndex.use_count() > 1)
+        return;
+    std::vector<Instruction *> &index(*stmtIndex);
+    auto pos = std::find(index.begin(), index.end(), after ? after : stmt);
+    if (pos == index.end())
+        return;
+    if (after)
+        index.insert(pos + 1, stmt);
+    else
+        index.erase(pos);
+    stmtIndexGeneration = cfg->getStmtGeneration();
+}
+
 /***************************************************************************/ /**
   *
   * \brief Remove a statement
@@ -964,6 +1103,7 @@ void UserProc::removeStatement(Instruction *stmt) {
         for (RTL::iterator it = rit->begin(); it != rit->end(); it++) {
             if (*it == stmt) {
                 rit->erase(it);
+                updateStatementIndex(stmt);
                 return;
             }
         }
@@ -992,6 +1132,7 @@ void UserProc::insertAssignAfter(Instruction *s, SharedExp left, SharedExp right
     Assign *as = new Assign(left, right);
     as->setProc(this);
     stmts->insert(it, as);
+    cfg->stmtsChanged();
     return;
 }
 
@@ -1010,6 +1151,7 @@ void UserProc::insertStatementAfter(Instruction *s, Instruction *a) {
                 if (*ss == s) {
                     ss++; // This is the point to insert before
                     rr->insert(ss, a);
+                    updateStatementIndex(a, s);
                     return;
                 }
             }
@@ -1076,6 +1218,7 @@ void UserProc::insertStatementAfter(Instruction *s, Instruction *a) {
   *
   ******************************************************************************/
 std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
+    Arena::Scope arenaScope(getArena());
     Boomerang::get()->alertConsidering(path->empty() ? nullptr : path->back(), this);
     alignStream(LOG_STREAM(),++indent) << (status >= PROC_VISITED ? "re" : "") << "considering "
               << getName() << "\n";
@@ -1117,6 +1260,9 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
             UserProc *c = dynamic_cast<UserProc *>(call->getDestProc());
             if ( c == nullptr ) // not an user proc, or missing dest
                 continue;
+            // With --threads, another worker may be decompiling c; this waits until it is done
+            if (!prog->claimProc(c))
+                continue;
             if (c->status == PROC_FINAL) {
                 // Already decompiled, but the return statement still needs to be set for this call
                 call->setCalleeReturn(c->getTheReturnStatement());
@@ -1186,8 +1332,13 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
         }
     }
 
+    // Everything this procedure depends on before the global passes is now final: try the cache
+    DecompileCache *cache = prog->getDecompileCache();
+    bool restored = child->empty() && cache && cache->restore(this);
+    DecompileCache::ReadScope reads(restored ? nullptr : cache, this);
+
     // if child is empty, i.e. no child involved in recursion
-    if (child->empty()) {
+    if (child->empty() && !restored) {
         Boomerang::get()->alertDecompiling(this);
         alignStream(LOG_STREAM(1),indent) << "decompiling " << getName() << "\n";
         initialiseDecompile(); // Sort the CFG, number statements, etc
@@ -1199,10 +1350,15 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
             // We've just come back out of decompile(), so we've lost the current proc from the path.
             path->push_back(this);
     }
-    if (child->empty()) {
+    if (restored) {
+        setStatus(PROC_FINAL);
+        Boomerang::get()->alertEndDecompile(this);
+    } else if (child->empty()) {
         remUnusedStmtEtc(); // Do the whole works
         setStatus(PROC_FINAL);
         Boomerang::get()->alertEndDecompile(this);
+        if (cache)
+            cache->noteDecompiled(this);
     } else {
         // this proc's children, and hence this proc, is/are involved in recursion
         // find first element f in path that is also in cycleGrp
@@ -1216,6 +1372,10 @@ std::shared_ptr<ProcSet> UserProc::decompile(ProcList *path, int &indent) {
             recursionGroupAnalysis(path, indent); // Includes remUnusedStmtEtc on all procs in cycleGrp
             setStatus(PROC_FINAL);
             Boomerang::get()->alertEndDecompile(this);
+            if (cache) {
+                for (UserProc *proc : *cycleGrp)
+                    cache->noteDecompiled(proc);
+            }
             child->clear(); //delete child;
             child = std::make_shared<ProcSet>();
         }
@@ -1258,6 +1418,7 @@ void UserProc::debugPrintAll(const char *step_name) {
 
 void UserProc::initialiseDecompile() {
 
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::INITIALISE);
     Boomerang::get()->alertStartDecompile(this);
 
     Boomerang::get()->alertDecompileDebugPoint(this, "before initialise");
@@ -1265,6 +1426,17 @@ void UserProc::initialiseDecompile() {
     if (VERBOSE)
         LOG << "initialise decompile for " << getName() << "\n";
 
+    // Keep the CFG as decoded, to go back to if analysing indirect jumps or calls finds more code (see
+    // middleDecompile). Only those can have it
+    clearMemos();
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb && !Boomerang::get()->noDecompile; bb = cfg->getNextBB(it)) {
+        if (bb->getType() == BBTYPE::COMPJUMP || bb->getType() == BBTYPE::COMPCALL) {
+            takeMemo(PROC_DECODED);
+            break;
+        }
+    }
+
     // Sort by address, so printouts make sense
     cfg->sortByAddress();
 
@@ -1301,6 +1473,7 @@ void UserProc::earlyDecompile() {
     if (status >= PROC_EARLYDONE)
         return;
 
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::EARLY);
     Boomerang::get()->alertDecompileDebugPoint(this, "before early");
     LOG_VERBOSE(1) << "early decompile for " << getName() << "\n";
 
@@ -1345,6 +1518,7 @@ void UserProc::earlyDecompile() {
   ******************************************************************************/
 std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::MIDDLE);
     Boomerang::get()->alertDecompileDebugPoint(this, "before middle");
 
     // The call bypass logic should be staged as well. For example, consider m[r1{11}]{11} where 11 is a call.
@@ -1438,15 +1612,17 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 #if 1 // FIXME: Check if this is needed any more. At least fib seems to need it at present.
         if (!Boomerang::get()->noChangeSignatures) {
             // addNewReturns(depth);
-            for (int i = 0; i < 3; i++) { // FIXME: should be iterate until no change
+            for (int i = 0; i < 3; i++) { // Iterate until no change, but at most 3 times
                 if (VERBOSE)
                     LOG << "### update returns loop iteration " << i << " ###\n";
                 if (status != PROC_INCYCLE)
                     doRenameBlockVars(pass, true);
-                findPreserveds();
-                updateCallDefines(); // Returns have uses which affect call defines (if childless)
-                fixCallAndPhiRefs();
-                findPreserveds(); // Preserveds subtract from returns
+                bool updated = findPreserveds();
+                updated |= updateCallDefines(); // Returns have uses which affect call defines (if childless)
+                updated |= fixCallAndPhiRefs();
+                updated |= findPreserveds(); // Preserveds subtract from returns
+                if (!updated)
+                    break;
             }
             printXML();
             if (VERBOSE) {
@@ -1510,6 +1686,8 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 
         // processTypes();
 
+        // Renaming can change more than it reports (collectors, phi operands), so only a pass in which nothing at all
+        // was reported as changed ends the loop early
         if (!change)
             break; // Until no change
     }
@@ -1557,8 +1735,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     // Check for indirect jumps or calls not already removed by propagation of constants
     if (cfg->decodeIndirectJmp(this)) {
         // There was at least one indirect jump or call found and decoded. That means that most of what has been done
-        // to this function so far is invalid. So redo everything. Very expensive!!
-        // Code pointed to by the switch table entries has merely had FrontEnd::processFragment() called on it
+        // to this function so far is invalid. So redo everything from the CFG as decoded, with the new code spliced in
         LOG << "=== about to restart decompilation of " << getName()
             << " because indirect jumps or calls have been analysed\n\n";
         Boomerang::get()->alertDecompileDebugPoint(
@@ -1567,10 +1744,12 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
         // First copy any new indirect jumps or calls that were decoded this time around. Just copy them all, the map
         // will prevent duplicates
         processDecodedICTs();
-        // Now, decode from scratch
+        // Now, go back to the CFG as decoded; decode from scratch if it was not kept
         theReturnStatement = nullptr;
-        cfg->clear();
-        prog->reDecode(this);
+        if (!restoreDecoded()) {
+            cfg->clear();
+            prog->reDecode(this);
+        }
         df.setRenameLocalsParams(false);        // Start again with memofs
         setStatus(PROC_VISITED);                // Back to only visited progress
         path->erase(--path->end());             // Remove self from path
@@ -1597,6 +1776,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
     if (VERBOSE)
         LOG << "===== end early decompile for " << getName() << " =====\n\n";
     setStatus(PROC_EARLYDONE);
+    clearMemos(); // No more restarts
 
     Boomerang::get()->alertDecompileDebugPoint(this, "after middle");
 
@@ -1611,6 +1791,7 @@ std::shared_ptr<ProcSet> UserProc::middleDecompile(ProcList *path, int indent) {
 //! Remove unused statements.
 void UserProc::remUnusedStmtEtc() {
 
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::REM_UNUSED);
     bool convert;
     bool change;
     // NO! Removing of unused statements is an important part of the global removing unused returns analysis, which
@@ -1971,6 +2152,63 @@ void UserProc::fixUglyBranches() {
     debugPrintAll("after fixUglyBranches");
 }
 
+thread_local std::vector<std::vector<UserProc::ProofDep> *> UserProc::proofDepStack;
+
+namespace {
+QString proofText(Instruction *s) {
+    QString tgt;
+    QTextStream ost(&tgt);
+    s->print(ost); // Calls print their collectors too, which localiseExp reads
+    ost.flush();
+    return tgt;
+}
+}
+
+//! Note that the proof being memoised read \a s, or with nullptr, that it read more than single statements
+void UserProc::noteProofDep(Instruction *s) {
+    if (proofDepStack.empty())
+        return;
+    ProofDep dep;
+    dep.proc = this;
+    dep.stmt = s;
+    if (s)
+        dep.text = proofText(s);
+    proofDepStack.back()->push_back(dep);
+}
+
+//! \returns true if the statements in \a deps still exist and print as they did
+bool UserProc::proofDepsCurrent(const std::vector<ProofDep> &deps) {
+    for (const ProofDep &dep : deps) {
+        if (dep.stmt == nullptr)
+            return false;
+        UserProc *p = dep.proc;
+        if (p->proofStmtsGeneration != p->cfg->getStmtGeneration()) {
+            std::shared_ptr<const std::vector<Instruction *>> stmts = p->getStatementIndex();
+            p->proofStmts.clear();
+            p->proofStmts.insert(stmts->begin(), stmts->end());
+            p->proofStmtsGeneration = p->cfg->getStmtGeneration();
+        }
+        if (p->proofStmts.count(dep.stmt) == 0 || proofText(dep.stmt) != dep.text)
+            return false;
+    }
+    return true;
+}
+
+//! Print what the proofs of a procedure in a recursion group depend on besides statements: the premises and the
+//! proven facts of the members of the group
+void UserProc::printProofContext(QTextStream &os) {
+    if (cycleGrp == nullptr)
+        return;
+    for (UserProc *p : *cycleGrp) {
+        os << " | " << p->getName() << " assuming";
+        for (auto &pr : p->recurPremises)
+            os << " " << pr.first << " = " << pr.second;
+        os << " proven";
+        for (auto &pr : p->provenTrue)
+            os << " " << pr.first << " = " << pr.second;
+    }
+}
+
 /***************************************************************************/ /**
   *
   * \brief Rename block variables, with log if verbose.
@@ -1996,6 +2234,7 @@ void UserProc::findSpPreservation() {
     bool stdsp = false; // FIXME: are these really used?
     // Note: need this non-virtual version most of the time, since nothing proved yet
     int sp = signature->getStackRegister(prog);
+    beginProofMemo();
 
     for (int n = 0; n < 2; n++) {
         // may need to do multiple times due to dependencies FIXME: efficiency! Needed any more?
@@ -2011,6 +2250,7 @@ void UserProc::findSpPreservation() {
                             Binary::get(opPlus, Location::regOf(sp), Const::get(p * 4))));
         }
     }
+    endProofMemo();
 
     if (DEBUG_PROOF) {
         LOG << "proven for " << getName() << ":\n";
@@ -2023,8 +2263,10 @@ void UserProc::findSpPreservation() {
   *
   * \brief  Was trimReturns()
   *
+  * \returns true if a new preservation was proven or a modified was removed
+  *
   ******************************************************************************/
-void UserProc::findPreserveds() {
+bool UserProc::findPreserveds() {
     std::set<SharedExp> removes;
 
     LOG_VERBOSE(1) << "finding preserveds for " << getName() << "\n";
@@ -2035,12 +2277,15 @@ void UserProc::findPreserveds() {
         if (DEBUG_PROOF)
             LOG << "can't find preservations as there is no return statement!\n";
         Boomerang::get()->alertDecompileDebugPoint(this, "after finding preserveds (no return)");
-        return;
+        return false;
     }
 
     // prove preservation for all modifieds in the return statement
     ReturnStatement::iterator mm;
     StatementList &modifieds = theReturnStatement->getModifieds();
+    size_t numProven = provenTrue.size();
+    size_t numModifieds = modifieds.size();
+    beginProofMemo();
     for (mm = modifieds.begin(); mm != modifieds.end(); ++mm) {
         SharedExp lhs = ((Assignment *)*mm)->getLeft();
         auto equation = Binary::get(opEquals, lhs, lhs);
@@ -2050,6 +2295,7 @@ void UserProc::findPreserveds() {
             removes.insert(equation);
         }
     }
+    endProofMemo();
 
     if (DEBUG_PROOF) {
         LOG << "### proven true for procedure " << getName() << ":\n";
@@ -2070,6 +2316,7 @@ void UserProc::findPreserveds() {
     }
 
     Boomerang::get()->alertDecompileDebugPoint(this, "after finding preserveds");
+    return provenTrue.size() != numProven || modifieds.size() != numModifieds;
 }
 
 void UserProc::removeSpAssignsIfPossible() {
@@ -2468,14 +2715,18 @@ void UserProc::processFloatConstants() {
     StatementList stmts;
     getStatements(stmts);
 
-    static Ternary match(opFsize, Terminal::get(opWild), Terminal::get(opWild), Location::memOf(Terminal::get(opWild)));
+    // Patterns are per thread, since procedures can be decompiled on several threads
+    static thread_local const SharedExp match = [] {
+        Arena::Scope heap(nullptr); // The pattern outlives the procedure whose arena is current
+        return Ternary::get(opFsize, Terminal::get(opWild), Terminal::get(opWild), Location::memOf(Terminal::get(opWild)));
+    }();
 
     StatementList::iterator it;
     for (it = stmts.begin(); it != stmts.end(); it++) {
         Instruction *s = *it;
 
         std::list<SharedExp> results;
-        s->searchAll(match, results);
+        s->searchAll(*match, results);
         for (auto &result : results) {
             auto fsize = result->access<Ternary>();
             if (fsize->getSubExp3()->getOper() == opMemOf &&
@@ -2595,9 +2846,15 @@ SharedExp UserProc::getSymbolExp(SharedExp le, SharedType ty, bool lastPass) {
 
 // Not used with DFA Type Analysis; the equivalent thing happens in mapLocalsAndParams() now
 void UserProc::mapExpressionsToLocals(bool lastPass) {
-    static SharedExp sp_location = Location::regOf(0);
-    // parse("[*] + sp{0}")
-    static Binary nn(opPlus, Terminal::get(opWild), RefExp::get(sp_location, nullptr));
+    // parse("[*] + sp{0}"); per thread, since sp_location is changed below and procedures can be decompiled on
+    // several threads
+    static thread_local SharedExp sp_location;
+    static thread_local SharedExp nn;
+    if (!nn) {
+        Arena::Scope heap(nullptr); // The patterns outlive the procedure whose arena is current
+        sp_location = Location::regOf(0);
+        nn = Binary::get(opPlus, Terminal::get(opWild), RefExp::get(sp_location, nullptr));
+    }
     StatementList stmts;
     getStatements(stmts);
 
@@ -2662,7 +2919,7 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
     for (it = stmts.begin(); it != stmts.end(); it++) {
         Instruction *s = *it;
         std::list<SharedExp> results;
-        s->searchAll(nn, results);
+        s->searchAll(*nn, results);
         for (SharedExp &result : results) {
             auto wild = result->getSubExp1();
             result->setSubExp1(result->getSubExp2());
@@ -2673,12 +2930,18 @@ void UserProc::mapExpressionsToLocals(bool lastPass) {
     // FIXME: this is probably part of the ADHOC TA
     // look for array locals
     // l = m[(sp{0} + WILD1) - K2]
-    static std::shared_ptr<Const> sp_const(Const::get(0));
-    static auto sp_loc(Location::get(opRegOf, sp_const, nullptr));
-    static auto query_f(Location::get(
-        opMemOf, Binary::get(opMinus, Binary::get(opPlus, RefExp::get(sp_loc, nullptr), Terminal::get(opWild)),
-                             Terminal::get(opWildIntConst)),
-        nullptr));
+    // Per thread, since sp_const is changed below
+    static thread_local std::shared_ptr<Const> sp_const;
+    static thread_local SharedExp query_f;
+    if (!query_f) {
+        Arena::Scope heap(nullptr); // The pattern outlives the procedure whose arena is current
+        sp_const = Const::get(0);
+        auto sp_loc(Location::get(opRegOf, sp_const, nullptr));
+        query_f = Location::get(
+            opMemOf, Binary::get(opMinus, Binary::get(opPlus, RefExp::get(sp_loc, nullptr), Terminal::get(opWild)),
+                                 Terminal::get(opWildIntConst)),
+            nullptr);
+    }
     for (it = stmts.begin(); it != stmts.end(); it++) {
         Instruction *s = *it;
         std::list<SharedExp> results;
@@ -2780,18 +3043,15 @@ bool UserProc::removeNullStatements() {
 /// (else clear)
 bool UserProc::propagateStatements(bool &convert, int pass) {
     LOG_VERBOSE(1) << "--- begin propagating statements pass " << pass << " ---\n";
-    StatementList stmts;
-    getStatements(stmts);
+    auto stmts = getStatementIndex();
     // propagate any statements that can be
-    StatementList::iterator it;
     // Find the locations that are used by a live, dominating phi-function
     LocationSet usedByDomPhi;
     findLiveAtDomPhi(usedByDomPhi);
     // Next pass: count the number of times each assignment LHS would be propagated somewhere
     std::map<SharedExp, int, lessExpStar> destCounts;
     // Also maintain a set of locations which are used by phi statements
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : *stmts) {
         ExpDestCounter edc(destCounts);
         StmtDestCounter sdc(&edc);
         s->accept(&sdc);
@@ -2802,22 +3062,29 @@ bool UserProc::propagateStatements(bool &convert, int pass) {
 #endif
     // A fourth pass to propagate only the flags (these must be propagated even if it results in extra locals)
     bool change = false;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    int propagated = 0;
+    for (Instruction *s : *stmts) {
         if (s->isPhi())
             continue;
-        change |= s->propagateFlagsTo();
+        if (s->propagateFlagsTo()) {
+            change = true;
+            ++propagated;
+        }
     }
     // Finally the actual propagation
     convert = false;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : *stmts) {
         if (s->isPhi())
             continue;
-        change |= s->propagateTo(convert, &destCounts, &usedByDomPhi);
+        if (s->propagateTo(convert, &destCounts, &usedByDomPhi)) {
+            change = true;
+            ++propagated;
+        }
     }
+    if (DecompileStats *stats = prog->getStats())
+        stats->addPropagations(this, propagated);
     simplify();
-    propagateToCollector();
+    change |= propagateToCollector();
     LOG_VERBOSE(1) << "=== end propagating statements at pass " << pass << " ===\n";
     return change;
 } // propagateStatements
@@ -2994,11 +3261,8 @@ QString UserProc::getSymbolName(SharedExp e) {
 // Count references to the things that are under SSA control. For each SSA subscripting, increment a counter for that
 // definition
 void UserProc::countRefs(RefCounter &refCounts) {
-    StatementList stmts;
-    getStatements(stmts);
-    StatementList::iterator it;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    auto stmts = getStatementIndex();
+    for (Instruction *s : *stmts) {
         // Don't count uses in implicit statements. There is no RHS of course, but you can still have x from m[x] on the
         // LHS and so on, and these are not real uses
         if (s->isImplicit())
@@ -3135,6 +3399,7 @@ void UserProc::removeUnusedLocals() {
 //
 
 void UserProc::fromSSAform() {
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::FROM_SSA);
     Boomerang::get()->alertDecompiling(this);
 
     if (VERBOSE)
@@ -3147,15 +3412,13 @@ void UserProc::fromSSAform() {
         // little procs that don't get messages. Also, looks better with progress dots
         LOG_STREAM() << " transforming out of SSA form " << getName() << " with " << cfg->getNumBBs() << " BBs";
 
-    StatementList stmts;
-    getStatements(stmts);
-    StatementList::iterator it;
+    auto stmts = getStatementIndex();
 
-    for (it = stmts.begin(); it != stmts.end(); it++) {
+    for (Instruction *s : *stmts) {
         // Map registers to initial local variables
-        (*it)->mapRegistersToLocals();
+        s->mapRegistersToLocals();
         // Insert casts where needed, as types are about to become inaccessible
-        (*it)->insertCasts();
+        s->insertCasts();
     }
 
     // First split the live ranges where needed by reason of type incompatibility, i.e. when the type of a subscripted
@@ -3181,13 +3444,12 @@ void UserProc::fromSSAform() {
     }
 #endif
     int progress = 0;
-    for (it = stmts.begin(); it != stmts.end(); it++) {
+    for (Instruction *s : *stmts) {
         if (++progress > 2000) {
             LOG_STREAM() << ".";
             LOG_STREAM().flush();
             progress = 0;
         }
-        Instruction *s = *it;
         LocationSet defs;
         s->getDefinitions(defs);
         LocationSet::iterator dd;
@@ -3341,14 +3603,11 @@ void UserProc::fromSSAform() {
     mapParameters();
     removeSubscriptsFromSymbols();
     removeSubscriptsFromParameters();
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : *stmts)
         s->replaceSubscriptsWithLocals();
-    }
 
     // Now remove the phis
-    for (it = stmts.begin(); it != stmts.end(); it++) {
-        Instruction *s = *it;
+    for (Instruction *s : *stmts) {
         if (!s->isPhi())
             continue;
         // Check if the base variables are all the same
@@ -3502,6 +3761,8 @@ bool UserProc::prove(const std::shared_ptr<Binary> &query, bool conditional /* =
 
     if (Boomerang::get()->noProve)
         return false;
+    if (DecompileStats *stats = prog->getStats())
+        stats->addProverCall(this);
 
     SharedExp original(query->clone());
     SharedExp origLeft = original->getSubExp1();
@@ -3546,9 +3807,43 @@ bool UserProc::prove(const std::shared_ptr<Binary> &query, bool conditional /* =
         //    then save the original query as a premise for bypassing calls
         recurPremises[origLeft->clone()] = origRight;
 
-    std::set<PhiAssign *> lastPhis;
-    std::map<PhiAssign *, SharedExp> cache;
-    bool result = prover(query, lastPhis, cache);
+    bool result;
+    if (proofMemoActive) {
+        QString memoKey;
+        QTextStream ks(&memoKey);
+        ks << query;
+        printProofContext(ks);
+        ks.flush();
+        auto memo = proofMemo.find(memoKey);
+        if (memo != proofMemo.end() && !proofDepsCurrent(memo->second.deps)) {
+            proofMemo.erase(memo);
+            memo = proofMemo.end();
+        }
+        if (DecompileStats *stats = prog->getStats())
+            stats->addProofMemoLookup(this, memo != proofMemo.end());
+        std::vector<ProofDep> deps;
+        if (memo != proofMemo.end()) {
+            if (DEBUG_PROOF)
+                LOG << "found " << (memo->second.result ? "true" : "false") << " in proof memo " << query << "\n";
+            result = memo->second.result;
+            deps = memo->second.deps;
+        } else {
+            std::set<PhiAssign *> lastPhis;
+            std::map<PhiAssign *, SharedExp> cache;
+            proofDepStack.push_back(&deps);
+            result = prover(query, lastPhis, cache);
+            proofDepStack.pop_back();
+            if (std::none_of(deps.begin(), deps.end(), [](const ProofDep &d) { return d.stmt == nullptr; }))
+                proofMemo[memoKey] = ProofMemo{result, deps};
+        }
+        // An enclosing proof being memoised read the same statements
+        if (!proofDepStack.empty())
+            proofDepStack.back()->insert(proofDepStack.back()->end(), deps.begin(), deps.end());
+    } else {
+        std::set<PhiAssign *> lastPhis;
+        std::map<PhiAssign *, SharedExp> cache;
+        result = prover(query, lastPhis, cache);
+    }
 
     if (cycleGrp)
         recurPremises.erase(origLeft); // Remove the premise, regardless of result
@@ -3614,6 +3909,8 @@ bool UserProc::prover(SharedExp query, std::set<PhiAssign *> &lastPhis, std::map
             if (!change && query->getSubExp1()->getOper() == opSubscript) {
                 auto r = query->access<RefExp,1>();
                 Instruction *s = r->getDef();
+                if (s)
+                    noteProofDep(s);
                 CallStatement *call = dynamic_cast<CallStatement *>(s);
                 if (call) {
                     // See if we can prove something about this register.
@@ -3766,6 +4063,7 @@ bool UserProc::prover(SharedExp query, std::set<PhiAssign *> &lastPhis, std::map
             // find a memory def for the right if there is a memof on the left
             // FIXME: this seems pretty much like a bad hack!
             if (!change && query->getSubExp1()->getOper() == opMemOf) {
+                noteProofDep(nullptr); // Depends on all the statements
                 StatementList stmts;
                 getStatements(stmts);
                 StatementList::iterator it;
@@ -3814,6 +4112,13 @@ void UserProc::getDefinitions(LocationSet &ls) {
     }
 }
 
+/// Several callers of a library procedure can be decompiled at the same time (see Prog::decompileParallel)
+void Function::addCaller(CallStatement *caller) {
+    static QMutex callersLock;
+    QMutexLocker lock(&callersLock);
+    callerSet.insert(caller);
+}
+
 void Function::addCallers(std::set<UserProc *> &callers) {
     std::set<CallStatement *>::iterator it;
     for (it = callerSet.begin(); it != callerSet.end(); it++) {
@@ -4196,8 +4501,9 @@ void UserProc::updateArguments() {
     LOG_VERBOSE(1) << "=== end update arguments for " << getName() << "\n";
     Boomerang::get()->alertDecompileDebugPoint(this, "after updating arguments");
 }
-//! Update the defines in calls
-void UserProc::updateCallDefines() {
+//! Update the defines in calls; returns true if any call's defines changed
+bool UserProc::updateCallDefines() {
+    bool changed = false;
     if (VERBOSE)
         LOG << "### update call defines for " << getName() << " ###\n";
     StatementList stmts;
@@ -4207,8 +4513,9 @@ void UserProc::updateCallDefines() {
         CallStatement *call = dynamic_cast<CallStatement *>(*it);
         if (call == nullptr)
             continue;
-        call->updateDefines();
+        changed |= call->updateDefines();
     }
+    return changed;
 }
 //! Replace simple global constant references
 //! Statement level transform :
@@ -4489,10 +4796,13 @@ QString UserProc::findFirstSymbol(const SharedExp &e) {
   *
   * \brief  Perform call and phi statement bypassing at all depths
   *
+  * \returns true if any statement or the use collector was changed
+  *
   ******************************************************************************/
-void UserProc::fixCallAndPhiRefs() {
+bool UserProc::fixCallAndPhiRefs() {
     if (VERBOSE)
         LOG << "### start fix call and phi bypass analysis for " << getName() << " ###\n";
+    bool changed = false;
 
     Boomerang::get()->alertDecompileDebugPoint(this, "before fixing call and phi refs");
 
@@ -4521,6 +4831,7 @@ void UserProc::fixCallAndPhiRefs() {
                          (e->access<RefExp,1>())->getDef()->isImplicit())) {
                         a->setRight(Unary::get(opAddrOf, Location::memOf(e->clone())));
                         found = true;
+                        changed = true;
                     }
         }
     }
@@ -4545,6 +4856,7 @@ void UserProc::fixCallAndPhiRefs() {
             auto current = RefExp::get(p.e, def);
             if (*current == *r) {   // Will we ever see this?
                 pi = ps->erase(pi); // Erase this phi parameter
+                changed = true;
                 continue;
             }
             // Chase the definition
@@ -4552,6 +4864,7 @@ void UserProc::fixCallAndPhiRefs() {
                 auto rhs = ((Assign *)def)->getRight();
                 if (*rhs == *r) {       // Check if RHS is a single reference to ps
                     pi = ps->erase(pi); // Yes, erase this phi parameter
+                    changed = true;
                     continue;
                 }
             }
@@ -4563,7 +4876,7 @@ void UserProc::fixCallAndPhiRefs() {
     for (it = stmts.begin(); it != stmts.end(); it++) {
         s = *it;
         if (!s->isPhi()) { // Ordinary statement
-            s->bypass();
+            changed |= s->bypass();
             continue;
         }
         PhiAssign *ps = (PhiAssign *)s;
@@ -4587,9 +4900,12 @@ void UserProc::fixCallAndPhiRefs() {
         first = first->propagateAll(); // Propagate everything repeatedly
         if (cb.isMod()) {              // Modified?
             // if first is of the form lhs{x}
-            if (first->isSubscript() && *first->getSubExp1() == *lhs)
+            if (first->isSubscript() && *first->getSubExp1() == *lhs &&
+                first->access<RefExp>()->getDef() != phi_inf.def()) {
                 // replace first with x
                 phi_inf.def(first->access<RefExp>()->getDef());
+                changed = true;
+            }
         }
         // For each parameter p of ps after the first
         for (++phi_iter; phi_iter != ps->end(); ++phi_iter) {
@@ -4603,9 +4919,12 @@ void UserProc::fixCallAndPhiRefs() {
             current = current->propagateAll();
             if (cb2.isMod()) // Modified?
                 // if current is of the form lhs{x}
-                if (current->isSubscript() && *current->getSubExp1() == *lhs)
+                if (current->isSubscript() && *current->getSubExp1() == *lhs &&
+                    current->access<RefExp>()->getDef() != phi_inf2.def()) {
                     // replace current with x
                     phi_inf2.def(current->access<RefExp>()->getDef());
+                    changed = true;
+                }
             if (!(*first == *current))
                 allSame = false;
         }
@@ -4630,6 +4949,7 @@ void UserProc::fixCallAndPhiRefs() {
                 // if all parameters are calls
             }
             ps->convertToAssign(best);
+            changed = true;
             LOG_VERBOSE(1) << "redundant phi replaced with copy assign; now " << ps << "\n";
         }
     }
@@ -4641,14 +4961,17 @@ void UserProc::fixCallAndPhiRefs() {
         auto addr = cc->getSubExp1();
         CallBypasser cb(nullptr);
         addr = addr->accept(&cb);
-        if (cb.isMod())
+        if (cb.isMod()) {
             cc->setSubExp1(addr);
+            changed = true;
+        }
     }
 
     if (VERBOSE)
         LOG << "### end fix call and phi bypass analysis for " << getName() << " ###\n";
 
     Boomerang::get()->alertDecompileDebugPoint(this, "after fixing call and phi refs");
+    return changed;
 }
 
 // Not sure that this is needed...
@@ -4674,7 +4997,9 @@ void UserProc::markAsNonChildless(const std::shared_ptr<ProcSet> &cs) {
 }
 
 // Propagate into xxx of m[xxx] in the UseCollector (locations live at the entry of this proc)
-void UserProc::propagateToCollector() {
+// Returns true if the collector was changed
+bool UserProc::propagateToCollector() {
+    bool changed = false;
     UseCollector::iterator it;
     for (it = procUseCollector.begin(); it != procUseCollector.end();) {
         if (!(*it)->isMemOf()) {
@@ -4700,15 +5025,18 @@ void UserProc::propagateToCollector() {
             if (procUseCollector.exists(memOfRes)) {
                 // Take care not to use an iterator to the newly erased element.
                 /* it = */ procUseCollector.remove(it++); // Already exists; just remove the old one
+                changed = true;
                 continue;
             } else {
                 LOG_VERBOSE(1) << "propagating " << r << " to " << as->getRight() << " in collector; result "
                                << memOfRes << "\n";
                 (*it)->setSubExp1(res); // Change the child of the memof
+                changed = true;
             }
         }
         ++it; // it is iterated either with the erase, or the continue, or here
     }
+    return changed;
 }
 
 /***************************************************************************/ /**
@@ -5053,8 +5381,12 @@ bool UserProc::removeRedundantParameters() {
 bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
     Boomerang::get()->alertDecompiling(this);
     Boomerang::get()->alertDecompileDebugPoint(this, "before removing unused returns");
+    // A procedure restored from the cache has no dataflow to work on: only its returns are trimmed, and it is
+    // decompiled after all if that changes them (see DecompileCache::revalidate)
+    DecompileCache *cache = prog->getDecompileCache();
+    bool cached = cache && cache->isCached(this);
     // First remove the unused parameters
-    bool removedParams = removeRedundantParameters();
+    bool removedParams = !cached && removeRedundantParameters();
     if (theReturnStatement == nullptr)
         return removedParams;
     if (DEBUG_UNUSED)
@@ -5143,7 +5475,8 @@ bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
     }
 
     // removing returns might result in params that can be removed, might as well do it now.
-    removedParams |= removeRedundantParameters();
+    if (!cached)
+        removedParams |= removeRedundantParameters();
 
     ProcSet updateSet; // Set of procs to update
 
@@ -5193,6 +5526,9 @@ bool UserProc::removeRedundantReturns(std::set<UserProc *> &removeRetSet) {
   *
   ******************************************************************************/
 void UserProc::updateForUseChange(std::set<UserProc *> &removeRetSet) {
+    DecompileCache *cache = prog->getDecompileCache();
+    if (cache && cache->isCached(this))
+        return; // No dataflow to redo
     // We need to remember the parameters, and all the livenesses for all the calls, to see if these are changed
     // by removing returns
     if (DEBUG_UNUSED) {
@@ -5276,6 +5612,7 @@ void UserProc::clearUses() {
   *
   ******************************************************************************/
 void UserProc::typeAnalysis() {
+    DecompileStats::Phase phase(prog->getStats(), this, DecompileStats::TYPE_ANALYSIS);
     if (VERBOSE)
         LOG << "### type analysis for " << getName() << " ###\n";
 
@@ -5348,6 +5685,74 @@ void UserProc::processDecodedICTs() {
     }
 }
 
+namespace {
+//! A memo of a procedure as decoded (see UserProc::initialiseDecompile)
+class DecodeMemo : public Memo {
+public:
+    Cfg cfg;                             //!< A copy of the CFG
+    ReturnStatement *theReturnStatement; //!< Its copy in cfg
+    DecodeMemo(int mId) : Memo(mId), theReturnStatement(nullptr) {}
+};
+}
+
+/// Copy the CFG, to go back to it with readMemo
+Memo *UserProc::makeMemo(int mId) {
+    DecodeMemo *m = new DecodeMemo(mId);
+    m->cfg.setProc(this);
+    std::map<const Instruction *, Instruction *> stmts;
+    m->cfg.copyBBs(*cfg, stmts);
+    if (theReturnStatement)
+        m->theReturnStatement = static_cast<ReturnStatement *>(stmts[theReturnStatement]);
+    return m;
+}
+
+/// Replace the CFG by a copy of the one in \a m (taken by makeMemo). The BBs replaced are not deleted, as for
+/// Cfg::clear
+void UserProc::readMemo(Memo *m, bool /*dec*/) {
+    DecodeMemo *dm = dynamic_cast<DecodeMemo *>(m);
+    assert(dm);
+    std::map<const Instruction *, Instruction *> stmts;
+    cfg->copyBBs(dm->cfg, stmts);
+    theReturnStatement = nullptr;
+    if (dm->theReturnStatement)
+        theReturnStatement = static_cast<ReturnStatement *>(stmts[dm->theReturnStatement]);
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Go back to the CFG as decoded (see initialiseDecompile), and decode only the code found since by the
+  * analysis of switch statements (see processDecodedICTs). Much cheaper than decoding the whole procedure again.
+  * \returns false if the CFG as decoded was not kept
+  *
+  ******************************************************************************/
+bool UserProc::restoreDecoded() {
+    if (!hasMemo(PROC_DECODED))
+        return false;
+    restoreMemo(PROC_DECODED, true);
+    // As FrontEnd::processProc does when decoding again: replace the computed jumps by the RTLs saved for them, and
+    // decode the arms of those that are switch statements now
+    std::list<BasicBlock *> jumps;
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it)) {
+        if (bb->getType() == BBTYPE::COMPJUMP && prog->getDecodedRtl(bb->getHiAddr()))
+            jumps.push_back(bb); // Not processed here, as processSwitch adds BBs
+    }
+    for (BasicBlock *bb : jumps) {
+        RTL *saved = prog->getDecodedRtl(bb->getHiAddr());
+        std::list<RTL *> *rtls = bb->getRTLs();
+        delete rtls->back();
+        rtls->back() = saved;
+        cfg->stmtsChanged();
+        CaseStatement *cs = static_cast<CaseStatement *>(saved->getHlStmt());
+        if (cs->getDest() == nullptr) {
+            if (VERBOSE)
+                LOG << "decoding the arms of the switch at " << bb->getHiAddr() << "\n";
+            bb->processSwitch(this); // Changes it to an NWAY BB
+        }
+    }
+    return true;
+}
+
 // Find or insert a new implicit reference just before statement s, for address expression a with type t.
 // Meet types if necessary
 /// Find and if necessary insert an implicit reference before s whose address expression is a and type is t.
@@ -5686,6 +6091,8 @@ void UserProc::checkLocalFor(const std::shared_ptr<RefExp> &r) {
 //    -    -    -    -    -    -    -    -    -
 
 Log &operator<<(Log &out, const UserProc &c) {
+    if (!out.isEnabled())
+        return out;
     QString tgt;
     QTextStream ost(&tgt);
     c.print(ost);
@@ -39,6 +39,8 @@
 #include "config.h"
 #include "managed.h"
 #include "log.h"
+#include "decompilecache.h"
+#include "decompilestats.h"
 #include "BinaryImage.h"
 #include "db/SymTab.h"
 
@@ -47,6 +49,8 @@
 #include <QtCore/QDebug>
 #include <QtCore/QXmlStreamWriter>
 #include <QtCore/QDir>
+#include <QtCore/QThreadPool>
+#include <QtCore/QRunnable>
 #include <QtCore/QString>
 #include <cassert>
 #include <cstdlib>
@@ -55,7 +59,9 @@
 #include <sstream>
 #include <vector>
 #include <algorithm>
+#include <memory>
 #include <cmath>
+#include <limits>
 #ifdef _WIN32
 #undef NO_ADDRESS
 #include <windows.h>
@@ -84,6 +90,7 @@ Prog::Prog(const QString &name) : pLoaderPlugin(nullptr), DefaultFrontend(nullpt
 /// \param fact abstract factory object that creates Module instance
 /// \param name retrieve/create module with this name.
 Module *Prog::getOrInsertModule(const QString &name,const ModuleFactory &fact,FrontEnd *frontend) {
+    QMutexLocker lock(&m_decodeLock);
     for(Module *m : ModuleList) {
         if(m->getName()==name)
             return m;
@@ -98,6 +105,7 @@ void Prog::setFrontEnd(FrontEnd *_pFE) {
     pLoaderPlugin = _pFE->getBinaryFile();
     pLoaderIface = qobject_cast<LoaderInterface *>(pLoaderPlugin);
     DefaultFrontend = _pFE;
+    clearProcIndices();
     for(Module *m : ModuleList)
         delete m;
     ModuleList.clear();
@@ -110,7 +118,11 @@ void Prog::setFrontEnd(FrontEnd *_pFE) {
 }
 
 Prog::~Prog() {
-    pLoaderPlugin->deleteLater();
+    clearProcIndices();
+    delete m_decompileCache;
+    delete m_stats;
+    if (pLoaderPlugin)
+        pLoaderPlugin->deleteLater();
     delete DefaultFrontend;
     for (Module *m : ModuleList) {
         delete m;
@@ -169,7 +181,7 @@ void Prog::generateDotFile() {
             if (func->isLib())
                 continue;
             UserProc *p = (UserProc *)func;
-            if (!p->isDecoded())
+            if (!p->isDecoded() || p->isReleased())
                 continue;
             // Subgraph for the proc name
             of << "\nsubgraph cluster_" << p->getName() << " {\n"
@@ -195,6 +207,47 @@ void Prog::generateDataSectionCode(QString section_name, ADDRESS section_start,
     code->AddGlobal(section_name, ArrayType::get(IntegerType::get(8, -1), size), l);
 }
 
+namespace {
+/// Structure \a up and generate its code into \a text.
+void generateProcCode(UserProc *up, DecompileCache *cache, QString &text) {
+    Arena::Scope arenaScope(up->getArena());
+    up->getCFG()->compressCfg();
+    up->getCFG()->removeOrphanBBs();
+
+    HLLCode *code = Boomerang::get()->getHLLCode(up);
+    {
+        DecompileCache::ReadScope reads(cache, up);
+        up->generateCode(code);
+    }
+    QTextStream ts(&text);
+    code->print(ts);
+    ts.flush();
+    delete code;
+}
+
+/// Generates the code of one procedure on a pool thread. Like DecompileTask, its log output is collected and replayed
+/// by the scheduling thread, in procedure order.
+class CodegenTask : public QRunnable {
+    UserProc *proc;
+    DecompileCache *cache;
+
+public:
+    QString text;
+    QString logText;
+    QString errText;
+    CodegenTask(UserProc *p, DecompileCache *c) : proc(p), cache(c) { setAutoDelete(false); }
+    void run() override {
+        QTextStream log_strm(&logText);
+        QTextStream err_strm(&errText);
+        Boomerang::get()->redirectThreadLog(&log_strm, &err_strm);
+        generateProcCode(proc, cache, text);
+        log_strm.flush();
+        err_strm.flush();
+        Boomerang::get()->redirectThreadLog(nullptr, nullptr);
+    }
+};
+}
+
 void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
     // QString basedir = m_rootCluster->makeDirs();
     QTextStream *os;
@@ -251,6 +304,11 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
             }
             proto = true;
             UserProc *up = (UserProc *)func;
+            if (up->isReleased()) {
+                if (generate_all)
+                    *os << up->getReleased()->prototype;
+                continue;
+            }
             HLLCode *code = Boomerang::get()->getHLLCode(up);
             code->AddPrototype(up); // May be the wrong signature if up has ellipsis
             if (generate_all)
@@ -261,6 +319,8 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
     if (proto && generate_all)
         *os << "\n"; // Separate prototype(s) from first proc
 
+    // The procedures to generate, in output order
+    std::vector<std::pair<Module *, UserProc *>> procs;
     for ( Module *module : ModuleList) {
         if(!generate_all && cluster!=module) {
             continue;
@@ -274,17 +334,35 @@ void Prog::generateCode(Module *cluster, UserProc *proc, bool /*intermixRTL*/) {
                 continue;
             if (!all_procedures && up != proc)
                 continue;
-            up->getCFG()->compressCfg();
-            up->getCFG()->removeOrphanBBs();
-
-            HLLCode *code = Boomerang::get()->getHLLCode(up);
-            up->generateCode(code);
-            code->print(module->getStream());
-            delete code;
+            procs.emplace_back(module, up);
+        }
+    }
+    int num_threads = Boomerang::get()->numThreads;
+    if (num_threads > 1 && procs.size() > 1)
+        generateCodeParallel(procs, num_threads);
+    else {
+        for (const std::pair<Module *, UserProc *> &mp : procs) {
+            Module *module = mp.first;
+            UserProc *up = mp.second;
+            if (m_decompileCache && m_decompileCache->isCached(up)) {
+                module->getStream() << m_decompileCache->cachedCode(up);
+                continue;
+            }
+            if (up->isReleased()) {
+                module->getStream() << up->getReleased()->code;
+                continue;
+            }
+            QString text;
+            generateProcCode(up, m_decompileCache, text);
+            module->getStream() << text;
+            if (m_decompileCache)
+                m_decompileCache->noteCode(up, text);
         }
     }
     for ( Module *module : ModuleList)
         module->closeStreams();
+    if (m_decompileCache && generate_all && all_procedures)
+        m_decompileCache->flush();
 }
 
 void Prog::generateRTL(Module *cluster, UserProc *proc) {
@@ -367,6 +445,14 @@ void Prog::generateCode(QTextStream &os) {
             UserProc *p = (UserProc *)pProc;
             if (!p->isDecoded())
                 continue;
+            if (m_decompileCache && m_decompileCache->isCached(p)) {
+                os << m_decompileCache->cachedCode(p);
+                continue;
+            }
+            if (p->isReleased()) {
+                os << p->getReleased()->code;
+                continue;
+            }
             p->getCFG()->compressCfg();
             code = Boomerang::get()->getHLLCode(p);
             p->generateCode(code);
@@ -383,7 +469,7 @@ void Prog::print(QTextStream &out) {
             if (pProc->isLib())
                 continue;
             UserProc *p = (UserProc *)pProc;
-            if (!p->isDecoded())
+            if (!p->isDecoded() || p->isReleased())
                 continue;
 
             // decoded userproc.. print it
@@ -395,6 +481,7 @@ void Prog::print(QTextStream &out) {
 //! clear the prog object \note deletes everything!
 void Prog::clear() {
     m_name = "";
+    clearProcIndices();
     for (Module * module : ModuleList)
         delete module;
     ModuleList.clear();
@@ -419,6 +506,8 @@ Function *Prog::setNewProc(ADDRESS uAddr) {
     // this test fails when decoding sparc, why?  Please investigate - trent
     // Likely because it is in the Procedure Linkage Table (.plt), which for Sparc is in the data section
     // assert(uAddr >= limitTextLow && uAddr < limitTextHigh);
+    waitForSerialTurn(); // New procs are numbered in the order they are found
+    QMutexLocker lock(&m_decodeLock); // Also called by calls made direct while decompiling
     // Check if we already have this proc
     Function *pProc = findProc(uAddr);
     if (pProc == (Function *)-1) // Already decoded and deleted?
@@ -595,6 +684,7 @@ BOOL CALLBACK addSymbol(dbghelp::PSYMBOL_INFO pSymInfo, ULONG SymbolSize, PVOID
 void Prog::removeProc(const QString &name) {
     Function *f = findProc(name);
     if(f && f!=(Function *)-1) {
+        unindexProc(f);
         f->removeFromParent();
         Boomerang::get()->alertRemove(f);
         //FIXME: this function removes the function from module, but it leaks it
@@ -607,6 +697,7 @@ void Prog::removeProc(const QString &name) {
   * \returns  The number of procedures
   ******************************************************************************/
 int Prog::getNumProcs(bool user_only) {
+    QMutexLocker lock(&m_decodeLock);
     int n = 0;
     if(user_only) {
         for(Module *m : ModuleList)
@@ -630,13 +721,9 @@ int Prog::getNumProcs(bool user_only) {
   * \returns Pointer to the Proc object, or 0 if none, or -1 if deleted
   ******************************************************************************/
 Function *Prog::findProc(ADDRESS uAddr) const {
-    for(Module *m : ModuleList)
-    {
-        Function *r = m->getFunction(uAddr);
-        if(r!=nullptr)
-            return r;
-    }
-    return nullptr;
+    QMutexLocker lock(&m_procIndexLock);
+    auto it = m_procsByEntry.find(uAddr);
+    return it == m_procsByEntry.end() ? nullptr : it->second;
 }
 /***************************************************************************/ /**
   * \brief    Return a pointer to the associated Proc object, or nullptr if none
@@ -645,16 +732,77 @@ Function *Prog::findProc(ADDRESS uAddr) const {
   * \returns Pointer to the Proc object, or 0 if none, or -1 if deleted
   ******************************************************************************/
 Function *Prog::findProc(const QString &name) const {
-    for(Module *m : ModuleList) {
-        Function *f = m->getFunction(name);
-        if(f)
-            return f;
+    QMutexLocker lock(&m_procIndexLock);
+    for (auto it = m_procsByName.find(name); it != m_procsByName.end() && it.key() == name; ++it) {
+        if (it.value()->getName() == name)
+            return it.value();
     }
     return nullptr;
 }
 
+//! Record that \a proc has its entry point at \a addr; nullptr removes the entry point from the index
+void Prog::indexProcEntry(ADDRESS addr, Function *proc) {
+    QMutexLocker lock(&m_procIndexLock);
+    if (proc == nullptr)
+        m_procsByEntry.erase(addr);
+    else
+        m_procsByEntry[addr] = proc;
+}
+
+//! Record the current name of \a proc, which was known as \a oldName (if not empty)
+void Prog::indexProcName(Function *proc, const QString &oldName) {
+    QMutexLocker lock(&m_procIndexLock);
+    if (!oldName.isEmpty())
+        m_procsByName.remove(oldName, proc);
+    QString name = proc->getName();
+    if (!m_procsByName.contains(name, proc))
+        m_procsByName.insert(name, proc);
+}
+
+//! Record that \a proc has decoded code from \a lo to \a hi (the address of its last RTL)
+void Prog::indexProcRange(UserProc *proc, ADDRESS lo, ADDRESS hi) {
+    if (hi < lo)
+        return;
+    QMutexLocker lock(&m_procIndexLock);
+    auto range = m_procRanges.equal_range(lo);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second.second != proc)
+            continue;
+        if (it->second.first < hi)
+            it->second.first = hi;
+        m_longestProcRange = std::max(m_longestProcRange, (it->second.first - lo).m_value);
+        return;
+    }
+    m_procRanges.insert(std::make_pair(lo, std::make_pair(hi, proc)));
+    m_longestProcRange = std::max(m_longestProcRange, (hi - lo).m_value);
+}
+
+//! Forget \a proc, which is leaving the program; its entry point is handled by its Module
+void Prog::unindexProc(Function *proc) {
+    QMutexLocker lock(&m_procIndexLock);
+    m_procsByName.remove(proc->getName(), proc);
+    if (proc->isLib())
+        return;
+    for (auto it = m_procRanges.begin(); it != m_procRanges.end();) {
+        if (it->second.second == proc)
+            it = m_procRanges.erase(it);
+        else
+            ++it;
+    }
+}
+
+void Prog::clearProcIndices() {
+    QMutexLocker lock(&m_procIndexLock);
+    m_procsByEntry.clear();
+    m_procsByName.clear();
+    m_procRanges.clear();
+    m_longestProcRange = 0;
+}
+
 //! lookup a library procedure by name; create if does not exist
 LibProc *Prog::getLibraryProc(const QString &nam) {
+    waitForSerialTurn();
+    QMutexLocker lock(&m_decodeLock);
     Function *p = findProc(nam);
     if (p && p->isLib())
         return (LibProc *)p;
@@ -669,10 +817,12 @@ std::shared_ptr<Signature> Prog::getDefaultSignature(const char *name) {
 }
 
 std::vector<SharedExp> &Prog::getDefaultParams() {
+    Arena::Scope heap(nullptr); // The front end builds these once and keeps them
     return DefaultFrontend->getDefaultParams();
 }
 
 std::vector<SharedExp> &Prog::getDefaultReturns() {
+    Arena::Scope heap(nullptr); // The front end builds these once and keeps them
     return DefaultFrontend->getDefaultReturns();
 }
 //! Returns true if this is a win32 program
@@ -683,11 +833,11 @@ bool Prog::isWin32() {
 }
 //! Get a global variable if possible, looking up the loader's symbol table if necessary
 QString Prog::getGlobalName(ADDRESS uaddr) {
-    // FIXME: inefficient
-    for (Global *glob : globals) {
-        if (glob->addressWithinGlobal(uaddr))
-            return glob->getName();
-    }
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    Global *glob = globals.findContaining(uaddr);
+    if (glob)
+        return glob->getName();
     return symbolByAddress(uaddr);
 }
 //! Dump the globals to stderr for debugging
@@ -706,20 +856,19 @@ ADDRESS Prog::getGlobalAddr(const QString &nam) {
 }
 
 Global *Prog::getGlobal(const QString &nam) {
-    auto iter =
-            std::find_if(globals.begin(), globals.end(), [nam](Global *g) -> bool { return g->getName()==nam; });
-    if (iter == globals.end())
-        return nullptr;
-    return *iter;
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    return globals.find(nam);
 }
 //! Indicate that a given global has been seen used in the program.
 bool Prog::globalUsed(ADDRESS uaddr, SharedType knownType) {
-    for (Global *glob : globals) {
-        if (glob->addressWithinGlobal(uaddr)) {
-            if (knownType)
-                glob->meetType(knownType);
-            return true;
-        }
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    Global *glob = globals.findContaining(uaddr);
+    if (glob) {
+        if (knownType)
+            glob->meetType(knownType);
+        return true;
     }
 
     if (Image->getSectionInfoByAddr(uaddr) == nullptr) {
@@ -811,6 +960,8 @@ SharedType Prog::guessGlobalType(const QString &nam, ADDRESS u) {
 }
 //! Make up a name for a new global at address \a uaddr (or return an existing name if address already used)
 QString Prog::newGlobalName(ADDRESS uaddr) {
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
     QString nam = getGlobalName(uaddr);
     if (!nam.isEmpty())
         return nam;
@@ -820,20 +971,18 @@ QString Prog::newGlobalName(ADDRESS uaddr) {
 }
 //! Get the type of a global variable
 SharedType Prog::getGlobalType(const QString &nam) {
-    for (Global *gl : globals)
-        if (gl->getName()==nam)
-            return gl->getType();
-    return nullptr;
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    Global *gl = globals.find(nam);
+    return gl ? gl->getType() : nullptr;
 }
 //! Set the type of a global variable
 void Prog::setGlobalType(const QString &nam, SharedType ty) {
-    // FIXME: inefficient
-    for (Global *gl : globals) {
-        if (gl->getName()!=nam)
-            continue;
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    Global *gl = globals.find(nam);
+    if (gl)
         gl->setType(ty);
-        return;
-    }
 }
 
 // get a string constant at a given address if appropriate
@@ -847,6 +996,9 @@ const char *Prog::getStringConstant(ADDRESS uaddr, bool knownString /* = false *
         // At this stage, only support ascii, null terminated, non unicode strings.
         // At least 4 of the first 6 chars should be printable ascii
         char *p = (char *)(uaddr + si->hostAddr() - si->sourceAddr()).m_value;
+        // The string (and its terminator), as far as the section goes
+        size_t avail = (si->sourceAddr() + si->size() - uaddr).m_value;
+        DecompileCache::noteRead(uaddr, std::min(strnlen(p, avail) + 1, avail));
         if (knownString)
             // No need to guess... this is hopefully a known string
             return p;
@@ -920,22 +1072,48 @@ int Prog::readNative4(ADDRESS a) {
   *
   * \brief    Return a pointer to the Proc object containing uAddr, or 0 if none
   * \note     Could return nullptr for a deleted Proc
+  * \note     When several procs claim uAddr (an entry point inside another proc's body), the first one in module
+  *           order is returned
   * \param uAddr - Native address to search for
   * \returns        Pointer to the Proc object, or 0 if none, or -1 if deleted
   ******************************************************************************/
 Function *Prog::findContainingProc(ADDRESS uAddr) const {
-    for(Module *module : ModuleList) {
-        for (Function *p : *module) {
-            if (p->getNativeAddress() == uAddr)
-                return p;
-            if (p->isLib())
-                continue;
-            UserProc *u = (UserProc *)p;
-            if (u->containsAddr(uAddr))
+    Function *atEntry = nullptr;
+    std::vector<UserProc *> candidates;
+    {
+        QMutexLocker lock(&m_procIndexLock);
+        auto entry = m_procsByEntry.find(uAddr);
+        if (entry != m_procsByEntry.end() && entry->second != (Function *)-1)
+            atEntry = entry->second;
+        // Only ranges that start at most m_longestProcRange below uAddr can contain it
+        auto it = m_procRanges.upper_bound(uAddr);
+        while (it != m_procRanges.begin()) {
+            --it;
+            if ((uAddr - it->first).m_value > m_longestProcRange)
+                break;
+            UserProc *u = it->second.second;
+            if (uAddr <= it->second.first && std::find(candidates.begin(), candidates.end(), u) == candidates.end())
+                candidates.push_back(u);
+        }
+    }
+    std::vector<Function *> matches;
+    if (atEntry)
+        matches.push_back(atEntry);
+    for (UserProc *u : candidates) {
+        if (u != atEntry && u->containsAddr(uAddr))
+            matches.push_back(u);
+    }
+    if (matches.size() < 2)
+        return matches.empty() ? nullptr : matches.front();
+    // Overlapping procs: the first one in module order wins, as it did before the indices existed
+    QMutexLocker lock(&m_decodeLock);
+    for (Module *m : ModuleList) {
+        for (Function *p : *m) {
+            if (std::find(matches.begin(), matches.end(), p) != matches.end())
                 return p;
         }
     }
-    return nullptr;
+    return matches.front();
 }
 
 /***************************************************************************/ /**
@@ -944,14 +1122,7 @@ Function *Prog::findContainingProc(ADDRESS uAddr) const {
   * \param addr   Native address of the procedure entry point
   * \returns        True if a real (non deleted) proc
   ******************************************************************************/
-bool Prog::isProcLabel(ADDRESS addr) {
-
-    for(Module *m : ModuleList) {
-        if(m->getFunction(addr))
-            return true;
-    }
-    return false;
-}
+bool Prog::isProcLabel(ADDRESS addr) { return findProc(addr) != nullptr; }
 
 /***************************************************************************/ /**
   *
@@ -1056,13 +1227,21 @@ void Prog::decompile() {
     assert(!ModuleList.empty());
     getNumProcs();
     LOG_VERBOSE(1) << getNumProcs(false) << " procedures\n";
+    if (m_decompileCache == nullptr && !boom->cacheDir.isEmpty() && !boom->noDecompile)
+        m_decompileCache = new DecompileCache(this, boom->cacheDir);
+    if (m_stats == nullptr && !boom->statsFormat.isEmpty())
+        m_stats = new DecompileStats;
 
-    // Start decompiling each entry point
-    for (UserProc *up : entryProcs) {
-        ProcList call_path;
-        LOG_VERBOSE(1) << "decompiling entry point " << up->getName() << "\n";
-        int indent = 0;
-        up->decompile(&call_path, indent);
+    if (boom->numThreads > 1 && !boom->noDecodeChildren) {
+        decompileParallel(boom->numThreads);
+    } else {
+        // Start decompiling each entry point
+        for (UserProc *up : entryProcs) {
+            ProcList call_path;
+            LOG_VERBOSE(1) << "decompiling entry point " << up->getName() << "\n";
+            int indent = 0;
+            up->decompile(&call_path, indent);
+        }
     }
 
     // Just in case there are any Procs not in the call graph.
@@ -1086,6 +1265,10 @@ void Prog::decompile() {
         }
     }
 
+    // Nothing is decoded again after this, except by the decompile cache for stale procedures
+    if (DefaultFrontend)
+        DefaultFrontend->clearDecodeCache();
+
     // Type analysis, if requested
     if (Boomerang::get()->conTypeAnalysis && Boomerang::get()->dfaTypeAnalysis) {
         LOG_STREAM() << "can't use two types of type analysis at once!\n";
@@ -1101,6 +1284,11 @@ void Prog::decompile() {
             while (removeUnusedReturns())
                 ;
         }
+        if (m_decompileCache) {
+            // Only now is it known whether the restored procedures are still what their callers need
+            m_decompileCache->revalidate();
+            m_decompileCache->captureInterfaces();
+        }
 
         // print XML after removing returns
         for(Module *m :ModuleList) {
@@ -1120,6 +1308,381 @@ void Prog::decompile() {
     // removeUnusedLocals(); Note: is now in UserProc::generateCode()
     removeUnusedGlobals();
 }
+namespace {
+/// A unit of work for the parallel decompiler: a single procedure, or a whole recursion group (a strongly connected
+/// component of the call graph) that UserProc::decompile has to analyse as one.
+struct DecompileUnit {
+    std::vector<UserProc *> procs; //!< members, the one a serial decompile reaches first at the front
+    std::vector<size_t> callees;   //!< the units that members call; all of them come earlier in the serial order
+};
+
+/// The procs that UserProc::decompile visits from \a proc, in the order it visits them: the destinations of the call
+/// BBs, in CFG order
+std::vector<UserProc *> serialCallees(UserProc *proc) {
+    std::vector<UserProc *> callees;
+    BB_IT it;
+    for (BasicBlock *bb = proc->getCFG()->getFirstBB(it); bb; bb = proc->getCFG()->getNextBB(it)) {
+        if (bb->getType() != BBTYPE::CALL)
+            continue;
+        CallStatement *call = (CallStatement *)bb->getRTLs()->back()->getHlStmt();
+        if (call == nullptr || !call->isCall())
+            continue;
+        UserProc *c = dynamic_cast<UserProc *>(call->getDestProc());
+        if (c != nullptr && !c->isDecompiled())
+            callees.push_back(c);
+    }
+    return callees;
+}
+
+/// Condense the call graph reachable from \a roots into its strongly connected components (iterative Tarjan), in the
+/// order a serial decompile finishes them. Prog::decompile starts UserProc::decompile on each root in turn, and that
+/// does a depth first search over serialCallees; a recursion group is finished when the member it reached first
+/// returns. Tarjan, visiting the same successors in the same order, emits each component when its first visited member
+/// is done, so the position of a unit in the result is its position in the serial order.
+std::vector<DecompileUnit> buildDecompileUnits(const std::vector<UserProc *> &roots) {
+    const int UNVISITED = -1;
+    std::map<UserProc *, size_t> index_of;
+    std::vector<UserProc *> procs;
+    std::vector<std::vector<size_t>> succ;
+    std::vector<int> idx, low, comp;
+    std::vector<bool> on_stack;
+    std::vector<size_t> stack;
+    std::vector<DecompileUnit> units;
+    int counter = 0;
+    auto node = [&](UserProc *proc) -> size_t {
+        auto it = index_of.find(proc);
+        if (it != index_of.end())
+            return it->second;
+        index_of[proc] = procs.size();
+        procs.push_back(proc);
+        succ.emplace_back();
+        idx.push_back(UNVISITED);
+        low.push_back(0);
+        comp.push_back(-1);
+        on_stack.push_back(false);
+        return procs.size() - 1;
+    };
+    auto visit = [&](size_t v) {
+        idx[v] = low[v] = counter++;
+        stack.push_back(v);
+        on_stack[v] = true;
+        for (UserProc *callee : serialCallees(procs[v])) {
+            size_t w = node(callee);
+            succ[v].push_back(w);
+        }
+    };
+    for (UserProc *root_proc : roots) {
+        if (root_proc->isDecompiled())
+            continue;
+        size_t root = node(root_proc);
+        if (idx[root] != UNVISITED)
+            continue;
+        // pairs of (node, position of the next successor to visit)
+        std::vector<std::pair<size_t, size_t>> work;
+        visit(root);
+        work.emplace_back(root, 0);
+        while (!work.empty()) {
+            size_t v = work.back().first;
+            if (work.back().second < succ[v].size()) {
+                size_t w = succ[v][work.back().second++];
+                if (idx[w] == UNVISITED) {
+                    visit(w);
+                    work.emplace_back(w, 0);
+                } else if (on_stack[w])
+                    low[v] = std::min(low[v], idx[w]);
+                continue;
+            }
+            work.pop_back();
+            if (!work.empty())
+                low[work.back().first] = std::min(low[work.back().first], low[v]);
+            if (low[v] != idx[v])
+                continue;
+            // v is the root of a component, and was visited before the other members
+            std::vector<size_t> members;
+            size_t w;
+            do {
+                w = stack.back();
+                stack.pop_back();
+                on_stack[w] = false;
+                comp[w] = (int)units.size();
+                members.push_back(w);
+            } while (w != v);
+            std::sort(members.begin(), members.end(), [&idx](size_t a, size_t b) { return idx[a] < idx[b]; });
+            DecompileUnit unit;
+            std::set<size_t> callees;
+            for (size_t m : members) {
+                unit.procs.push_back(procs[m]);
+                for (size_t callee : succ[m])
+                    if (comp[callee] != comp[m])
+                        callees.insert(comp[callee]);
+            }
+            unit.callees.assign(callees.begin(), callees.end());
+            units.push_back(unit);
+        }
+    }
+    return units;
+}
+
+/// The unit that the calling worker of decompileParallel is decompiling (see Prog::waitForSerialTurn)
+struct SerialTurn {
+    Prog *prog;
+    QThreadPool *pool;
+    size_t ticket;        //!< position of the unit in the serial order
+    bool reached = false; //!< set once every unit before it has finished
+};
+thread_local SerialTurn *currentTurn = nullptr;
+
+/// Decompiles one DecompileUnit on a pool thread. Log output is collected, and replayed by the scheduling thread in
+/// serial order.
+class DecompileTask : public QRunnable {
+    const DecompileUnit &unit;
+    SerialTurn turn;
+
+public:
+    QString logText;
+    QString errText;
+    DecompileTask(Prog *p, QThreadPool *pool, const DecompileUnit &u, size_t ticket) : unit(u) {
+        turn.prog = p;
+        turn.pool = pool;
+        turn.ticket = ticket;
+        setAutoDelete(false);
+    }
+    void run() override {
+        QTextStream log_strm(&logText);
+        QTextStream err_strm(&errText);
+        Boomerang::get()->redirectThreadLog(&log_strm, &err_strm);
+        currentTurn = &turn;
+        for (UserProc *proc : unit.procs) {
+            // Another worker may have got there first, through a call found by switch analysis. Decompiling the first
+            // member of a recursion group finalises the whole group
+            if (!turn.prog->claimProc(proc) || proc->isDecompiled())
+                continue;
+            ProcList call_path;
+            int indent = 0;
+            proc->decompile(&call_path, indent);
+        }
+        log_strm.flush();
+        err_strm.flush();
+        Boomerang::get()->redirectThreadLog(nullptr, nullptr);
+        turn.prog->releaseClaims();
+        currentTurn = nullptr;
+    }
+};
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Decompile the procedures on a pool of \a num_threads worker threads.
+  *
+  * The call graph is condensed into recursion groups, numbered in the order a serial decompile finishes them (see
+  * buildDecompileUnits). A unit is started once all the units it calls are final, so UserProc::decompile never
+  * recurses out of the unit it was started on. Procedures that are only discovered during decompilation (e.g. through
+  * switch analysis) are picked up by the usual recursion, or by the sweep at the end of Prog::decompile; claimProc
+  * keeps two workers from decompiling the same one.
+  *
+  * Anything that a worker does to the program as a whole (naming new procs, globals and union members, decoding)
+  * waits in waitForSerialTurn until every unit before its own has finished, so it happens in the same order as in a
+  * serial decompile. The logs of the units are replayed in that order too.
+  *
+  ******************************************************************************/
+void Prog::decompileParallel(int num_threads) {
+    Boomerang *boom = Boomerang::get();
+    std::vector<UserProc *> roots(entryProcs.begin(), entryProcs.end());
+    if (boom->decodeMain) {
+        // Then whatever the sweep at the end of decompile() would find, in module order
+        for (Module *module : ModuleList) {
+            for (Function *pp : *module) {
+                if (!pp->isLib())
+                    roots.push_back((UserProc *)pp);
+            }
+        }
+    }
+    std::vector<DecompileUnit> units = buildDecompileUnits(roots);
+    const size_t n = units.size();
+    size_t num_procs = 0;
+    std::vector<size_t> waiting(n);                 // callee units that have not finished yet
+    std::vector<std::vector<size_t>> callers(n);
+    for (size_t u = 0; u < n; ++u) {
+        num_procs += units[u].procs.size();
+        waiting[u] = units[u].callees.size();
+        for (size_t callee : units[u].callees)
+            callers[callee].push_back(u);
+    }
+    LOG_VERBOSE(1) << "decompiling " << num_procs << " procedures as " << n << " units on " << num_threads
+                   << " threads\n";
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(num_threads);
+    std::vector<std::unique_ptr<DecompileTask>> tasks(n);
+    // Earlier units first: the later ones may have to wait for them
+    auto start = [&](size_t u) {
+        tasks[u].reset(new DecompileTask(this, &pool, units[u], u));
+        pool.start(tasks[u].get(), (int)std::min<size_t>(n - u, std::numeric_limits<int>::max()));
+    };
+    QMutexLocker lock(&m_claimLock);
+    m_unitsFinished.clear();
+    m_unitDone.assign(n, false);
+    m_unitsDoneInOrder = 0;
+    m_parallel = true;
+    for (size_t u = 0; u < n; ++u)
+        if (waiting[u] == 0)
+            start(u);
+    size_t replayed = 0;
+    while (replayed < n) {
+        for (size_t done : m_unitsFinished)
+            for (size_t caller : callers[done])
+                if (--waiting[caller] == 0)
+                    start(caller);
+        m_unitsFinished.clear();
+        size_t replay_to = m_unitsDoneInOrder;
+        if (replayed < replay_to) {
+            lock.unlock();
+            for (; replayed < replay_to; ++replayed) {
+                LOG_STREAM() << tasks[replayed]->logText;
+                LOG_STREAM(LL_Error) << tasks[replayed]->errText;
+                tasks[replayed]->logText.clear();
+                tasks[replayed]->errText.clear();
+            }
+            lock.relock();
+            continue;
+        }
+        m_claimsReleased.wait(&m_claimLock);
+    }
+    m_parallel = false;
+    lock.unlock();
+    pool.waitForDone();
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Wait until a serial decompile would have got as far as the calling worker of decompileParallel.
+  *
+  * That is, until every unit that comes before the worker's own in the serial order has finished. Called before
+  * anything whose result depends on the order in which procedures are decompiled: naming a new proc, global or union
+  * member, touching the globals, and decoding. Only the first call of a unit can wait. Nothing is done when
+  * procedures are not decompiled in parallel.
+  *
+  * Must not be called with a lock held that an earlier unit may need.
+  *
+  ******************************************************************************/
+void Prog::waitForSerialTurn() {
+    SerialTurn *turn = currentTurn;
+    if (turn == nullptr || turn->reached)
+        return;
+    Prog *prog = turn->prog;
+    QMutexLocker lock(&prog->m_claimLock);
+    if (prog->m_unitsDoneInOrder < turn->ticket) {
+        // Let the pool start another unit meanwhile; the ones this waits for may not have been started yet
+        turn->pool->releaseThread();
+        while (prog->m_unitsDoneInOrder < turn->ticket)
+            prog->m_claimsReleased.wait(&prog->m_claimLock);
+        turn->pool->reserveThread();
+    }
+    turn->reached = true;
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Make the calling worker of decompileParallel the only one to decompile \a proc.
+  *
+  * A proc is claimed until its worker has finished its unit (see releaseClaims). If a worker on an earlier unit has
+  * it, this waits until it is released, by which time it is final. A proc that is already final is not claimed.
+  * Nothing is done when procedures are not decompiled in parallel.
+  *
+  * \returns false if a worker on a later unit has \a proc: that one may be waiting for this one in waitForSerialTurn,
+  * so waiting for it could deadlock. The caller then has to leave \a proc alone. (Workers only ever wait for earlier
+  * units, which is what keeps them from deadlocking.)
+  *
+  ******************************************************************************/
+bool Prog::claimProc(UserProc *proc) {
+    SerialTurn *turn = currentTurn;
+    if (!m_parallel || turn == nullptr)
+        return true;
+    QMutexLocker lock(&m_claimLock);
+    for (;;) {
+        auto owner = m_procOwners.find(proc);
+        if (owner == m_procOwners.end()) {
+            if (!proc->isDecompiled())
+                m_procOwners[proc] = turn->ticket;
+            return true;
+        }
+        if (owner->second == turn->ticket)
+            return true;
+        if (owner->second > turn->ticket) {
+            LOG_STREAM(LL_Warn) << "not waiting for " << proc->getName() << ", decompiled by the worker of a later "
+                                << "unit\n";
+            return false;
+        }
+        m_claimsReleased.wait(&m_claimLock);
+    }
+}
+
+//! Release the procs claimed by the calling worker (see claimProc), and record that its unit has finished
+void Prog::releaseClaims() {
+    SerialTurn *turn = currentTurn;
+    QMutexLocker lock(&m_claimLock);
+    for (auto it = m_procOwners.begin(); it != m_procOwners.end();) {
+        if (it->second == turn->ticket)
+            it = m_procOwners.erase(it);
+        else
+            ++it;
+    }
+    m_unitDone[turn->ticket] = true;
+    m_unitsFinished.push_back(turn->ticket);
+    while (m_unitsDoneInOrder < m_unitDone.size() && m_unitDone[m_unitsDoneInOrder])
+        ++m_unitsDoneInOrder;
+    m_claimsReleased.wakeAll();
+}
+
+/***************************************************************************/ /**
+  *
+  * \brief Generate the code of \a procs on a pool of \a num_threads worker threads.
+  *
+  * Generating the code of a procedure only changes that procedure (its CFG is structured, and its unused locals
+  * removed); of the others it only reads the signatures. So every procedure is generated into a string of its own,
+  * and the strings are then written to the module streams in the order of \a procs, which gives the same output as
+  * generating them one after the other.
+  *
+  ******************************************************************************/
+void Prog::generateCodeParallel(const std::vector<std::pair<Module *, UserProc *>> &procs, int num_threads) {
+    QThreadPool pool;
+    pool.setMaxThreadCount(num_threads);
+    std::vector<std::unique_ptr<CodegenTask>> tasks(procs.size());
+    for (size_t i = 0; i < procs.size(); ++i) {
+        if ((m_decompileCache && m_decompileCache->isCached(procs[i].second)) || procs[i].second->isReleased())
+            continue;
+        tasks[i].reset(new CodegenTask(procs[i].second, m_decompileCache));
+        pool.start(tasks[i].get());
+    }
+    pool.waitForDone();
+    for (size_t i = 0; i < procs.size(); ++i) {
+        QTextStream &os = procs[i].first->getStream();
+        if (procs[i].second->isReleased()) {
+            os << procs[i].second->getReleased()->code;
+            continue;
+        }
+        if (tasks[i] == nullptr) {
+            os << m_decompileCache->cachedCode(procs[i].second);
+            continue;
+        }
+        LOG_STREAM() << tasks[i]->logText;
+        LOG_STREAM(LL_Error) << tasks[i]->errText;
+        os << tasks[i]->text;
+        if (m_decompileCache)
+            m_decompileCache->noteCode(procs[i].second, tasks[i]->text);
+    }
+}
+
+/// With --stream: generate the code of \a proc now, and keep only that (see UserProc::releaseIR). Callers only need
+/// the signature of a procedure for their code, and that is final once the global analyses are done.
+void Prog::releaseProc(UserProc *proc) {
+    QString text;
+    generateProcCode(proc, m_decompileCache, text);
+    if (m_decompileCache)
+        m_decompileCache->noteCode(proc, text);
+    proc->releaseIR(text);
+}
+
 //! As the name suggests, removes globals unused in the decompiled code.
 void Prog::removeUnusedGlobals() {
 
@@ -1132,13 +1695,20 @@ void Prog::removeUnusedGlobals() {
             if (pp->isLib())
                 continue;
             UserProc *u = (UserProc *)pp;
+            if (m_decompileCache && m_decompileCache->isCached(u)) {
+                m_decompileCache->addUsedGlobals(u, usedGlobals);
+                continue;
+            }
+            if (u->isReleased()) {
+                for (const QString &name : u->getReleased()->globals)
+                    usedGlobals.push_back(Location::global(name, u));
+                continue;
+            }
             Location search(opGlobal, Terminal::get(opWild), u);
             // Search each statement in u, excepting implicit assignments (their uses don't count, since they don't really
             // exist in the program representation)
-            StatementList stmts;
-            StatementList::iterator ss;
-            u->getStatements(stmts);
-            for (Instruction *s : stmts) {
+            auto stmts = u->getStatementIndex();
+            for (Instruction *s : *stmts) {
                 if (s->isImplicit())
                     continue; // Ignore the uses in ImplicitAssigns
                 bool found = s->searchAll(search, usedGlobals);
@@ -1205,6 +1775,7 @@ bool Prog::removeUnusedReturns() {
     // returns and/or dead code removes parameters, which affects all callers).
     while (!removeRetSet.empty()) {
         auto it = removeRetSet.begin(); // Pick the first element of the set
+        DecompileCache::ReadScope reads(m_decompileCache, *it);
         change |= (*it)->removeRedundantReturns(removeRetSet);
         // Note: removing the currently processed item here should prevent unnecessary reprocessing of self recursive
         // procedures
@@ -1221,15 +1792,23 @@ void Prog::fromSSAform() {
             if (pp->isLib())
                 continue;
             UserProc *proc = (UserProc *)pp;
-            if (VERBOSE) {
-                LOG << "===== before transformation from SSA form for " << proc->getName() << " =====\n" << *proc
-                    << "===== end before transformation from SSA for " << proc->getName() << " =====\n\n";
-                if (!Boomerang::get()->dotFile.isEmpty())
-                    proc->printDFG();
+            if (m_decompileCache && m_decompileCache->isCached(proc))
+                continue; // Its code is already generated
+            {
+                DecompileCache::ReadScope reads(m_decompileCache, proc);
+                if (VERBOSE) {
+                    LOG << "===== before transformation from SSA form for " << proc->getName() << " =====\n" << *proc
+                        << "===== end before transformation from SSA for " << proc->getName() << " =====\n\n";
+                    if (!Boomerang::get()->dotFile.isEmpty())
+                        proc->printDFG();
+                }
+                proc->fromSSAform();
+                LOG_VERBOSE(1) << "===== after transformation from SSA form for " << proc->getName() << " =====\n"
+                               << *proc << "===== end after transformation from SSA for " << proc->getName()
+                               << " =====\n\n";
             }
-            proc->fromSSAform();
-            LOG_VERBOSE(1) << "===== after transformation from SSA form for " << proc->getName() << " =====\n" << *proc
-                           << "===== end after transformation from SSA for " << proc->getName() << " =====\n\n";
+            if (Boomerang::get()->streamProcs)
+                releaseProc(proc);
         }
     }
 }
@@ -1259,6 +1838,9 @@ void Prog::globalTypeAnalysis() {
             UserProc *proc = dynamic_cast<UserProc *>(pp);
             if ( nullptr==proc || !proc->isDecoded())
                 continue;
+            if (m_decompileCache && m_decompileCache->isCached(proc))
+                continue; // Types were final when it was stored
+            DecompileCache::ReadScope reads(m_decompileCache, proc);
             // FIXME: this just does local TA again. Need to meet types for all parameter/arguments, and return/results!
             // This will require a repeat until no change loop
             LOG_STREAM() << "global type analysis for " << proc->getName() << "\n";
@@ -1607,17 +2189,100 @@ SharedExp Prog::readNativeAs(ADDRESS uaddr, SharedType type) {
     return e;
 }
 
+void Global::setType(SharedType ty) {
+    type = ty;
+    if (Parent)
+        Parent->globalRetyped(this);
+}
+
 void Global::meetType(SharedType ty) {
     bool ch=false;
     type = type->meetWith(ty, ch);
+    if (Parent)
+        Parent->globalRetyped(this);
+}
+
+//! Tell the global table that the size of \a g may have changed
+void Prog::globalRetyped(Global *g) {
+    waitForSerialTurn();
+    QMutexLocker lock(&m_globalsLock);
+    globals.retyped(g);
+}
+
+void GlobalTable::insert(Global *g) {
+    if (!all.insert(g).second)
+        return;
+    ADDRESS end = rangeEnd(g);
+    byRange += std::make_pair(boost::icl::interval<ADDRESS>::right_open(g->getAddress(), end), std::set<Global *>{g});
+    indexedEnd[g] = end;
+    if (!byName.contains(g->getName()))
+        byName.insert(g->getName(), g);
+}
+
+void GlobalTable::clear() {
+    all.clear();
+    byRange.clear();
+    indexedEnd.clear();
+    byName.clear();
+}
+
+//! \returns the global named \a nam, or nullptr
+Global *GlobalTable::find(const QString &nam) const { return byName.value(nam, nullptr); }
+
+/***************************************************************************/ /**
+  * \brief Find the global that covers \a addr (see Global::addressWithinGlobal).
+  *
+  * Where globals overlap, the one that starts closest below \a addr wins; of those starting at the same address, the
+  * one whose name sorts first.
+  * \returns the global, or nullptr if no global covers \a addr
+  ******************************************************************************/
+Global *GlobalTable::findContaining(ADDRESS addr) const {
+    auto it = byRange.find(addr);
+    if (it == byRange.end())
+        return nullptr;
+    Global *found = nullptr;
+    for (Global *g : it->second) {
+        if (found == nullptr || g->getAddress() > found->getAddress() ||
+            (g->getAddress() == found->getAddress() && g->getName() < found->getName()))
+            found = g;
+    }
+    return found;
+}
+
+//! Keep the index right after the type of \a g changed
+void GlobalTable::retyped(Global *g) {
+    auto it = indexedEnd.find(g);
+    if (it == indexedEnd.end())
+        return;
+    ADDRESS end = rangeEnd(g);
+    if (end == it->second)
+        return;
+    std::set<Global *> only{g};
+    byRange -= std::make_pair(boost::icl::interval<ADDRESS>::right_open(g->getAddress(), it->second), only);
+    byRange += std::make_pair(boost::icl::interval<ADDRESS>::right_open(g->getAddress(), end), only);
+    it->second = end;
+}
+
+//! The end (exclusive) of the addresses \a g covers; as for Global::addressWithinGlobal, the byte after the last one
+//! of its type is included
+ADDRESS GlobalTable::rangeEnd(Global *g) {
+    ADDRESS::value_type start = g->getAddress().m_value;
+    ADDRESS::value_type bytes = g->getType()->getBytes();
+    ADDRESS::value_type limit = std::numeric_limits<ADDRESS::value_type>::max();
+    // An unbounded array would reach past the end of the address space
+    return ADDRESS::g(bytes >= limit - start ? limit : start + bytes + 1);
 }
 //! Re-decode this proc from scratch
 void Prog::reDecode(UserProc *proc) {
+    waitForSerialTurn();
+    QMutexLocker lock(&m_decodeLock);
     QTextStream os(stderr); // rtl output target
     DefaultFrontend->processProc(proc->getNativeAddress(), proc, os);
 }
 
 void Prog::decodeFragment(UserProc *proc, ADDRESS a) {
+    waitForSerialTurn();
+    QMutexLocker lock(&m_decodeLock);
     if (a >= Image->getLimitTextLow() && a < Image->getLimitTextHigh())
         DefaultFrontend->decodeFragment(proc, a);
     else {
@@ -0,0 +1,1293 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       progserializer.cpp
+  * \brief   Implementation of the ProgSerializer class.
+  ******************************************************************************/
+
+#include "progserializer.h"
+
+#include "exp.h"
+#include "type.h"
+#include "signature.h"
+#include "statement.h"
+#include "prog.h"
+#include "proc.h"
+#include "module.h"
+#include "cfg.h"
+#include "basicblock.h"
+#include "rtl.h"
+#include "boomerang.h"
+#include "log.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+//! Tags for the kind of node that follows in the stream
+enum ExpTag : quint8 {
+    EXP_NULL,
+    EXP_CONST,
+    EXP_TERMINAL,
+    EXP_TYPEVAL,
+    EXP_UNARY,
+    EXP_BINARY,
+    EXP_TERNARY,
+    EXP_TYPED,
+    EXP_REF,
+    EXP_LOCATION,
+    EXP_DEFINE, //!< A node follows that becomes the next entry of the expression table
+    EXP_INDEX   //!< A use of an expression table entry; the index follows
+};
+//! Marks a null type; the other type tags are the eType values
+const quint8 TYPE_NULL = 0xFF;
+//! Type table definition and use, as for expressions
+const quint8 TYPE_DEFINE = 0xFE;
+const quint8 TYPE_INDEX = 0xFD;
+//! Tags for the signature classes (the calling convention specific ones are rebuilt with Signature::instantiate)
+enum SigTag : quint8 { SIG_NULL, SIG_PLAIN, SIG_CUSTOM, SIG_INSTANTIATED };
+
+//! Give the Locations in \a e that belong to a procedure to \a proc instead
+void rebindLocations(const SharedExp &e, UserProc *proc) {
+    Location *l = dynamic_cast<Location *>(e.get());
+    if (l && l->getProc())
+        l->setProc(proc);
+    for (const SharedExp &sub : {e->getSubExp1(), e->getSubExp2(), e->getSubExp3()})
+        if (sub)
+            rebindLocations(sub, proc);
+}
+}
+
+void ProgSerializer::writeExp(QDataStream &os, const SharedConstExp &e) {
+    if (e == nullptr) {
+        os << quint8(EXP_NULL);
+        return;
+    }
+    if (defs == nullptr) {
+        writeExpNode(os, e);
+        return;
+    }
+    quint32 id = internExp(e);
+    os << quint8(EXP_INDEX) << id;
+}
+
+/***************************************************************************/ /**
+  * \brief Return the table index of \a e, writing its definition (after those of its parts) if it is new.
+  ******************************************************************************/
+quint32 ProgSerializer::internExp(const SharedConstExp &e) {
+    QByteArray node;
+    {
+        QDataStream ns(&node, QIODevice::WriteOnly);
+        ns.setVersion(defs->version());
+        writeExpNode(ns, e); // the subexpressions are interned as a side effect
+    }
+    auto it = expIds.constFind(node);
+    if (it != expIds.constEnd())
+        return it.value();
+    *defs << quint8(EXP_DEFINE);
+    defs->writeRawData(node.constData(), node.size());
+    quint32 id = quint32(expIds.size());
+    expIds.insert(node, id);
+    return id;
+}
+
+void ProgSerializer::writeExpNode(QDataStream &os, const SharedConstExp &e) {
+    Exp *exp = const_cast<Exp *>(e.get());
+    OPER op = e->getOper();
+    if (op == opFlagDef) {
+        // Holds an RTL; never part of the summaries that are persisted
+        failed = true;
+        os << quint8(EXP_NULL);
+        return;
+    }
+    if (const Const *c = dynamic_cast<const Const *>(exp)) {
+        os << quint8(EXP_CONST) << qint32(op);
+        switch (op) {
+        case opIntConst:
+            os << quint32(c->getInt());
+            break;
+        case opLongConst:
+            os << quint64(c->getLong());
+            break;
+        case opFltConst:
+            os << c->getFlt();
+            break;
+        case opStrConst:
+            os << c->getStr();
+            break;
+        case opFuncConst:
+            os << c->getFuncName();
+            break;
+        default:
+            failed = true;
+            break;
+        }
+        os << qint32(const_cast<Const *>(c)->getConscript());
+        writeType(os, c->getType());
+        return;
+    }
+    if (RefExp *r = dynamic_cast<RefExp *>(exp)) {
+        qint32 def = -1;
+        if (r->getDef() && defs) {
+            // writeProg: the position of the definition in its procedure
+            auto it = stmtIds.find(r->getDef());
+            if (it == stmtIds.end())
+                failed = true;
+            else
+                def = it->second;
+        } else if (r->getDef())
+            def = r->getDef()->getNumber();
+        os << quint8(EXP_REF) << def;
+        writeExp(os, e->getSubExp1());
+        return;
+    }
+    if (TypedExp *t = dynamic_cast<TypedExp *>(exp)) {
+        os << quint8(EXP_TYPED);
+        writeType(os, t->getType());
+        writeExp(os, e->getSubExp1());
+        return;
+    }
+    if (Location *l = dynamic_cast<Location *>(exp)) {
+        os << quint8(EXP_LOCATION) << qint32(op) << bool(l->getProc() != nullptr);
+        writeExp(os, e->getSubExp1());
+        return;
+    }
+    if (dynamic_cast<const Ternary *>(exp)) {
+        os << quint8(EXP_TERNARY) << qint32(op);
+        writeExp(os, e->getSubExp1());
+        writeExp(os, e->getSubExp2());
+        writeExp(os, e->getSubExp3());
+        return;
+    }
+    if (dynamic_cast<const Binary *>(exp)) {
+        os << quint8(EXP_BINARY) << qint32(op);
+        writeExp(os, e->getSubExp1());
+        writeExp(os, e->getSubExp2());
+        return;
+    }
+    if (dynamic_cast<const Unary *>(exp)) {
+        os << quint8(EXP_UNARY) << qint32(op);
+        writeExp(os, e->getSubExp1());
+        return;
+    }
+    if (TypeVal *tv = dynamic_cast<TypeVal *>(exp)) {
+        os << quint8(EXP_TYPEVAL);
+        writeType(os, tv->getType());
+        return;
+    }
+    os << quint8(EXP_TERMINAL) << qint32(op);
+}
+
+SharedExp ProgSerializer::readExp(QDataStream &is) {
+    quint8 tag;
+    is >> tag;
+    while (tag == EXP_DEFINE && is.status() == QDataStream::Ok) {
+        quint8 nodeTag;
+        is >> nodeTag;
+        ++defining;
+        SharedExp e = readExpNode(is, nodeTag);
+        --defining;
+        expTable.emplace_back(e, proc);
+        is >> tag;
+    }
+    if (is.status() != QDataStream::Ok)
+        return nullptr;
+    if (tag != EXP_INDEX)
+        return readExpNode(is, tag);
+    quint32 id;
+    is >> id;
+    if (is.status() != QDataStream::Ok || id >= expTable.size() || expTable[id].first == nullptr) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return nullptr;
+    }
+    SharedExp e = expTable[id].first->clone();
+    if (expTable[id].second != proc)
+        rebindLocations(e, proc);
+    if (!refDefs.empty())
+        noteRefs(expTable[id].first, e);
+    return e;
+}
+
+/***************************************************************************/ /**
+  * \brief The subscripts of \a to, a copy of \a from, get the definitions of those of \a from: inside a table
+  * definition they are table nodes themselves, otherwise they are resolved when the CFG has been read.
+  ******************************************************************************/
+void ProgSerializer::noteRefs(const SharedExp &from, const SharedExp &to) {
+    if (from == nullptr || to == nullptr)
+        return;
+    auto it = refDefs.find(from.get());
+    if (it != refDefs.end()) {
+        if (defining)
+            refDefs[to.get()] = it->second;
+        else
+            procRefs.emplace_back(std::static_pointer_cast<RefExp>(to), it->second);
+    }
+    noteRefs(from->getSubExp1(), to->getSubExp1());
+    noteRefs(from->getSubExp2(), to->getSubExp2());
+    noteRefs(from->getSubExp3(), to->getSubExp3());
+}
+
+SharedExp ProgSerializer::readExpNode(QDataStream &is, quint8 tag) {
+    qint32 op;
+    if (is.status() != QDataStream::Ok)
+        return nullptr;
+    switch (tag) {
+    case EXP_NULL:
+        return nullptr;
+    case EXP_CONST: {
+        is >> op;
+        std::shared_ptr<Const> c;
+        switch (op) {
+        case opIntConst: {
+            quint32 v;
+            is >> v;
+            c = Const::get(0);
+            c->setAddr(ADDRESS::g(v)); // Also sets the int; getAddr() must not see stale high bytes
+            break;
+        }
+        case opLongConst: {
+            quint64 v;
+            is >> v;
+            c = Const::get(QWord(v));
+            break;
+        }
+        case opFltConst: {
+            double v;
+            is >> v;
+            c = Const::get(v);
+            break;
+        }
+        case opStrConst: {
+            QString v;
+            is >> v;
+            c = Const::get(v);
+            break;
+        }
+        case opFuncConst: {
+            QString name;
+            is >> name;
+            Function *f = prog ? prog->findProc(name) : nullptr;
+            if (f == nullptr) {
+                is.setStatus(QDataStream::ReadCorruptData);
+                return nullptr;
+            }
+            c = Const::get(f);
+            break;
+        }
+        default:
+            is.setStatus(QDataStream::ReadCorruptData);
+            return nullptr;
+        }
+        qint32 conscript;
+        is >> conscript;
+        c->setConscript(conscript);
+        c->setType(readType(is));
+        return c;
+    }
+    case EXP_TERMINAL:
+        is >> op;
+        return Terminal::get(OPER(op));
+    case EXP_TYPEVAL:
+        return TypeVal::get(readType(is));
+    case EXP_UNARY: {
+        is >> op;
+        SharedExp e1 = readExp(is);
+        return e1 ? Unary::get(OPER(op), e1) : nullptr;
+    }
+    case EXP_BINARY: {
+        is >> op;
+        SharedExp e1 = readExp(is);
+        SharedExp e2 = readExp(is);
+        return e1 && e2 ? Binary::get(OPER(op), e1, e2) : nullptr;
+    }
+    case EXP_TERNARY: {
+        is >> op;
+        SharedExp e1 = readExp(is);
+        SharedExp e2 = readExp(is);
+        SharedExp e3 = readExp(is);
+        return e1 && e2 && e3 ? std::make_shared<Ternary>(OPER(op), e1, e2, e3) : nullptr;
+    }
+    case EXP_TYPED: {
+        SharedType ty = readType(is);
+        SharedExp e1 = readExp(is);
+        return e1 ? std::make_shared<TypedExp>(ty, e1) : nullptr;
+    }
+    case EXP_REF: {
+        qint32 defNum;
+        is >> defNum; // Only readProg restores definitions; see the class comment
+        SharedExp e1 = readExp(is);
+        if (e1 == nullptr)
+            return nullptr;
+        auto r = RefExp::get(e1, nullptr);
+        if (readingProg && defNum >= 0) {
+            if (defining)
+                refDefs[r.get()] = defNum;
+            else
+                procRefs.emplace_back(r, defNum);
+        }
+        return r;
+    }
+    case EXP_LOCATION: {
+        bool hasProc;
+        is >> op >> hasProc;
+        SharedExp e1 = readExp(is);
+        return e1 ? Location::get(OPER(op), e1, hasProc ? proc : nullptr) : nullptr;
+    }
+    }
+    is.setStatus(QDataStream::ReadCorruptData);
+    return nullptr;
+}
+
+void ProgSerializer::writeType(QDataStream &os, const SharedConstType &ty) {
+    if (ty == nullptr) {
+        os << TYPE_NULL;
+        return;
+    }
+    if (defs == nullptr) {
+        writeTypeNode(os, ty);
+        return;
+    }
+    quint32 id = internType(ty);
+    os << TYPE_INDEX << id;
+}
+
+quint32 ProgSerializer::internType(const SharedConstType &ty) {
+    QByteArray node;
+    {
+        QDataStream ns(&node, QIODevice::WriteOnly);
+        ns.setVersion(defs->version());
+        writeTypeNode(ns, ty);
+    }
+    auto it = typeIds.constFind(node);
+    if (it != typeIds.constEnd())
+        return it.value();
+    *defs << TYPE_DEFINE;
+    defs->writeRawData(node.constData(), node.size());
+    quint32 id = quint32(typeIds.size());
+    typeIds.insert(node, id);
+    return id;
+}
+
+void ProgSerializer::writeTypeNode(QDataStream &os, const SharedConstType &ty) {
+    Type *t = const_cast<Type *>(ty.get());
+    // LowerType is constructed with the eUpper id, so test for it first
+    eType id = t->isLower() ? eLower : t->getId();
+    os << quint8(id);
+    switch (id) {
+    case eVoid:
+    case eBoolean:
+    case eChar:
+        break;
+    case eFunc: {
+        Signature *sig = static_cast<FuncType *>(t)->getSignature();
+        writeSignature(os, sig ? sig->shared_from_this() : nullptr);
+        break;
+    }
+    case eInteger:
+        os << quint32(t->getSize()) << qint32(static_cast<IntegerType *>(t)->getSignedness());
+        break;
+    case eFloat:
+    case eSize:
+        os << quint32(t->getSize());
+        break;
+    case ePointer:
+        writeType(os, static_cast<PointerType *>(t)->getPointsTo());
+        break;
+    case eArray: {
+        ArrayType *a = static_cast<ArrayType *>(t);
+        os << quint64(a->getLength());
+        writeType(os, a->getBaseType());
+        break;
+    }
+    case eNamed:
+        os << static_cast<NamedType *>(t)->getName();
+        break;
+    case eCompound: {
+        CompoundType *c = static_cast<CompoundType *>(t);
+        os << c->isGeneric() << quint32(c->getNumTypes());
+        for (unsigned i = 0; i < c->getNumTypes(); ++i) {
+            os << c->getName(i);
+            writeType(os, c->getType(i));
+        }
+        break;
+    }
+    case eUnion: {
+        // The members are kept in a hash set; sort them so that the encoding does not depend on the hash seed
+        UnionType *u = static_cast<UnionType *>(t);
+        std::vector<std::pair<QString, const UnionElement *>> members;
+        for (const UnionElement &el : *u)
+            members.emplace_back(el.type->getCtype() + el.name, &el);
+        std::sort(members.begin(), members.end(),
+                  [](const std::pair<QString, const UnionElement *> &a,
+                     const std::pair<QString, const UnionElement *> &b) { return a.first < b.first; });
+        os << quint32(members.size());
+        for (const auto &m : members) {
+            os << m.second->name;
+            writeType(os, m.second->type);
+        }
+        break;
+    }
+    case eUpper:
+        writeType(os, static_cast<UpperType *>(t)->getBaseType());
+        break;
+    case eLower:
+        writeType(os, static_cast<LowerType *>(t)->getBaseType());
+        break;
+    }
+}
+
+SharedType ProgSerializer::readType(QDataStream &is) {
+    quint8 id;
+    is >> id;
+    while (id == TYPE_DEFINE && is.status() == QDataStream::Ok) {
+        quint8 nodeId;
+        is >> nodeId;
+        typeTable.push_back(readTypeNode(is, nodeId));
+        is >> id;
+    }
+    if (is.status() != QDataStream::Ok || id == TYPE_NULL)
+        return nullptr;
+    if (id != TYPE_INDEX)
+        return readTypeNode(is, id);
+    quint32 idx;
+    is >> idx;
+    if (is.status() != QDataStream::Ok || idx >= typeTable.size() || typeTable[idx] == nullptr) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return nullptr;
+    }
+    return typeTable[idx]->clone();
+}
+
+SharedType ProgSerializer::readTypeNode(QDataStream &is, quint8 id) {
+    if (is.status() != QDataStream::Ok || id == TYPE_NULL)
+        return nullptr;
+    quint32 size;
+    switch (id) {
+    case eVoid:
+        return VoidType::get();
+    case eBoolean:
+        return BooleanType::get();
+    case eChar:
+        return CharType::get();
+    case eFunc:
+        return FuncType::get(readSignature(is));
+    case eInteger: {
+        qint32 sign;
+        is >> size >> sign;
+        return IntegerType::get(size, sign);
+    }
+    case eFloat:
+        is >> size;
+        return FloatType::get(size);
+    case eSize:
+        is >> size;
+        return SizeType::get(size);
+    case ePointer:
+        return PointerType::get(readType(is));
+    case eArray: {
+        quint64 length;
+        is >> length;
+        SharedType base = readType(is);
+        if (base == nullptr)
+            break;
+        auto a = ArrayType::get(base);
+        a->setLength(length);
+        return a;
+    }
+    case eNamed: {
+        QString name;
+        is >> name;
+        return NamedType::get(name);
+    }
+    case eCompound: {
+        bool generic;
+        quint32 n;
+        is >> generic >> n;
+        auto c = CompoundType::get(generic);
+        for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+            QString name;
+            is >> name;
+            SharedType member = readType(is);
+            if (member == nullptr)
+                break;
+            c->types.push_back(member);
+            c->names.push_back(name);
+        }
+        if (generic)
+            c->nextGenericMemberNum = int(n) + 1;
+        return c;
+    }
+    case eUnion: {
+        quint32 n;
+        is >> n;
+        auto u = UnionType::get();
+        for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+            QString name;
+            is >> name;
+            SharedType member = readType(is);
+            if (member == nullptr)
+                break;
+            u->addType(member, name);
+        }
+        return u;
+    }
+    case eUpper: {
+        SharedType base = readType(is);
+        return base ? std::make_shared<UpperType>(base) : nullptr;
+    }
+    case eLower: {
+        SharedType base = readType(is);
+        return base ? std::make_shared<LowerType>(base) : nullptr;
+    }
+    }
+    is.setStatus(QDataStream::ReadCorruptData);
+    return nullptr;
+}
+
+void ProgSerializer::writeSignature(QDataStream &os, const std::shared_ptr<Signature> &sig) {
+    if (sig == nullptr) {
+        os << quint8(SIG_NULL);
+        return;
+    }
+    if (CustomSignature *cs = dynamic_cast<CustomSignature *>(sig.get()))
+        os << quint8(SIG_CUSTOM) << qint32(cs->getStackRegister());
+    else if (sig->isPromoted())
+        os << quint8(SIG_INSTANTIATED) << qint32(sig->getPlatform()) << qint32(sig->getConvention());
+    else
+        os << quint8(SIG_PLAIN);
+    os << sig->name << sig->sigFile << sig->ellipsis << sig->unknown << sig->forced;
+    os << quint32(sig->params.size());
+    for (const std::shared_ptr<Parameter> &p : sig->params) {
+        os << p->name() << p->getBoundMax();
+        writeType(os, p->getType());
+        writeExp(os, p->getExp());
+    }
+    os << quint32(sig->returns.size());
+    for (const std::shared_ptr<Return> &r : sig->returns) {
+        writeType(os, r->type);
+        writeExp(os, r->exp);
+    }
+    writeType(os, sig->rettype);
+    writeType(os, sig->preferedReturn);
+    os << sig->preferedName << quint32(sig->preferedParams.size());
+    for (int n : sig->preferedParams)
+        os << qint32(n);
+}
+
+std::shared_ptr<Signature> ProgSerializer::readSignature(QDataStream &is) {
+    quint8 tag;
+    is >> tag;
+    if (is.status() != QDataStream::Ok || tag == SIG_NULL)
+        return nullptr;
+    std::shared_ptr<Signature> sig;
+    switch (tag) {
+    case SIG_PLAIN:
+        sig = std::make_shared<Signature>("");
+        break;
+    case SIG_CUSTOM: {
+        qint32 sp;
+        is >> sp;
+        auto cs = std::make_shared<CustomSignature>("");
+        cs->setSP(sp);
+        sig = cs;
+        break;
+    }
+    case SIG_INSTANTIATED: {
+        qint32 plat, cc;
+        is >> plat >> cc;
+        sig = Signature::instantiate(platform(plat), callconv(cc), "");
+        break;
+    }
+    }
+    if (sig == nullptr) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return nullptr;
+    }
+    quint32 n;
+    is >> sig->name >> sig->sigFile >> sig->ellipsis >> sig->unknown >> sig->forced;
+    // An instantiated signature comes with its platform's default returns; the written ones replace them
+    sig->params.clear();
+    sig->returns.clear();
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name, boundMax;
+        is >> name >> boundMax;
+        SharedType ty = readType(is);
+        SharedExp e = readExp(is);
+        sig->params.push_back(std::make_shared<Parameter>(ty, name, e, boundMax));
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        SharedType ty = readType(is);
+        SharedExp e = readExp(is);
+        sig->returns.push_back(std::make_shared<Return>(ty, e));
+    }
+    sig->rettype = readType(is);
+    sig->preferedReturn = readType(is);
+    is >> sig->preferedName >> n;
+    sig->preferedParams.clear();
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        qint32 p;
+        is >> p;
+        sig->preferedParams.push_back(p);
+    }
+    return is.status() == QDataStream::Ok ? sig : nullptr;
+}
+
+qint32 ProgSerializer::procId(Function *f) const {
+    auto it = procIds.find(f);
+    return it == procIds.end() ? -1 : it->second;
+}
+
+Function *ProgSerializer::procAt(QDataStream &is, qint32 idx) {
+    if (idx < 0)
+        return nullptr;
+    if (size_t(idx) >= procs.size()) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return nullptr;
+    }
+    return procs[idx];
+}
+
+/***************************************************************************/ /**
+  * \brief Write the whole of \a prog, which must not have been decompiled yet.
+  *
+  * The program is written in this order: its name and counters, the module tree, a header (module, kind, name and
+  * address) for every procedure, the globals and entry points, and then the body of each procedure. The headers come
+  * first so that everything after them can refer to procedures by index or name.
+  * \returns false if something could not be encoded
+  ******************************************************************************/
+bool ProgSerializer::writeProg(QDataStream &os) {
+    procs.clear();
+    procIds.clear();
+    std::vector<Module *> modules;
+    std::map<Module *, qint32> moduleIds;
+    for (Module *m : prog->getModuleList()) {
+        moduleIds[m] = qint32(modules.size());
+        modules.push_back(m);
+        for (Function *f : *m) {
+            if (!f->isLib() && static_cast<UserProc *>(f)->status > PROC_DECODED) {
+                LOG_STREAM() << "cannot save " << f->getName() << ": only decoded procedures can be saved\n";
+                return false;
+            }
+            procIds[f] = qint32(procs.size());
+            procs.push_back(f);
+        }
+    }
+    defs = &os;
+    expIds.clear();
+    typeIds.clear();
+
+    os << prog->m_name << prog->m_path << qint32(prog->m_iNumberedProc) << prog->bRegisterJump << prog->bRegisterCall;
+    os << quint32(modules.size());
+    for (Module *m : modules) {
+        os << m->getName() << m->isAggregate() << quint32(m->getNumChildren());
+        for (size_t i = 0; i < m->getNumChildren(); ++i)
+            os << moduleIds[m->getChild(i)];
+    }
+    os << (prog->m_rootCluster ? moduleIds[prog->m_rootCluster] : qint32(-1));
+
+    os << quint32(procs.size());
+    for (Function *f : procs)
+        os << moduleIds[f->Parent] << f->isLib() << f->getName() << quint64(f->address.m_value);
+
+    os << quint32(prog->globals.size());
+    for (Global *g : prog->globals) {
+        os << g->nam << quint64(g->uaddr.m_value);
+        writeType(os, g->type);
+    }
+    os << quint32(prog->entryProcs.size());
+    for (UserProc *up : prog->entryProcs)
+        os << procId(up);
+
+    for (Function *f : procs)
+        writeProc(os, f);
+    defs = nullptr;
+    stmtIds.clear();
+    return ok() && os.status() == QDataStream::Ok;
+}
+
+/***************************************************************************/ /**
+  * \brief Read a program written by writeProg() into \a prog.
+  *
+  * \a prog must have its front end set (so the image is loaded and the root module exists). Procedures and globals
+  * that already exist (e.g. from a symbol file) are kept; a procedure with a forced signature keeps it.
+  ******************************************************************************/
+bool ProgSerializer::readProg(QDataStream &is) {
+    procs.clear();
+    expTable.clear();
+    typeTable.clear();
+    refDefs.clear();
+    readingProg = true;
+    bool res = readProgBody(is);
+    readingProg = false;
+    refDefs.clear();
+    procRefs.clear();
+    return res;
+}
+
+bool ProgSerializer::readProgBody(QDataStream &is) {
+    qint32 numbered;
+    is >> prog->m_name >> prog->m_path >> numbered >> prog->bRegisterJump >> prog->bRegisterCall;
+    prog->m_iNumberedProc = numbered;
+
+    quint32 n;
+    is >> n;
+    std::vector<Module *> modules;
+    std::vector<std::vector<qint32>> children;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name;
+        bool aggregate;
+        quint32 numChildren;
+        is >> name >> aggregate >> numChildren;
+        if (aggregate)
+            modules.push_back(prog->getOrInsertModule(name, ClassModFactory()));
+        else
+            modules.push_back(prog->getOrInsertModule(name));
+        children.emplace_back();
+        for (quint32 c = 0; c < numChildren && is.status() == QDataStream::Ok; ++c) {
+            qint32 child;
+            is >> child;
+            children.back().push_back(child);
+        }
+    }
+    qint32 root;
+    is >> root;
+    if (is.status() != QDataStream::Ok || root >= qint32(modules.size()))
+        return false;
+    for (size_t i = 0; i < modules.size(); ++i) {
+        for (qint32 child : children[i]) {
+            if (child < 0 || size_t(child) >= modules.size()) {
+                is.setStatus(QDataStream::ReadCorruptData);
+                return false;
+            }
+            modules[i]->addChild(modules[child]);
+        }
+    }
+    if (root >= 0)
+        prog->m_rootCluster = modules[root];
+
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        qint32 module;
+        bool lib;
+        QString name;
+        quint64 addr;
+        is >> module >> lib >> name >> addr;
+        if (is.status() != QDataStream::Ok || module < 0 || size_t(module) >= modules.size()) {
+            is.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        procs.push_back(modules[module]->getOrInsertFunction(name, ADDRESS::g(addr), lib));
+    }
+
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name;
+        quint64 addr;
+        is >> name >> addr;
+        SharedType ty = readType(is);
+        if (prog->globals.find(name) == nullptr)
+            prog->globals.insert(new Global(ty, ADDRESS::g(addr), name, prog));
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        qint32 idx;
+        is >> idx;
+        Function *f = procAt(is, idx);
+        if (f == nullptr || f->isLib()) {
+            is.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        prog->entryProcs.push_back(static_cast<UserProc *>(f));
+    }
+
+    for (Function *f : procs)
+        if (!readProc(is, f))
+            return false;
+    return is.status() == QDataStream::Ok;
+}
+
+void ProgSerializer::writeProc(QDataStream &os, Function *f) {
+    proc = f->isLib() ? nullptr : static_cast<UserProc *>(f);
+    // Subscripts refer to their definitions by position, in the order writeCfg writes the statements
+    stmtIds.clear();
+    if (proc) {
+        for (BasicBlock *bb : proc->cfg->m_listBB) {
+            if (bb->ListOfRTLs == nullptr)
+                continue;
+            for (RTL *rtl : *bb->ListOfRTLs)
+                for (Instruction *s : *rtl)
+                    stmtIds.insert(std::make_pair(s, qint32(stmtIds.size())));
+        }
+    }
+    writeSignature(os, f->signature);
+    os << procId(f->m_firstCaller) << quint64(f->m_firstCallerAddr.m_value);
+    os << quint32(f->provenTrue.size());
+    for (const auto &pt : f->provenTrue) {
+        writeExp(os, pt.first);
+        writeExp(os, pt.second);
+    }
+    if (proc == nullptr)
+        return;
+    UserProc *up = proc;
+    os << qint32(up->status) << qint32(up->nextLocal) << qint32(up->nextParam);
+    os << quint32(up->locals.size());
+    for (const auto &local : up->locals) {
+        os << local.first;
+        writeType(os, local.second);
+    }
+    os << quint32(up->symbolMap.size());
+    for (const auto &sym : up->symbolMap) {
+        writeExp(os, sym.first);
+        writeExp(os, sym.second);
+    }
+    os << quint32(up->calleeList.size());
+    for (Function *callee : up->calleeList)
+        os << procId(callee);
+    writeCfg(os, up);
+    proc = nullptr;
+}
+
+bool ProgSerializer::readProc(QDataStream &is, Function *f) {
+    proc = f->isLib() ? nullptr : static_cast<UserProc *>(f);
+    procRefs.clear();
+    std::shared_ptr<Signature> sig = readSignature(is);
+    if (sig == nullptr) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    if (f->signature == nullptr || !f->signature->isForced())
+        f->signature = sig;
+    qint32 firstCaller;
+    quint64 firstCallerAddr;
+    is >> firstCaller >> firstCallerAddr;
+    f->m_firstCaller = procAt(is, firstCaller);
+    f->m_firstCallerAddr = ADDRESS::g(firstCallerAddr);
+    quint32 n;
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        SharedExp lhs = readExp(is);
+        SharedExp rhs = readExp(is);
+        if (lhs)
+            f->provenTrue[lhs] = rhs;
+    }
+    if (proc == nullptr) {
+        if (!procRefs.empty())
+            is.setStatus(QDataStream::ReadCorruptData); // A library procedure has no statements to refer to
+        return is.status() == QDataStream::Ok;
+    }
+    UserProc *up = proc;
+    qint32 status, nextLocal, nextParam;
+    is >> status >> nextLocal >> nextParam;
+    if (status < PROC_UNDECODED || status > PROC_DECODED) {
+        is.setStatus(QDataStream::ReadCorruptData);
+        return false;
+    }
+    up->status = ProcStatus(status);
+    up->nextLocal = nextLocal;
+    up->nextParam = nextParam;
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name;
+        is >> name;
+        up->locals[name] = readType(is);
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        SharedExp from = readExp(is);
+        SharedExp to = readExp(is);
+        if (from && to)
+            up->symbolMap.insert(std::make_pair(SharedConstExp(from), to));
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        qint32 idx;
+        is >> idx;
+        if (Function *callee = procAt(is, idx))
+            up->calleeList.push_back(callee);
+    }
+    bool res = readCfg(is, up);
+    proc = nullptr;
+    return res;
+}
+
+/***************************************************************************/ /**
+  * \brief Write the CFG of \a up: its BBs in list order, each with its RTLs and edges (as BB indices).
+  ******************************************************************************/
+void ProgSerializer::writeCfg(QDataStream &os, UserProc *up) {
+    Cfg *cfg = up->cfg;
+    std::map<BasicBlock *, qint32> bbIds;
+    for (BasicBlock *bb : cfg->m_listBB)
+        bbIds.insert(std::make_pair(bb, qint32(bbIds.size())));
+    auto bbId = [&bbIds](BasicBlock *bb) {
+        auto it = bbIds.find(bb);
+        return it == bbIds.end() ? qint32(-1) : it->second;
+    };
+    os << bool(cfg->WellFormed) << cfg->ImplicitsDone << qint32(cfg->lastLabel);
+    os << quint32(cfg->m_listBB.size());
+    qint32 numStmts = 0, returnStmt = -1;
+    for (BasicBlock *bb : cfg->m_listBB) {
+        os << qint32(bb->NodeType) << qint32(bb->LabelNum) << bb->LabelNeeded << bb->Incomplete << bb->JumpReqd
+           << quint32(bb->TargetOutEdges);
+        os << bool(bb->ListOfRTLs != nullptr);
+        if (bb->ListOfRTLs) {
+            os << quint32(bb->ListOfRTLs->size());
+            for (RTL *rtl : *bb->ListOfRTLs) {
+                os << quint64(rtl->getAddress().m_value) << quint32(rtl->size());
+                for (Instruction *s : *rtl) {
+                    if (s == up->theReturnStatement)
+                        returnStmt = numStmts;
+                    ++numStmts;
+                    writeStatement(os, s);
+                }
+            }
+        }
+        os << quint32(bb->InEdges.size());
+        for (BasicBlock *in : bb->InEdges)
+            os << bbId(in);
+        os << quint32(bb->OutEdges.size());
+        for (BasicBlock *out : bb->OutEdges)
+            os << bbId(out);
+    }
+    os << quint32(cfg->m_mapBB.size());
+    for (const auto &mapped : cfg->m_mapBB)
+        os << quint64(mapped.first.m_value) << bbId(mapped.second);
+    os << bbId(cfg->entryBB) << bbId(cfg->exitBB) << returnStmt;
+}
+
+bool ProgSerializer::readCfg(QDataStream &is, UserProc *up) {
+    Cfg *cfg = up->cfg;
+    bool wellFormed;
+    qint32 lastLabel;
+    quint32 n;
+    is >> wellFormed >> cfg->ImplicitsDone >> lastLabel >> n;
+    if (is.status() != QDataStream::Ok)
+        return false;
+    cfg->WellFormed = wellFormed;
+    cfg->lastLabel = lastLabel;
+    // Create the BBs first, so that edges can refer to BBs later in the list
+    std::vector<BasicBlock *> bbs;
+    for (quint32 i = 0; i < n; ++i) {
+        BasicBlock *bb = new BasicBlock(up);
+        cfg->addBB(bb);
+        bbs.push_back(bb);
+    }
+    auto bbAt = [&is, &bbs](qint32 idx) -> BasicBlock * {
+        if (idx < 0)
+            return nullptr;
+        if (size_t(idx) >= bbs.size()) {
+            is.setStatus(QDataStream::ReadCorruptData);
+            return nullptr;
+        }
+        return bbs[idx];
+    };
+    std::vector<Instruction *> stmts;
+    for (BasicBlock *bb : bbs) {
+        qint32 nodeType;
+        quint32 targetOutEdges;
+        bool hasRTLs;
+        is >> nodeType >> bb->LabelNum >> bb->LabelNeeded >> bb->Incomplete >> bb->JumpReqd >> targetOutEdges
+           >> hasRTLs;
+        bb->NodeType = BBTYPE(nodeType);
+        bb->TargetOutEdges = targetOutEdges;
+        if (hasRTLs) {
+            quint32 numRTLs;
+            is >> numRTLs;
+            bb->ListOfRTLs = new std::list<RTL *>;
+            for (quint32 r = 0; r < numRTLs && is.status() == QDataStream::Ok; ++r) {
+                quint64 addr;
+                quint32 numStmts;
+                is >> addr >> numStmts;
+                RTL *rtl = new RTL(ADDRESS::g(addr));
+                bb->ListOfRTLs->push_back(rtl);
+                for (quint32 k = 0; k < numStmts; ++k) {
+                    Instruction *s = readStatement(is);
+                    if (s == nullptr)
+                        return false;
+                    s->setBB(bb);
+                    s->setProc(up);
+                    rtl->push_back(s);
+                    stmts.push_back(s);
+                    if (s->isCall())
+                        cfg->addCall(static_cast<CallStatement *>(s));
+                }
+            }
+        }
+        if (hasRTLs)
+            cfg->indexBB(bb);
+        quint32 numEdges;
+        is >> numEdges;
+        for (quint32 e = 0; e < numEdges && is.status() == QDataStream::Ok; ++e) {
+            qint32 idx;
+            is >> idx;
+            bb->InEdges.push_back(bbAt(idx));
+        }
+        is >> numEdges;
+        for (quint32 e = 0; e < numEdges && is.status() == QDataStream::Ok; ++e) {
+            qint32 idx;
+            is >> idx;
+            bb->OutEdges.push_back(bbAt(idx));
+        }
+        if (is.status() != QDataStream::Ok)
+            return false;
+    }
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        quint64 addr;
+        qint32 idx;
+        is >> addr >> idx;
+        cfg->m_mapBB[ADDRESS::g(addr)] = bbAt(idx);
+    }
+    qint32 entry, exit, returnStmt;
+    is >> entry >> exit >> returnStmt;
+    cfg->entryBB = bbAt(entry);
+    cfg->exitBB = bbAt(exit);
+    if (returnStmt >= 0) {
+        ReturnStatement *ret = size_t(returnStmt) < stmts.size()
+                                   ? dynamic_cast<ReturnStatement *>(stmts[returnStmt]) : nullptr;
+        if (ret == nullptr) {
+            is.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        up->theReturnStatement = ret;
+    }
+    for (auto &ref : procRefs) {
+        if (size_t(ref.second) >= stmts.size()) {
+            is.setStatus(QDataStream::ReadCorruptData);
+            return false;
+        }
+        ref.first->setDef(stmts[ref.second]);
+    }
+    procRefs.clear();
+    return is.status() == QDataStream::Ok;
+}
+
+void ProgSerializer::writeStatements(QDataStream &os, StatementList &stmts) {
+    os << quint32(stmts.size());
+    for (Instruction *s : stmts)
+        writeStatement(os, s);
+}
+
+bool ProgSerializer::readStatements(QDataStream &is, StatementList &stmts) {
+    quint32 n;
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        Instruction *s = readStatement(is);
+        if (s == nullptr)
+            return false;
+        if (proc)
+            s->setProc(proc);
+        stmts.append(s);
+    }
+    return is.status() == QDataStream::Ok;
+}
+
+/***************************************************************************/ /**
+  * \brief Write \a s as its kind, its number and the fields of its class.
+  *
+  * Only the statements that the decoder makes are supported; phi assignments mark the serializer as failed.
+  ******************************************************************************/
+void ProgSerializer::writeStatement(QDataStream &os, Instruction *s) {
+    os << quint8(s->getKind()) << qint32(s->getNumber());
+    switch (s->getKind()) {
+    case STMT_ASSIGN: {
+        Assign *a = static_cast<Assign *>(s);
+        writeType(os, a->getType());
+        writeExp(os, a->getLeft());
+        writeExp(os, a->getRight());
+        writeExp(os, a->getGuard());
+        break;
+    }
+    case STMT_IMPASSIGN: {
+        ImplicitAssign *a = static_cast<ImplicitAssign *>(s);
+        writeType(os, a->getType());
+        writeExp(os, a->getLeft());
+        break;
+    }
+    case STMT_BOOLASSIGN: {
+        BoolAssign *b = static_cast<BoolAssign *>(s);
+        os << qint32(b->getSize());
+        writeType(os, b->getType());
+        writeExp(os, b->getLeft());
+        os << qint32(b->getCond()) << b->isFloat();
+        writeExp(os, b->getCondExpr());
+        break;
+    }
+    case STMT_IMPREF: {
+        ImpRefStatement *r = static_cast<ImpRefStatement *>(s);
+        writeType(os, r->getType());
+        writeExp(os, r->getAddressExp());
+        break;
+    }
+    case STMT_GOTO:
+    case STMT_BRANCH:
+    case STMT_CASE:
+    case STMT_CALL: {
+        GotoStatement *g = static_cast<GotoStatement *>(s);
+        writeExp(os, g->getDest());
+        os << g->isComputed();
+        if (s->getKind() == STMT_BRANCH) {
+            BranchStatement *b = static_cast<BranchStatement *>(s);
+            os << qint32(b->jtCond) << b->bFloat << qint32(b->size);
+            writeExp(os, b->pCond);
+        } else if (s->getKind() == STMT_CASE) {
+            SWITCH_INFO *si = static_cast<CaseStatement *>(s)->getSwitchInfo();
+            os << bool(si != nullptr);
+            if (si) {
+                writeExp(os, si->pSwitchVar);
+                os << qint8(si->chForm) << qint32(si->iLower) << qint32(si->iUpper) << quint64(si->uTable.m_value)
+                   << qint32(si->iNumTable) << qint32(si->iOffset);
+            }
+        } else if (s->getKind() == STMT_CALL) {
+            CallStatement *c = static_cast<CallStatement *>(s);
+            os << c->isReturnAfterCall() << procId(c->getDestProc());
+            writeSignature(os, c->getSignature());
+            writeStatements(os, c->getArguments());
+            writeStatements(os, c->getDefines());
+        }
+        break;
+    }
+    case STMT_RET: {
+        ReturnStatement *r = static_cast<ReturnStatement *>(s);
+        os << quint64(r->getRetAddr().m_value);
+        writeStatements(os, r->getModifieds());
+        writeStatements(os, r->getReturns());
+        break;
+    }
+    case STMT_JUNCTION:
+        break;
+    default:
+        failed = true;
+        break;
+    }
+}
+
+Instruction *ProgSerializer::readStatement(QDataStream &is) {
+    quint8 kind;
+    qint32 number;
+    is >> kind >> number;
+    if (is.status() != QDataStream::Ok)
+        return nullptr;
+    Instruction *s = nullptr;
+    switch (kind) {
+    case STMT_ASSIGN: {
+        SharedType ty = readType(is);
+        SharedExp lhs = readExp(is);
+        SharedExp rhs = readExp(is);
+        SharedExp guard = readExp(is);
+        s = new Assign(ty, lhs, rhs, guard);
+        break;
+    }
+    case STMT_IMPASSIGN: {
+        SharedType ty = readType(is);
+        SharedExp lhs = readExp(is);
+        s = new ImplicitAssign(ty, lhs);
+        break;
+    }
+    case STMT_BOOLASSIGN: {
+        qint32 size, cond;
+        bool isFloat;
+        is >> size;
+        BoolAssign *b = new BoolAssign(size);
+        b->setType(readType(is));
+        b->setLeft(readExp(is));
+        is >> cond >> isFloat;
+        b->setCondType(BRANCH_TYPE(cond), isFloat);
+        b->setCondExpr(readExp(is));
+        s = b;
+        break;
+    }
+    case STMT_IMPREF: {
+        SharedType ty = readType(is);
+        SharedExp addr = readExp(is);
+        s = new ImpRefStatement(ty, addr);
+        break;
+    }
+    case STMT_GOTO:
+    case STMT_BRANCH:
+    case STMT_CASE:
+    case STMT_CALL: {
+        GotoStatement *g;
+        if (kind == STMT_BRANCH)
+            g = new BranchStatement;
+        else if (kind == STMT_CASE)
+            g = new CaseStatement;
+        else if (kind == STMT_CALL)
+            g = new CallStatement;
+        else
+            g = new GotoStatement;
+        s = g;
+        bool computed;
+        g->setDest(readExp(is));
+        is >> computed;
+        g->setIsComputed(computed);
+        if (kind == STMT_BRANCH) {
+            BranchStatement *b = static_cast<BranchStatement *>(g);
+            qint32 cond, size;
+            is >> cond >> b->bFloat >> size;
+            b->jtCond = BRANCH_TYPE(cond);
+            b->size = size;
+            b->pCond = readExp(is);
+        } else if (kind == STMT_CASE) {
+            bool hasInfo;
+            is >> hasInfo;
+            if (hasInfo) {
+                SWITCH_INFO *si = new SWITCH_INFO;
+                qint8 form;
+                qint32 lower, upper, numTable, offset;
+                quint64 table;
+                si->pSwitchVar = readExp(is);
+                is >> form >> lower >> upper >> table >> numTable >> offset;
+                si->chForm = char(form);
+                si->iLower = lower;
+                si->iUpper = upper;
+                si->uTable = ADDRESS::g(table);
+                si->iNumTable = numTable;
+                si->iOffset = offset;
+                static_cast<CaseStatement *>(g)->setSwitchInfo(si);
+            }
+        } else if (kind == STMT_CALL) {
+            CallStatement *c = static_cast<CallStatement *>(g);
+            bool returnAfterCall;
+            qint32 dest;
+            is >> returnAfterCall >> dest;
+            c->setReturnAfterCall(returnAfterCall);
+            if (Function *destProc = procAt(is, dest))
+                c->setDestProc(destProc);
+            c->setSignature(readSignature(is));
+            if (!readStatements(is, c->getArguments()) || !readStatements(is, c->getDefines()))
+                break;
+        }
+        break;
+    }
+    case STMT_RET: {
+        ReturnStatement *r = new ReturnStatement;
+        s = r;
+        quint64 retAddr;
+        is >> retAddr;
+        r->setRetAddr(ADDRESS::g(retAddr));
+        if (!readStatements(is, r->getModifieds()))
+            break;
+        readStatements(is, r->getReturns());
+        break;
+    }
+    case STMT_JUNCTION:
+        s = new JunctionStatement;
+        break;
+    default:
+        is.setStatus(QDataStream::ReadCorruptData);
+        return nullptr;
+    }
+    if (is.status() != QDataStream::Ok) {
+        delete s;
+        return nullptr;
+    }
+    s->setNumber(number);
+    return s;
+}
@@ -1,20 +1,125 @@
 #include "project.h"
 #include "BinaryImage.h"
-#include <cassert>
+#include "prog.h"
+#include "frontend.h"
+#include "progserializer.h"
+#include "boomerang.h"
+
+#include <QtCore/QDataStream>
+
+namespace {
+const quint32 PROJECT_MAGIC = 0x424D5250; // "BMRP"
+//! Bump when the layout written by ProgSerializer::writeProg changes
+const quint32 PROJECT_VERSION = 2;
+}
+
 Project::~Project()
 {
+    unloadFile();
     delete Image;
 }
 
-bool Project::serializeTo(QIODevice &/*dev*/)
+/**
+ * \brief Make the contents of \a path available through filedata().
+ *
+ * The file is mapped privately, so filedata() is a view of the mapping rather than a copy: pages are only read in
+ * when a loader touches them, and a loader that patches the image in place (e.g. relocations) gets copy-on-write
+ * pages that never reach the file. Loaders must use constData() (and cast away the const where they patch), since
+ * any non-const access to a raw-data QByteArray makes Qt copy the whole file. If the file cannot be mapped it is
+ * read into memory as before.
+ * \returns false if the file could not be opened
+ */
+bool Project::loadFile(const QString &path)
+{
+    unloadFile();
+    mapped_file.setFileName(path);
+    if (!mapped_file.open(QFile::ReadOnly))
+        return false;
+    qint64 sz = mapped_file.size();
+    if (sz > 0)
+        mapping = mapped_file.map(0, sz, QFileDevice::MapPrivateOption);
+    if (mapping) {
+        file_bytes = QByteArray::fromRawData((const char *)mapping, int(sz));
+        return true;
+    }
+    file_bytes = mapped_file.readAll();
+    mapped_file.close();
+    return true;
+}
+
+void Project::unloadFile()
+{
+    // Drop the view before the memory it refers to goes away
+    file_bytes.clear();
+    if (mapping) {
+        mapped_file.unmap(mapping);
+        mapping = nullptr;
+    }
+    if (mapped_file.isOpen())
+        mapped_file.close();
+}
+
+/**
+ * \brief Save the current program to \a dev.
+ *
+ * The project holds the decoded program, not the binary: the header records the path of the binary, which is
+ * loaded again by serializeFrom(). The program must not have been decompiled yet (see ProgSerializer::writeProg).
+ * \returns false if there is no program, it could not be encoded, or \a dev could not be written
+ */
+bool Project::serializeTo(QIODevice &dev)
 {
-    assert(false);
-    return false;
+    if (Program == nullptr)
+        return false;
+    QDataStream out(&dev);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << PROJECT_MAGIC << PROJECT_VERSION << Program->getPath();
+    ProgSerializer ser(Program);
+    return ser.writeProg(out);
 }
 
-bool Project::serializeFrom(QIODevice &/*dev*/)
+/**
+ * \brief Load a program saved by serializeTo() from \a dev, and make it the current program.
+ *
+ * The data is read front to back, so \a dev can be a sequential device. The symbols and symbol files given on the
+ * command line are applied as Boomerang::loadAndDecode() does, before the saved program is read. On success the
+ * previous program is deleted.
+ * \returns false if \a dev does not hold a project of this version, the binary it was made from cannot be loaded,
+ * or the data is corrupt
+ */
+bool Project::serializeFrom(QIODevice &dev)
 {
-    return false;
+    QDataStream in(&dev);
+    in.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version;
+    QString path;
+    in >> magic >> version;
+    if (in.status() != QDataStream::Ok || magic != PROJECT_MAGIC) {
+        LOG_STREAM() << "not a project file\n";
+        return false;
+    }
+    if (version != PROJECT_VERSION) {
+        LOG_STREAM() << "project file version " << version << " is not supported\n";
+        return false;
+    }
+    in >> path;
+    Prog *prog = new Prog(path);
+    FrontEnd *fe = FrontEnd::Load(path, prog);
+    if (fe == nullptr) {
+        LOG_STREAM() << "cannot load " << path << "\n";
+        delete prog;
+        return false;
+    }
+    prog->setFrontEnd(fe);
+    Boomerang::get()->loadSymbols(prog, fe);
+    ProgSerializer ser(prog);
+    if (!ser.readProg(in)) {
+        LOG_STREAM() << "project file is corrupt\n";
+        delete prog;
+        return false;
+    }
+    delete Program;
+    Program = prog;
+    return true;
 }
 
 IBinaryImage *Project::image()
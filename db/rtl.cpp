@@ -211,7 +211,8 @@ QTextStream &operator<<(QTextStream &os, const RTL *r) {
     return os;
 }
 
-void RTL::simplify() {
+bool RTL::simplify() {
+    bool changed = false;
     for (iterator it = begin(); it != end();) {
         Instruction *s = *it;
         s->simplify();
@@ -221,11 +222,13 @@ void RTL::simplify() {
                 if (cond->access<Const>()->getInt() == 0) {
                     LOG_VERBOSE(1) << "removing branch with false condition at " << getAddress() << " " << *it << "\n";
                     it = this->erase(it);
+                    changed = true;
                     continue;
                 }
                 LOG_VERBOSE(1) << "replacing branch with true condition with goto at " << getAddress() << " " << *it
                                << "\n";
                 *it = new GotoStatement(((BranchStatement *)s)->getFixedDest());
+                changed = true;
             }
         } else if (s->isAssign()) {
             SharedExp guard = ((Assign *)s)->getGuard();
@@ -233,11 +236,13 @@ void RTL::simplify() {
                 // This assignment statement can be deleted
                 LOG_VERBOSE(1) << "removing assignment with false guard at " << getAddress() << " " << *it << "\n";
                 it = erase(it);
+                changed = true;
                 continue;
             }
         }
         it++;
     }
+    return changed;
 }
 // Is this RTL a compare instruction? If so, the passed register and compared value (a semantic string) are set.
 
@@ -264,6 +264,15 @@ CallingConvention::Win32TcSignature::Win32TcSignature(const QString &nam) : Win3
 }
 
 CallingConvention::Win32TcSignature::Win32TcSignature(Signature &old) : Win32Signature(old) {}
+//! \returns \a e, or a copy of it on the heap if an arena is current: a signature outlives the procedure being
+//! decompiled, and one of its expressions would keep a whole chunk of that procedure's arena
+static SharedExp onHeap(const SharedExp &e) {
+    if (e == nullptr || Arena::current() == nullptr)
+        return e;
+    Arena::Scope heap(nullptr);
+    return e->clone();
+}
+
 template<class Cloneable>
 static void cloneVec(std::vector<std::shared_ptr<Cloneable> > &from, std::vector<std::shared_ptr<Cloneable> > &to) {
     unsigned n = from.size();
@@ -273,6 +282,7 @@ static void cloneVec(std::vector<std::shared_ptr<Cloneable> > &from, std::vector
 }
 
 std::shared_ptr<Parameter> Parameter::clone() {
+    Arena::Scope heap(nullptr);
     return std::make_shared<Parameter>(type->clone(), m_name, exp->clone(), boundMax);
 }
 
@@ -1268,7 +1278,9 @@ void Signature::addParameter(std::shared_ptr<Parameter> param) {
 
     if (ty == nullptr || e == nullptr || nam.isNull()) {
         addParameter(ty, nam, e, param->getBoundMax());
-    } else
+    } else if (Arena::current())
+        params.push_back(std::make_shared<Parameter>(ty, nam, onHeap(e), param->getBoundMax()));
+    else
         params.push_back(param);
 }
 
@@ -1343,7 +1355,7 @@ void Signature::setParamType(const SharedExp &e, SharedType ty) {
 
 void Signature::setParamName(int n, const char *name) { params[n]->name(name); }
 
-void Signature::setParamExp(int n, SharedExp e) { params[n]->setExp(e); }
+void Signature::setParamExp(int n, SharedExp e) { params[n]->setExp(onHeap(e)); }
 
 // Return the index for the given expression, or -1 if not found
 int Signature::findParam(const SharedExp &e) {
@@ -1381,6 +1393,14 @@ void Signature::addReturn(SharedType type, SharedExp exp) {
     //    rettype = type->clone();
 }
 
+void Signature::addReturn(std::shared_ptr<Return> ret) {
+    if (Arena::current())
+        ret = std::make_shared<Return>(ret->type, onHeap(ret->exp));
+    returns.emplace_back(ret);
+}
+
+void Signature::setReturnExp(size_t n, SharedExp e) { returns[n]->exp = onHeap(e); }
+
 // Deprecated. Use the above version.
 void Signature::addReturn(SharedExp exp) {
     // addReturn(exp->getType() ? exp->getType() : new IntegerType(), exp);
@@ -1934,6 +1954,7 @@ bool CallingConvention::StdC::SparcSignature::argumentCompare(Assignment &a, Ass
 
 // Class Return methods
 std::shared_ptr<Return> Return::clone() {
+    Arena::Scope heap(nullptr);
     return std::make_shared<Return>(type->clone(), SharedExp(exp->clone())); }
 
 bool Return::operator==(Return &other) {
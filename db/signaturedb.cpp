@@ -0,0 +1,146 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       signaturedb.cpp
+  * \brief   Implementation of the SignatureDb class.
+  ******************************************************************************/
+
+#include "signaturedb.h"
+
+#include "progserializer.h"
+#include "signature.h"
+#include "type.h"
+
+#include <QtCore/QDataStream>
+#include <QtCore/QSaveFile>
+#include <vector>
+
+namespace {
+const quint32 SIGDB_MAGIC = 0x42534442; // "BSDB"
+//! Bump whenever the encoding changes
+const quint32 SIGDB_VERSION = 1;
+}
+
+/***************************************************************************/ /**
+  * \brief Open the database at \a path, if it exists and was made for \a key.
+  *
+  * The named types are read into \a types; signatures are left in the file until get() asks for them.
+  * \returns false if the file is missing, was made for another key, or is corrupt
+  ******************************************************************************/
+bool SignatureDb::open(const QString &path, const QByteArray &key, QMap<QString, SharedType> &types) {
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    size = file.size();
+    data = file.map(0, size);
+    if (data == nullptr) {
+        contents = file.readAll();
+        data = reinterpret_cast<const uchar *>(contents.constData());
+    }
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(data), int(size));
+    QDataStream is(raw);
+    is.setVersion(QDataStream::Qt_5_0);
+    quint32 magic, version, n;
+    QByteArray fileKey;
+    is >> magic >> version >> fileKey;
+    if (is.status() != QDataStream::Ok || magic != SIGDB_MAGIC || version != SIGDB_VERSION || fileKey != key) {
+        close();
+        return false;
+    }
+    ProgSerializer ser(nullptr);
+    is >> n;
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name;
+        is >> name;
+        SharedType ty = ser.readType(is);
+        if (ty)
+            types[name] = ty;
+    }
+    is >> n;
+    index.reserve(int(n));
+    for (quint32 i = 0; i < n && is.status() == QDataStream::Ok; ++i) {
+        QString name;
+        quint32 offset, length;
+        is >> name >> offset >> length;
+        index.insert(name, std::make_pair(offset, length));
+    }
+    recordsStart = is.device()->pos();
+    if (is.status() != QDataStream::Ok) {
+        types.clear();
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SignatureDb::close() {
+    index.clear();
+    if (data != nullptr && contents.isEmpty())
+        file.unmap(const_cast<uchar *>(data));
+    data = nullptr;
+    contents.clear();
+    size = 0;
+    if (file.isOpen())
+        file.close();
+}
+
+/// \returns the signature of the library function \a name, decoded afresh, or nullptr if it is not in the database
+std::shared_ptr<Signature> SignatureDb::get(const QString &name) const {
+    auto it = index.find(name);
+    if (it == index.end())
+        return nullptr;
+    quint32 offset = it.value().first, length = it.value().second;
+    if (recordsStart + offset + length > size)
+        return nullptr;
+    QByteArray raw = QByteArray::fromRawData(reinterpret_cast<const char *>(data + recordsStart + offset), int(length));
+    QDataStream is(raw);
+    is.setVersion(QDataStream::Qt_5_0);
+    ProgSerializer ser(nullptr);
+    return ser.readSignature(is);
+}
+
+/***************************************************************************/ /**
+  * \brief Write a database for \a key holding the named \a types and the library \a signatures.
+  * \returns false if something could not be encoded or the file could not be written
+  ******************************************************************************/
+bool SignatureDb::write(const QString &path, const QByteArray &key, const QMap<QString, SharedType> &types,
+                        const QMap<QString, std::shared_ptr<Signature>> &signatures) {
+    ProgSerializer ser(nullptr);
+    QByteArray records;
+    QDataStream rs(&records, QIODevice::WriteOnly);
+    rs.setVersion(QDataStream::Qt_5_0);
+    std::vector<std::pair<quint32, quint32>> extents;
+    for (auto it = signatures.begin(); it != signatures.end(); ++it) {
+        quint32 start = quint32(records.size());
+        ser.writeSignature(rs, it.value());
+        extents.emplace_back(start, quint32(records.size()) - start);
+    }
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    QDataStream os(&file);
+    os.setVersion(QDataStream::Qt_5_0);
+    os << SIGDB_MAGIC << SIGDB_VERSION << key;
+    os << quint32(types.size());
+    for (auto it = types.begin(); it != types.end(); ++it) {
+        os << it.key();
+        ser.writeType(os, it.value());
+    }
+    os << quint32(signatures.size());
+    size_t i = 0;
+    for (auto it = signatures.begin(); it != signatures.end(); ++it, ++i)
+        os << it.key() << extents[i].first << extents[i].second;
+    os.writeRawData(records.constData(), records.size());
+    if (!ser.ok() || os.status() != QDataStream::Ok) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
+}
@@ -60,14 +60,20 @@ TableEntry::TableEntry(std::list<QString> &p, RTL &r) : rtl(r) {
   * \brief        Set the parameter list.
   * \param        p - a list of strings
   ******************************************************************************/
-void TableEntry::setParam(std::list<QString> &p) { params = p; }
+void TableEntry::setParam(std::list<QString> &p) {
+    params = p;
+    compiled = false;
+}
 
 /***************************************************************************/ /**
   * \brief        Set the RTL.
   * \param        r - a RTL
   *
   ******************************************************************************/
-void TableEntry::setRTL(RTL &r) { rtl = r; }
+void TableEntry::setRTL(RTL &r) {
+    rtl = r;
+    compiled = false;
+}
 
 /***************************************************************************/ /**
   * \brief Sets the contents of this object with a deepcopy from another TableEntry object.  Note that this is
@@ -78,6 +84,10 @@ void TableEntry::setRTL(RTL &r) { rtl = r; }
 TableEntry &TableEntry::operator=(const TableEntry &other) {
     params = other.params;
     rtl = other.rtl;
+    formals = other.formals;
+    stmtParams = other.stmtParams;
+    needsPostVars = other.needsPostVars;
+    compiled = other.compiled;
     return *this;
 }
 
@@ -95,10 +105,46 @@ int TableEntry::appendRTL(std::list<QString> &p, RTL &r) {
         ;
     if (match) {
         rtl.appendListStmt(r);
+        compiled = false;
         return 0;
     }
     return -1;
 }
+
+/***************************************************************************/ /**
+  * \brief        Build the instantiation plan for this entry.
+  *
+  * Records, for every statement of the template, which formal parameters it actually mentions, so that
+  * instantiation only searches for those, with patterns that are built once here rather than per decoded
+  * instruction. Also decides whether transformPostVars can have any effect: it only acts on assignments whose
+  * left hand side is a post-variable, and after substitution that can only happen if the template's left hand
+  * side is a post-variable or a bare parameter.
+  ******************************************************************************/
+void TableEntry::compile() {
+    formals.clear();
+    stmtParams.clear();
+    for (const QString &p : params)
+        formals.push_back(Location::param(p));
+
+    needsPostVars = false;
+    for (Instruction *s : rtl) {
+        std::vector<int> used;
+        for (size_t i = 0; i < formals.size(); i++) {
+            SharedExp found;
+            if (s->search(*formals[i], found))
+                used.push_back(i);
+        }
+        stmtParams.push_back(used);
+        if (s->isAssign()) {
+            SharedExp lhs = ((Assign *)s)->getLeft();
+            if (lhs && (lhs->isPostVar() || lhs->isParam()))
+                needsPostVars = true;
+        } else if (s->isFlagAssgn())
+            needsPostVars = true;
+    }
+    compiled = true;
+}
+
 // Appends an RTL to an idict entry, or Adds it to idict if an entry does not already exist. A non-zero return
 // indicates failure.
 /***************************************************************************/ /**
@@ -152,6 +198,7 @@ bool RTLInstDict::readSSLFile(const QString &SSLFileName) {
     theParser.yyparse(*this);
 
     fixupParams();
+    compileTemplates();
 
     if (Boomerang::get()->debugDecoder) {
         QTextStream q_cout(stdout);
@@ -299,6 +346,16 @@ void RTLInstDict::fixupParamsSub(const QString &s, std::list<QString> &funcParam
     param.funcParams = funcParams;
 }
 
+/***************************************************************************/ /**
+  * \brief         Build the instantiation plan of every dictionary entry. Called once the SSL file is parsed and
+  *                     the parameters are fixed up, so that instantiateRTL does not have to rediscover where the
+  *                     formals are for every decoded instruction.
+  ******************************************************************************/
+void RTLInstDict::compileTemplates() {
+    for (auto &elem : idict)
+        elem.second.compile();
+}
+
 /***************************************************************************/ /**
   * \brief         Returns the signature of the given instruction.
   * \param name - instruction name
@@ -365,10 +422,47 @@ std::list<Instruction *> *RTLInstDict::instantiateRTL(const QString &name, ADDRE
         return nullptr;
     }
     TableEntry &entry(dict_entry->second);
-
+    if (entry.compiled)
+        return instantiateRTL(entry, actuals);
     return instantiateRTL(entry.rtl, natPC, entry.params, actuals);
 }
 
+/***************************************************************************/ /**
+  * \brief         Instantiate a dictionary entry using its precompiled plan (see TableEntry::compile). Gives the
+  *                     same result as the generic instantiateRTL, but each statement is only searched for the
+  *                     formals it is known to contain, and the post-var pass is skipped where it cannot apply.
+  * \param   entry - a compiled dictionary entry
+  * \param   actuals - the actual parameter values
+  * \returns the instantiated list of Exps
+  ******************************************************************************/
+std::list<Instruction *> *RTLInstDict::instantiateRTL(TableEntry &entry, const std::vector<SharedExp> &actuals) {
+    assert(entry.compiled && entry.formals.size() == actuals.size());
+    assert(entry.stmtParams.size() == entry.rtl.size());
+
+    std::list<Instruction *> *newList = new std::list<Instruction *>();
+    auto slots = entry.stmtParams.begin();
+    for (Instruction *tmpl : entry.rtl) {
+        Instruction *ss = tmpl->clone();
+        for (int idx : *slots++)
+            ss->searchAndReplace(*entry.formals[idx], actuals[idx]);
+        ss->fixSuccessor();
+        if (Boomerang::get()->debugDecoder) {
+            QTextStream q_cout(stdout);
+            q_cout << "            " << ss << "\n";
+        }
+        newList->push_back(ss);
+    }
+
+    if (entry.needsPostVars)
+        transformPostVars(*newList, true);
+
+    // Perform simplifications, e.g. *1 in Pentium addressing modes
+    for (Instruction *s : *newList)
+        s->simplify();
+
+    return newList;
+}
+
 /***************************************************************************/ /**
   * \brief         Returns an instance of a register transfer list for the parameterized rtlist with the given formals
   *      replaced with the actuals given as the third parameter.
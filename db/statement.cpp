@@ -265,7 +265,7 @@ bool Instruction::canPropagateToExp(Exp &e) {
     return true;
 }
 
-static int propagate_progress = 0;
+static thread_local int propagate_progress = 0;
 /***************************************************************************/ /**
   * \brief Propagate to this statement
   * \param destCounts is a map that indicates how may times a statement's definition is used
@@ -3807,12 +3807,14 @@ bool BoolAssign::accept(StmtPartModifier * v) {
 
 //! Fix references to the returns of call statements
 //! Bypass calls for references in this statement
-void Instruction::bypass() {
+//! \returns true if anything was bypassed
+bool Instruction::bypass() {
     CallBypasser cb(this);
     StmtPartModifier sm(&cb); // Use the Part modifier so we don't change the top level of LHS of assigns etc
     accept(&sm);
     if (cb.isTopChanged())
         simplify(); // E.g. m[esp{20}] := blah -> m[esp{-}-20+4] := blah
+    return cb.isMod();
 }
 
 //! Find the locations used by expressions in this Statement.
@@ -4065,6 +4067,17 @@ bool lessAssign::operator()(const Assign *x, const Assign *y) const {
     return (*xx->getLeft() < *yy->getLeft()); // Compare the LHS expressions
 }
 
+//! True if \a a and \a b (lists of Assignments) assign the same locations in the same order
+static bool sameLocations(const StatementList &a, const StatementList &b) {
+    if (a.size() != b.size())
+        return false;
+    for (auto ia = a.begin(), ib = b.begin(); ia != a.end(); ++ia, ++ib) {
+        if (*ia != *ib && !(*((Assignment *)*ia)->getLeft() == *((Assignment *)*ib)->getLeft()))
+            return false;
+    }
+    return true;
+}
+
 // Update the modifieds, in case the signature and hence ordering and filtering has changed, or the locations in the
 // collector have changed. Does NOT remove preserveds (deferred until updating returns).
 void ReturnStatement::updateModifieds() {
@@ -4203,8 +4216,8 @@ void ReturnStatement::updateReturns() {
 }
 
 // Set the defines to the set of locations modified by the callee, or if no callee, to all variables live at this
-// call
-void CallStatement::updateDefines() {
+// call. Returns true if the locations defined changed
+bool CallStatement::updateDefines() {
     std::shared_ptr<Signature> sig;
     if (procDest)
         // The signature knows how to order the returns
@@ -4212,14 +4225,15 @@ void CallStatement::updateDefines() {
     else
         // Else just use the enclosing proc's signature
         sig = proc->getSignature();
+    StatementList before(defines);
 
     if (procDest && procDest->isLib()) {
         sig->setLibraryDefines(&defines); // Set the locations defined
-        return;
+        return !sameLocations(before, defines);
     } else if (Boomerang::get()->assumeABI) {
         // Risky: just assume the ABI caller save registers are defined
         Signature::setABIdefines(proc->getProg(), &defines);
-        return;
+        return !sameLocations(before, defines);
     }
 
     // Move the defines to a temporary list
@@ -4282,6 +4296,7 @@ void CallStatement::updateDefines() {
         if (!inserted)
             defines.push_back(as); // In case larger than all existing elements
     }
+    return !sameLocations(before, defines);
 }
 
 // A helper class for updateArguments. It just dishes out a new argument from one of the three sources: the
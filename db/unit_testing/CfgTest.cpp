@@ -10,6 +10,7 @@
 #include "frontend.h"
 #include "proc.h"
 #include "prog.h"
+#include "module.h"
 #include "dataflow.h"
 #include "pentiumfrontend.h"
 #include "log.h"
@@ -18,11 +19,16 @@
 
 #include <QDir>
 #include <QProcessEnvironment>
+#include <QTemporaryDir>
 #include <QDebug>
+#include <algorithm>
+#include <map>
+#include <set>
 
 #define FRONTIER_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/frontier")
 #define SEMI_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/semi")
 #define IFTHEN_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/ifthen")
+#define FROMSSA2_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/fromssa2")
 static bool logset = false;
 static QString TEST_BASE;
 static QDir baseDir;
@@ -313,4 +319,131 @@ void CfgTest::testRenameVars() {
 
     delete pFE;
 }
+
+namespace {
+typedef std::set<std::pair<QString, QString>> Pairs;
+
+QString text(const SharedExp &e) {
+    QString res;
+    QTextStream os(&res);
+    e->print(os);
+    return res;
+}
+
+//! Connect \a u to the names of the same base as \a u in \a live, once per pair, then make \a u live
+void overlap(LocationSet &live, const SharedExp &u, ConnectionGraph &cg, Pairs &seen) {
+    if (!u->isSubscript())
+        return;
+    for (const SharedExp &e : live) {
+        if (!e->isSubscript() || !(*e->getSubExp1() == *u->getSubExp1()) || *e == *u)
+            continue;
+        QString a = text(u), b = text(e);
+        if (seen.insert(a < b ? std::make_pair(a, b) : std::make_pair(b, a)).second)
+            cg.connect(u, e);
+    }
+    live.insert(u);
+}
+
+//! The liveness of \a bb from \a live, the locations live at its end; interferences go to \a cg if not null
+void liveness(BasicBlock *bb, LocationSet &live, LocationSet &phiLocs, ConnectionGraph *cg, Pairs &seen) {
+    ConnectionGraph ignored;
+    ConnectionGraph &ig = cg ? *cg : ignored;
+    for (SharedExp p : phiLocs)
+        overlap(live, p, ig, seen);
+    if (bb->getRTLs() == nullptr)
+        return;
+    for (auto rit = bb->getRTLs()->rbegin(); rit != bb->getRTLs()->rend(); ++rit) {
+        for (auto sit = (*rit)->rbegin(); sit != (*rit)->rend(); ++sit) {
+            Instruction *s = *sit;
+            LocationSet defs;
+            s->getDefinitions(defs);
+            defs.addSubscript(s);
+            live.makeDiff(defs);
+            if (s->isPhi())
+                continue;
+            LocationSet uses;
+            s->addUsedLocs(uses);
+            for (SharedExp u : uses)
+                overlap(live, u, ig, seen);
+        }
+    }
+}
+
+/// The interferences as the LocationSet based liveness (BasicBlock::calcLiveness) found them, run to a fixed point
+/// first, then once more in the order Cfg::findInterferences records them in
+void locationSetInterferences(Cfg *cfg, ConnectionGraph &cg) {
+    std::vector<BasicBlock *> bbs;
+    BB_IT it;
+    for (BasicBlock *bb = cfg->getFirstBB(it); bb; bb = cfg->getNextBB(it))
+        bbs.push_back(bb);
+    std::map<BasicBlock *, LocationSet> liveIn;
+    Pairs seen;
+    auto liveOut = [&liveIn](BasicBlock *bb, LocationSet &live, LocationSet &phiLocs) {
+        for (BasicBlock *succ : bb->getOutEdges())
+            live.makeUnion(liveIn[succ]);
+        bb->getPhiLiveOut(phiLocs);
+        live.makeUnion(phiLocs);
+    };
+    bool change = true;
+    while (change) {
+        change = false;
+        for (auto bb = bbs.rbegin(); bb != bbs.rend(); ++bb) {
+            LocationSet live, phiLocs;
+            liveOut(*bb, live, phiLocs);
+            liveness(*bb, live, phiLocs, nullptr, seen);
+            if (!(live == liveIn[*bb])) {
+                liveIn[*bb] = live;
+                change = true;
+            }
+        }
+    }
+    seen.clear();
+    for (auto bb = bbs.rbegin(); bb != bbs.rend(); ++bb) {
+        LocationSet live, phiLocs;
+        liveOut(*bb, live, phiLocs);
+        liveness(*bb, live, phiLocs, &cg, seen);
+    }
+}
+
+//! The edges of \a cg, printed
+std::vector<QString> edges(ConnectionGraph &cg) {
+    std::vector<QString> res;
+    for (auto &e : cg)
+        res.push_back(text(e.first) + " -> " + text(e.second));
+    std::sort(res.begin(), res.end());
+    return res;
+}
+}
+
+/***************************************************************************/ /**
+  * \fn        CfgTest::testInterferences
+  * OVERVIEW:        The bit set liveness of Cfg::findInterferences builds the same interference graph as the
+  *                  LocationSet based liveness it replaced, on the procedures of fromssa2 in SSA form
+  ******************************************************************************/
+void CfgTest::testInterferences() {
+    QTemporaryDir outDir;
+    Boomerang::get()->setOutputPath(outDir.path() + "/");
+    Prog *prog = Boomerang::get()->loadAndDecode(FROMSSA2_PENTIUM);
+    QVERIFY(prog != nullptr);
+    int compared = 0;
+    for (Module *module : *prog) {
+        for (Function *f : *module) {
+            if (f->isLib())
+                continue;
+            UserProc *proc = (UserProc *)f;
+            if (!proc->isDecompiled()) {
+                ProcList path;
+                int indent = 0;
+                proc->decompile(&path, indent);
+            }
+            ConnectionGraph bits, sets;
+            proc->getCFG()->findInterferences(bits);
+            locationSetInterferences(proc->getCFG(), sets);
+            QCOMPARE(edges(bits), edges(sets));
+            ++compared;
+        }
+    }
+    QVERIFY(compared > 0);
+    delete prog;
+}
 QTEST_MAIN(CfgTest)
@@ -0,0 +1,159 @@
+/***************************************************************************/ /**
+  * \file       DecompileCacheTest.cpp
+  * OVERVIEW:   Provides the implementation for the DecompileCacheTest class, which
+  *                tests the persistent decompile cache (--cache)
+  ******************************************************************************/
+
+#include "DecompileCacheTest.h"
+
+#include "decompilecache.h"
+#include "boomerang.h"
+#include "log.h"
+#include "prog.h"
+#include "proc.h"
+#include "module.h"
+#include "statement.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDebug>
+
+#define TWOPROC_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/twoproc")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+static QTemporaryDir *outDir;
+
+void DecompileCacheTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+        outDir = new QTemporaryDir();
+        Boomerang::get()->setOutputPath(outDir->path() + "/");
+    }
+}
+
+//! Decompile twoproc with the cache in \a cacheDir, and read back the code generated for it into \a code.
+//! If \a rename is given, proc1 is renamed to it first
+Prog *DecompileCacheTest::decompile(const QString &cacheDir, QString &code, const QString &rename) {
+    Boomerang::get()->cacheDir = cacheDir;
+    Prog *prog = Boomerang::get()->loadAndDecode(TWOPROC_PENTIUM);
+    if (prog == nullptr)
+        return nullptr;
+    if (!rename.isEmpty()) {
+        Function *proc1 = prog->findProc("proc1");
+        if (proc1)
+            proc1->setName(rename);
+    }
+    prog->decompile();
+    prog->generateCode(); // Also stores the new entries
+    QFile file(prog->getRootCluster()->getOutPath("c"));
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+        return prog;
+    code = QString::fromUtf8(file.readAll());
+    return prog;
+}
+
+/***************************************************************************/ /**
+  * \fn        DecompileCacheTest::testWarmRun
+  * OVERVIEW:        A second run over the same program restores every procedure, and generates the same code
+  ******************************************************************************/
+void DecompileCacheTest::testWarmRun() {
+    QTemporaryDir cacheDir;
+    QString cold, warm;
+    Prog *prog = decompile(cacheDir.path(), cold);
+    QVERIFY(prog != nullptr);
+    QCOMPARE(prog->getDecompileCache()->hits, 0);
+    QVERIFY(prog->getDecompileCache()->misses > 0);
+    int stored = prog->getDecompileCache()->stored;
+    QVERIFY(stored > 0);
+    QVERIFY(!cold.isEmpty());
+    delete prog;
+
+    prog = decompile(cacheDir.path(), warm);
+    QVERIFY(prog != nullptr);
+    DecompileCache *cache = prog->getDecompileCache();
+    QCOMPARE(cache->hits, stored);
+    QCOMPARE(cache->stale, 0);
+    for (Module *module : *prog) {
+        for (Function *f : *module) {
+            if (!f->isLib())
+                QVERIFY(cache->isCached((UserProc *)f));
+        }
+    }
+    QCOMPARE(warm, cold);
+    delete prog;
+    Boomerang::get()->cacheDir.clear();
+}
+
+/***************************************************************************/ /**
+  * \fn        DecompileCacheTest::testStaleEntry
+  * OVERVIEW:        A restored procedure whose callers now need other returns is decompiled after all, and gets back
+  *                  its own statements
+  ******************************************************************************/
+void DecompileCacheTest::testStaleEntry() {
+    QTemporaryDir cacheDir;
+    QString cold, warm;
+    Prog *prog = decompile(cacheDir.path(), cold);
+    QVERIFY(prog != nullptr);
+    delete prog;
+
+    prog = decompile(cacheDir.path(), warm);
+    QVERIFY(prog != nullptr);
+    DecompileCache *cache = prog->getDecompileCache();
+    QVERIFY(!cache->cached.empty());
+    // Pretend that the entry was stored with other final returns
+    UserProc *proc = cache->cached.begin()->first;
+    cache->cached.begin()->second.entry.finalReturns = QByteArray("stale");
+    cache->revalidate();
+    QVERIFY(!cache->isCached(proc));
+    QVERIFY(cache->late.count(proc) != 0);
+    QCOMPARE(cache->stale, 1);
+    QVERIFY(proc->isDecompiled());
+    // Stale procedures are never looked up again
+    QVERIFY(!cache->restore(proc));
+    for (auto &c : cache->cached) {
+        QVERIFY(c.second.oldParameters.empty());
+        QVERIFY(c.second.oldReturns.empty());
+        QVERIFY(c.second.oldModifieds.empty());
+    }
+    delete prog;
+    Boomerang::get()->cacheDir.clear();
+}
+
+/***************************************************************************/ /**
+  * \fn        DecompileCacheTest::testRenamedProc
+  * OVERVIEW:        The key does not depend on the name of a procedure: a renamed procedure is restored, with its
+  *                  code renamed, while its caller (whose code names it) misses
+  ******************************************************************************/
+void DecompileCacheTest::testRenamedProc() {
+    QTemporaryDir cacheDir;
+    QString cold, warm;
+    Prog *prog = decompile(cacheDir.path(), cold);
+    QVERIFY(prog != nullptr);
+    delete prog;
+
+    prog = decompile(cacheDir.path(), warm, "sub1");
+    QVERIFY(prog != nullptr);
+    DecompileCache *cache = prog->getDecompileCache();
+    Function *sub1 = prog->findProc("sub1");
+    QVERIFY(sub1 != nullptr);
+    QVERIFY(cache->isCached((UserProc *)sub1));
+    QVERIFY(!cache->isCached((UserProc *)prog->findProc("main")));
+    QVERIFY(!warm.contains("proc1"));
+    QCOMPARE(warm, QString(cold).replace("proc1", "sub1"));
+    delete prog;
+    Boomerang::get()->cacheDir.clear();
+}
+QTEST_MAIN(DecompileCacheTest)
@@ -0,0 +1,14 @@
+#include <QtTest/QTest>
+
+class Prog;
+class DecompileCacheTest : public QObject {
+    Q_OBJECT
+  private:
+    Prog *decompile(const QString &cacheDir, QString &code, const QString &rename = QString());
+
+  private slots:
+    void initTestCase();
+    void testWarmRun();
+    void testStaleEntry();
+    void testRenamedProc();
+};
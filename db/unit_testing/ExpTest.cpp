@@ -207,6 +207,21 @@ void ExpTest::testCompare6() {
     Binary two(opMult, m_99->clone(), m_rof2->clone());
     CPPUNIT_ASSERT((one == two));
 }
+void ExpTest::testCompareConst() {
+    // 64 bit and function constants compare by value, and hash the same when equal
+    Const l1((QWord)1), l2((QWord)2), l1b((QWord)1);
+    CPPUNIT_ASSERT(l1 < l2);
+    CPPUNIT_ASSERT(!(l2 < l1));
+    CPPUNIT_ASSERT(!(l1 == l2));
+    CPPUNIT_ASSERT(l1 == l1b && !(l1 < l1b) && !(l1b < l1));
+    CPPUNIT_ASSERT(l1.hash() == l1b.hash());
+    char procs[2];
+    Const f1((Function *)&procs[0]), f2((Function *)&procs[1]), f1b((Function *)&procs[0]);
+    CPPUNIT_ASSERT((f1 < f2) != (f2 < f1));
+    CPPUNIT_ASSERT(!(f1 == f2));
+    CPPUNIT_ASSERT(f1 == f1b && !(f1 < f1b) && !(f1b < f1));
+    CPPUNIT_ASSERT(f1.hash() == f1b.hash());
+}
 
 /***************************************************************************/ /**
   * FUNCTION:        ExpTest::testSearchReplace1-4
@@ -620,6 +635,35 @@ void ExpTest::testSimplifyBinary() {
     delete e;
 }
 
+/***************************************************************************/ /**
+  * FUNCTION:        ExpTest::testSimplifyConstSum
+  * OVERVIEW:        Test simplifying (x + a) + b, where the constants are folded in place
+  *============================================================================*/
+void ExpTest::testSimplifyConstSum() {
+    // (r2 + 4) + -8
+    Exp *b = new Binary(opPlus, new Binary(opPlus, m_rof2->clone(), new Const(4)), new Const(-8));
+    b = b->simplify();
+    // r2 - 4
+    Binary expb1(opMinus, m_rof2->clone(), new Const(4));
+    CPPUNIT_ASSERT(*b == expb1);
+    delete b;
+
+    // (r2 + 4) + -4
+    b = new Binary(opPlus, new Binary(opPlus, m_rof2->clone(), new Const(4)), new Const(-4));
+    b = b->simplify();
+    CPPUNIT_ASSERT(*b == *m_rof2);
+    delete b;
+
+    // m[(r2 + 4) + -8]
+    b = Location::memOf(new Binary(opPlus, new Binary(opPlus, m_rof2->clone(), new Const(4)), new Const(-8)));
+    b = b->simplify();
+    std::string expected("m[r2 - 4]");
+    std::ostringstream ost;
+    b->print(ost);
+    CPPUNIT_ASSERT_EQUAL(expected, ost.str());
+    delete b;
+}
+
 /***************************************************************************/ /**
   * FUNCTION:        ExpTest::testSimplifyBinary
   * OVERVIEW:        Test the simplifyArith function
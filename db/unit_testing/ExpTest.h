@@ -16,6 +16,7 @@ class ExpTest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST(testCompare4);
     CPPUNIT_TEST(testCompare5);
     CPPUNIT_TEST(testCompare6);
+    CPPUNIT_TEST(testCompareConst);
     CPPUNIT_TEST(testSearchReplace1);
     CPPUNIT_TEST(testSearchReplace2);
     CPPUNIT_TEST(testSearchReplace3);
@@ -29,6 +30,7 @@ class ExpTest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST(testSimplifyArith);
     CPPUNIT_TEST(testSimplifyUnary);
     CPPUNIT_TEST(testSimplifyBinary);
+    CPPUNIT_TEST(testSimplifyConstSum);
     CPPUNIT_TEST(testSimplifyAddr);
     CPPUNIT_TEST(testSimpConstr);
     CPPUNIT_TEST(testLess);
@@ -70,6 +72,7 @@ class ExpTest : public CPPUNIT_NS::TestFixture {
     void testCompare4();
     void testCompare5();
     void testCompare6();
+    void testCompareConst();
 
     void testSearchReplace1();
     void testSearchReplace2();
@@ -86,6 +89,7 @@ class ExpTest : public CPPUNIT_NS::TestFixture {
     void testSimplifyArith();
     void testSimplifyUnary();
     void testSimplifyBinary();
+    void testSimplifyConstSum();
     void testSimplifyAddr();
     void testSimpConstr();
 
@@ -0,0 +1,107 @@
+/***************************************************************************/ /**
+  * \file       ProjectTest.cpp
+  * OVERVIEW:   Provides the implementation for the ProjectTest class, which
+  *                tests saving and loading projects (-SD and -LD)
+  ******************************************************************************/
+
+#include "ProjectTest.h"
+
+#include "project.h"
+#include "boomerang.h"
+#include "log.h"
+#include "prog.h"
+#include "proc.h"
+#include "statement.h"
+#include "exp.h"
+
+#include <QtCore/QBuffer>
+#include <QtCore/QDir>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QDebug>
+
+#define FIB_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/fib")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+
+void ProjectTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+    }
+}
+
+/***************************************************************************/ /**
+  * \fn        ProjectTest::testRoundTrip
+  * OVERVIEW:        A saved and loaded program prints as the original, and its subscripts keep their definitions
+  ******************************************************************************/
+void ProjectTest::testRoundTrip() {
+    Prog *prog = Boomerang::get()->loadAndDecode(FIB_PENTIUM);
+    QVERIFY(prog != nullptr);
+    UserProc *main = dynamic_cast<UserProc *>(prog->findProc("main"));
+    QVERIFY(main != nullptr);
+    // Make a subscript with a real definition: the first assignment, used by the last one
+    StatementList stmts;
+    main->getStatements(stmts);
+    Assign *first = nullptr, *last = nullptr;
+    int firstPos = -1, lastPos = -1, pos = 0;
+    for (Instruction *s : stmts) {
+        if (s->isAssign()) {
+            if (first == nullptr) {
+                first = (Assign *)s;
+                firstPos = pos;
+            }
+            last = (Assign *)s;
+            lastPos = pos;
+        }
+        ++pos;
+    }
+    QVERIFY(first != nullptr && last != first);
+    last->setRight(Binary::get(opPlus, last->getRight(), RefExp::get(first->getLeft()->clone(), first)));
+
+    QString expected;
+    QTextStream ost(&expected);
+    prog->print(ost);
+    ost.flush();
+
+    QBuffer buf;
+    QVERIFY(buf.open(QIODevice::ReadWrite));
+    Project saved;
+    saved.setProg(prog);
+    QVERIFY(saved.serializeTo(buf));
+    buf.seek(0);
+    Project loaded;
+    QVERIFY(loaded.serializeFrom(buf));
+    QVERIFY(loaded.prog() != nullptr);
+
+    QString actual;
+    QTextStream ost2(&actual);
+    loaded.prog()->print(ost2);
+    ost2.flush();
+    QCOMPARE(actual, expected);
+
+    UserProc *loadedMain = dynamic_cast<UserProc *>(loaded.prog()->findProc("main"));
+    QVERIFY(loadedMain != nullptr);
+    StatementList loadedStmts;
+    loadedMain->getStatements(loadedStmts);
+    QCOMPARE(loadedStmts.size(), stmts.size());
+    auto defIt = loadedStmts.begin(), useIt = loadedStmts.begin();
+    std::advance(defIt, firstPos);
+    std::advance(useIt, lastPos);
+    QVERIFY((*useIt)->isAssign());
+    SharedExp rhs = ((Assign *)*useIt)->getRight();
+    QVERIFY(rhs->getOper() == opPlus && rhs->getSubExp2()->isSubscript());
+    QVERIFY(rhs->access<RefExp, 2>()->getDef() == *defIt);
+    delete loaded.prog();
+    delete prog;
+}
+QTEST_MAIN(ProjectTest)
@@ -0,0 +1,8 @@
+#include <QtTest/QTest>
+
+class ProjectTest : public QObject {
+    Q_OBJECT
+  private slots:
+    void initTestCase();
+    void testRoundTrip();
+};
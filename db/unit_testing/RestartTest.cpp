@@ -0,0 +1,102 @@
+/***************************************************************************/ /**
+  * \file       RestartTest.cpp
+  * OVERVIEW:   Provides the implementation for the RestartTest class, which
+  *                tests restarting the decompilation of a procedure after a switch is analysed
+  ******************************************************************************/
+
+#include "RestartTest.h"
+
+#include "boomerang.h"
+#include "log.h"
+#include "prog.h"
+#include "proc.h"
+#include "module.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTemporaryDir>
+#include <QtCore/QDebug>
+
+#define SWITCH_PENTIUM baseDir.absoluteFilePath("tests/inputs/pentium/switch_gcc")
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+static QTemporaryDir *outDir;
+
+namespace {
+//! Counts the restarts, and makes them decode again from scratch unless keepDecoded is set
+class RestartWatcher : public Watcher {
+public:
+    bool keepDecoded = true;
+    int restarts = 0;
+    void alertDecompileDebugPoint(UserProc *p, const char *description) override {
+        if (!QString(description).startsWith("before restarting decompilation"))
+            return;
+        ++restarts;
+        if (!keepDecoded)
+            p->clearMemos(); // So restoreDecoded() finds nothing, and the procedure is decoded again
+    }
+};
+RestartWatcher *watcher;
+}
+
+void RestartTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+        outDir = new QTemporaryDir();
+        Boomerang::get()->setOutputPath(outDir->path() + "/");
+        watcher = new RestartWatcher;
+        Boomerang::get()->addWatcher(watcher);
+    }
+}
+
+//! Decompile switch_gcc, going back to the CFG as decoded on a restart if \a keepDecoded, and read back the code
+Prog *RestartTest::decompile(bool keepDecoded, int &restarts, QString &code) {
+    watcher->keepDecoded = keepDecoded;
+    watcher->restarts = 0;
+    Prog *prog = Boomerang::get()->loadAndDecode(SWITCH_PENTIUM);
+    if (prog == nullptr)
+        return nullptr;
+    prog->decompile();
+    prog->generateCode();
+    restarts = watcher->restarts;
+    QFile file(prog->getRootCluster()->getOutPath("c"));
+    if (!file.open(QFile::ReadOnly | QFile::Text))
+        return prog;
+    code = QString::fromUtf8(file.readAll());
+    return prog;
+}
+
+/***************************************************************************/ /**
+  * \fn        RestartTest::testRestoreMatchesReDecode
+  * OVERVIEW:        Going back to the CFG as decoded (restoreDecoded, Cfg::copyBBs) when the switch is analysed gives
+  *                  the same code as decoding the procedure again
+  ******************************************************************************/
+void RestartTest::testRestoreMatchesReDecode() {
+    QString restored, reDecoded;
+    int restarts = 0;
+    Prog *prog = decompile(true, restarts, restored);
+    QVERIFY(prog != nullptr);
+    QVERIFY(restarts > 0);
+    QVERIFY(!restored.isEmpty());
+    delete prog;
+
+    prog = decompile(false, restarts, reDecoded);
+    QVERIFY(prog != nullptr);
+    QVERIFY(restarts > 0);
+    QCOMPARE(restored, reDecoded);
+    delete prog;
+}
+
+QTEST_MAIN(RestartTest)
@@ -0,0 +1,12 @@
+#include <QtTest/QTest>
+
+class Prog;
+class RestartTest : public QObject {
+    Q_OBJECT
+  private:
+    Prog *decompile(bool keepDecoded, int &restarts, QString &code);
+
+  private slots:
+    void initTestCase();
+    void testRestoreMatchesReDecode();
+};
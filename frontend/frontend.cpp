@@ -38,9 +38,15 @@
 #include "ansi-c-parser.h"
 #include "IBinaryImage.h"
 #include "db/SymTab.h"
+#include "decompilecache.h"
 
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
 #include <QtCore/QDir>
 #include <QtCore/QDebug>
+#include <QtCore/QFileInfo>
+#include <QtCore/QStandardPaths>
 #include <cassert>
 #include <cstring>
 #include <cstdlib>
@@ -122,6 +128,7 @@ void FrontEnd::AddSymbol(ADDRESS addr, const QString &nam) {
 }
 // destructor
 FrontEnd::~FrontEnd() {
+    clearDecodeCache();
     if (pbff)
         pbff->UnLoad(); // Unload the BinaryFile library with dlclose() or FreeLibrary()
     ldrIface = nullptr;
@@ -142,15 +149,16 @@ bool FrontEnd::noReturnCallDest(const QString &name) {
             (name == "_assert"));
 }
 
-void FrontEnd::readLibraryCatalog(const QString &sPath) {
+/// \returns the headers listed in the catalog \a sPath, with the calling convention each assumes
+QList<QPair<QString, callconv>> FrontEnd::catalogHeaders(const QString &sPath) {
     // TODO: this is a work for generic semantics provider plugin : HeaderReader
+    QList<QPair<QString, callconv>> headers;
     QFile file(sPath);
     if (!file.open(QFile::ReadOnly|QFile::Text)) {
         qCritical() << "can't open `" << sPath << "'\n";
         exit(1); //TODO: this should not exit, just inform the caller about the problem
     }
     QTextStream inf(&file);
-    QString sig_path;
     while (!inf.atEnd()) {
         QString sFile;
         inf >> sFile;
@@ -159,37 +167,97 @@ void FrontEnd::readLibraryCatalog(const QString &sPath) {
             sFile = sFile.mid(0, sFile.size() - 1);
         if (sFile.isEmpty())
             continue;
-        sig_path = Boomerang::get()->getProgPath() + "signatures/" + sFile;
         callconv cc = CONV_C; // Most APIs are C calling convention
         if (sFile == "windows.h")
             cc = CONV_PASCAL; // One exception
         if (sFile == "mfc.h")
             cc = CONV_THISCALL; // Another exception
-        readLibrarySignatures(qPrintable(sig_path), cc);
+        headers.append(qMakePair(Boomerang::get()->getProgPath() + "signatures/" + sFile, cc));
     }
+    return headers;
+}
+
+void FrontEnd::readLibraryCatalog(const QString &sPath) {
+    for (const QPair<QString, callconv> &header : catalogHeaders(sPath))
+        readLibrarySignatures(qPrintable(header.first), header.second);
 }
 
+/***************************************************************************/ /**
+  * \brief Read the default catalogs for this binary: common.hs, the one for the platform, and win32.hs or objc.hs
+  * where they apply.
+  *
+  * Parsing the headers they list takes longer than many decompilations, so the result is compiled into a SignatureDb
+  * the first time, and later runs with the same catalogs and headers open that instead. The named types are
+  * defined at once; LibrarySignatures is left empty, and getLibSignature reads each signature from the database
+  * when it is first asked for.
+  ******************************************************************************/
 void FrontEnd::readLibraryCatalog() {
-    // TODO: this is a work for generic semantics provider plugin : HeaderReader
     LibrarySignatures.clear();
+    LibrarySignatureDb.close();
     QDir sig_dir(Boomerang::get()->getProgPath());
     if(!sig_dir.cd("signatures")) {
         qWarning("Signatures directory does not exist.");
         return;
     }
-    QString sList = sig_dir.absoluteFilePath("common.hs");
-
-    readLibraryCatalog(sList);
-    sList = sig_dir.absoluteFilePath(Signature::platformName(getFrontEndId()) + ".hs");
-    readLibraryCatalog(sList);
-    if (isWin32()) {
-        sList = sig_dir.absoluteFilePath("win32.hs");
-        readLibraryCatalog(sList);
-    }
+    QStringList catalogs;
+    catalogs << "common.hs" << Signature::platformName(getFrontEndId()) + ".hs";
+    if (isWin32())
+        catalogs << "win32.hs";
     // TODO: change this to BinaryLayer query ("FILE_FORMAT","MACHO")
-    if (ldrIface->GetFormat() == LOADFMT_MACHO) {
-        sList = sig_dir.absoluteFilePath("objc.hs");
-        readLibraryCatalog(sList);
+    if (ldrIface->GetFormat() == LOADFMT_MACHO)
+        catalogs << "objc.hs";
+
+    // The key covers everything the parse depends on: the platform, the catalogs, and each header it reads
+    QList<QPair<QString, callconv>> headers;
+    QByteArray keyData;
+    QDataStream key(&keyData, QIODevice::WriteOnly);
+    key << qint32(getFrontEndId());
+    for (const QString &catalog : catalogs) {
+        QString path = sig_dir.absoluteFilePath(catalog);
+        QFile file(path);
+        if (file.open(QFile::ReadOnly))
+            key << path << file.readAll();
+        headers.append(catalogHeaders(path));
+    }
+    for (const QPair<QString, callconv> &header : headers) {
+        QFileInfo info(header.first);
+        key << header.first << info.size() << info.lastModified().toMSecsSinceEpoch() << qint32(header.second);
+    }
+    QByteArray digest = QCryptographicHash::hash(keyData, QCryptographicHash::Sha1);
+
+    QString dbName = catalogs.join('-').remove(".hs") + ".sigdb";
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    QStringList dbPaths;
+    dbPaths << sig_dir.absoluteFilePath(dbName);
+    if (!cacheDir.isEmpty())
+        dbPaths << QDir(cacheDir).filePath(dbName);
+
+    QMap<QString, SharedType> types;
+    for (const QString &path : dbPaths) {
+        if (!LibrarySignatureDb.open(path, digest, types))
+            continue;
+        LOG_VERBOSE(1) << "reading library signatures from " << path << "\n";
+        for (auto it = types.begin(); it != types.end(); ++it)
+            Type::addNamedType(it.key(), it.value());
+        return;
+    }
+
+    // Parse with no other named types, so that the database holds exactly what the headers define
+    QMap<QString, SharedType> saved = Type::getNamedTypes();
+    Type::clearNamedTypes();
+    for (const QPair<QString, callconv> &header : headers)
+        readLibrarySignatures(qPrintable(header.first), header.second);
+    types = Type::getNamedTypes();
+    Type::setNamedTypes(saved);
+    for (auto it = types.begin(); it != types.end(); ++it)
+        Type::addNamedType(it.key(), it.value());
+
+    for (const QString &path : dbPaths) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        if (SignatureDb::write(path, digest, types, LibrarySignatures)) {
+            LOG_VERBOSE(1) << "wrote library signature database " << path << "\n";
+            break;
+        }
     }
 }
 
@@ -296,7 +364,7 @@ void FrontEnd::decode(Prog *prg, bool decodeMain, const char *pname) {
             LOG << "unable to find signature for known entrypoint " << name << "\n";
         else {
             proc->setSignature(fty->getSignature()->clone());
-            proc->getSignature()->setName(name);
+            proc->setName(name);
             // proc->getSignature()->setFullSig(true);        // Don't add or remove parameters
             proc->getSignature()->setForced(true); // Don't add or remove parameters
         }
@@ -372,6 +440,18 @@ void FrontEnd::decodeFragment(UserProc *proc, ADDRESS a) {
     processProc(a, proc, os, true);
 }
 
+//! Clone a decoded RTL, keeping the call flags that CallStatement::clone leaves out (but not the callee)
+static RTL *cloneDecoded(RTL *rtl) {
+    RTL *res = rtl->clone();
+    auto ss = res->begin();
+    for (Instruction *s : *rtl) {
+        if (s->isCall())
+            ((CallStatement *)*ss)->setReturnAfterCall(((CallStatement *)s)->isReturnAfterCall());
+        ++ss;
+    }
+    return res;
+}
+
 DecodeResult &FrontEnd::decodeInstruction(ADDRESS pc) {
     if (!Image || Image->getSectionInfoByAddr(pc) == nullptr) {
         LOG << "ERROR: attempted to decode outside any known section " << pc << "\n";
@@ -380,9 +460,45 @@ DecodeResult &FrontEnd::decodeInstruction(ADDRESS pc) {
         invalid.valid = false;
         return invalid;
     }
+    auto cc = decodeCache.find(pc);
+    if (cc != decodeCache.end() && !cc->second.reDecode) {
+        const DecodeResult &found(cc->second);
+        cachedResult = found;
+        if (found.rtl) {
+            cachedResult.rtl = cloneDecoded(found.rtl);
+            // Redo what the decoder does for a call, as the callee may have been replaced since
+            for (Instruction *s : *cachedResult.rtl) {
+                if (!s->isCall() || ((CallStatement *)s)->getFixedDest() == NO_ADDRESS)
+                    continue;
+                Function *destProc = Program->setNewProc(((CallStatement *)s)->getFixedDest());
+                if (destProc != nullptr && destProc != (Function *)-1) // -1 for a deleted Proc
+                    ((CallStatement *)s)->setDestProc(destProc);
+            }
+        }
+        DecompileCache::noteRead(pc, cachedResult.numBytes);
+        return cachedResult;
+    }
     const IBinarySection *pSect = Image->getSectionInfoByAddr(pc);
     ptrdiff_t host_native_diff = (pSect->hostAddr() - pSect->sourceAddr()).m_value;
-    return decoder->decodeInstruction(pc, host_native_diff);
+    DecodeResult &inst = decoder->decodeInstruction(pc, host_native_diff);
+    DecompileCache::noteRead(pc, inst.numBytes);
+    if (inst.valid && cc == decodeCache.end()) {
+        DecodeResult &entry(decodeCache[pc]);
+        entry = inst;
+        if (inst.rtl && !inst.reDecode) {
+            Arena::Scope heap(nullptr); // The template outlives the procedure being decoded
+            entry.rtl = cloneDecoded(inst.rtl);
+        } else
+            entry.rtl = nullptr;
+    }
+    return inst;
+}
+
+/// Forget the instructions decoded so far; they are only decoded again while procedures are being decompiled
+void FrontEnd::clearDecodeCache() {
+    for (auto &dd : decodeCache)
+        delete dd.second.rtl;
+    decodeCache.clear();
 }
 
 /***************************************************************************/ /**
@@ -412,6 +528,7 @@ void FrontEnd::readLibrarySignatures(const char *sPath, callconv cc) {
 #endif
         LibrarySignatures[(elem)->getName()] = elem;
         (elem)->setSigFile(sPath);
+        (elem)->setUnknown(false);
     }
 
     delete p;
@@ -428,15 +545,24 @@ std::shared_ptr<Signature> FrontEnd::getDefaultSignature(const QString &name) {
 // get a library signature by name
 std::shared_ptr<Signature> FrontEnd::getLibSignature(const QString &name) {
     std::shared_ptr<Signature> signature;
+    // Kept for the whole run, so made on the heap even while decompiling a procedure in an arena
+    Arena::Scope heap(nullptr);
     // Look up the name in the librarySignatures map
+    QMutexLocker guard(&LibrarySignatureLock);
     auto it = LibrarySignatures.find(name);
+    if (it == LibrarySignatures.end() && LibrarySignatureDb.isOpen()) {
+        if (std::shared_ptr<Signature> sig = LibrarySignatureDb.get(name)) {
+            sig->setUnknown(false);
+            it = LibrarySignatures.insert(name, sig);
+        }
+    }
     if (it == LibrarySignatures.end()) {
         LOG << "Unknown library function " << name << "\n";
         signature = getDefaultSignature(name);
     } else {
-        // Don't clone here; cloned in CallStatement::setSigArguments
+        // Don't clone here; cloned in CallStatement::setSigArguments. The entry is shared by every thread that
+        // decompiles a caller, so it is marked known once, when it is read, and never changed here.
         signature = *it;
-        signature->setUnknown(false);
     }
     return signature;
 }
@@ -496,6 +622,7 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
 
     // just in case you missed it
     Boomerang::get()->alertNew(pProc);
+    Arena::Scope arenaScope(pProc->getArena());
 
     // We have a set of CallStatement pointers. These may be disregarded if this is a speculative decode
     // that fails (i.e. an illegal instruction is found). If not, this set will be used to add to the set of calls
@@ -578,8 +705,8 @@ bool FrontEnd::processProc(ADDRESS uAddr, UserProc *pProc, QTextStream &/*os*/,
             nTotalBytes += inst.numBytes;
 
             // Check if this is an already decoded jump instruction (from a previous pass with propagation etc)
-            // If so, we throw away the just decoded RTL (but we still may have needed to calculate the number
-            // of bytes.. ick.)
+            // If so, we throw away the just decoded RTL (but we still need the number of bytes; on a new pass
+            // these come from the decode cache, see decodeInstruction)
             std::map<ADDRESS, RTL *>::iterator ff = previouslyDecoded.find(uAddr);
             if (ff != previouslyDecoded.end())
                 pRtl = ff->second;
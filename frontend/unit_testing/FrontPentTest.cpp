@@ -8,6 +8,9 @@
 #include "types.h"
 #include "rtl.h"
 #include "prog.h"
+#include "proc.h"
+#include "cfg.h"
+#include "statement.h"
 #include "frontend.h"
 #include "pentiumfrontend.h"
 #include "BinaryFile.h"
@@ -25,6 +28,7 @@
 #define FEDORA2_TRUE baseDir.absoluteFilePath("tests/inputs/pentium/fedora2_true")
 #define FEDORA3_TRUE baseDir.absoluteFilePath("tests/inputs/pentium/fedora3_true")
 #define SUSE_TRUE baseDir.absoluteFilePath("tests/inputs/pentium/suse_true")
+#define TWOPROC_PENT baseDir.absoluteFilePath("tests/inputs/pentium/twoproc")
 
 static bool logset = false;
 static QString TEST_BASE;
@@ -257,4 +261,34 @@ void FrontPentTest::testFindMain() {
     bff.UnLoad();
     delete pFE;
 }
+
+/***************************************************************************/ /**
+  * FUNCTION:        FrontPentTest::testReDecodeCall
+  * OVERVIEW:        Decoding a proc again takes its instructions from the decode cache; a direct call must still get
+  *                  the proc at its destination
+  *============================================================================*/
+void FrontPentTest::testReDecodeCall() {
+    Prog *prog = Boomerang::get()->loadAndDecode(TWOPROC_PENT);
+    QVERIFY(prog != nullptr);
+    Function *f = prog->findProc("main");
+    QVERIFY(f != nullptr && !f->isLib());
+    UserProc *main = (UserProc *)f;
+    main->getCFG()->clear();
+    prog->reDecode(main);
+
+    StatementList stmts;
+    main->getStatements(stmts);
+    int calls = 0;
+    for (Instruction *s : stmts) {
+        if (!s->isCall() || ((CallStatement *)s)->getFixedDest() == NO_ADDRESS)
+            continue;
+        CallStatement *call = (CallStatement *)s;
+        QVERIFY(call->getDestProc() != nullptr);
+        QVERIFY(call->getDestProc() == prog->findProc(call->getFixedDest()));
+        ++calls;
+    }
+    QVERIFY(calls > 0);
+    delete prog;
+}
+
 QTEST_MAIN(FrontPentTest)
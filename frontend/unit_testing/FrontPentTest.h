@@ -8,4 +8,5 @@ class FrontPentTest : public QObject {
     void test3();
     void testFindMain();
     void testBranch();
+    void testReDecodeCall();
 };
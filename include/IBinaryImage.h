@@ -32,6 +32,8 @@ public:
     virtual float readNativeFloat4(ADDRESS nat) = 0;//!< Read 4 bytes as a float; considers endianness
     virtual double readNativeFloat8(ADDRESS nat) = 0;//!< Read 8 bytes as a float; considers endianness
     virtual void writeNative4(ADDRESS nat, uint32_t n)=0;
+    //! Host pointer to \a len bytes at native address \a nat, or nullptr unless they all lie in one section
+    virtual const uint8_t *readSpan(ADDRESS nat, size_t len) = 0;
 
     virtual bool isReadOnly(ADDRESS uEntry) =0; //!< returns true if the given address is in a read only section
     virtual iterator                begin()       =0;
@@ -3,6 +3,7 @@
 
 class IBinaryImage;
 class QByteArray;
+class QString;
 struct ITypeRecovery;
 /**
  * @brief The Project interface class
@@ -11,6 +12,7 @@ class IProject {
 public:
     virtual ~IProject() {}
     virtual QByteArray &filedata() = 0;
+    virtual bool loadFile(const QString &path) = 0;
     virtual IBinaryImage *image() = 0;
     virtual void typeEngine(ITypeRecovery *e) = 0;
     virtual ITypeRecovery *typeEngine() = 0;
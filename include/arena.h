@@ -0,0 +1,90 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       arena.h
+  * \brief   Per procedure arenas for expressions, statements and RTLs (--arena).
+  ******************************************************************************/
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+/***************************************************************************/ /**
+  * An Arena hands out memory for the nodes of one procedure from large chunks, instead of a heap block per node. It is
+  * made current for a thread with an Arena::Scope; while it is, Exp nodes made with makeArenaShared, and statements and
+  * RTLs made with new, come from it. Outside of any scope everything comes from the heap as usual, block for block.
+  * Chunks are aligned to their size, so freeing finds the chunk of a block from its address alone, in a table that
+  * is read without a lock (and not at all unless arenas are in use).
+  *
+  * Nodes are freed one by one as before, but the memory is only given back a chunk at a time: a chunk counts the
+  * nodes that still live in it, and goes back to the heap when the last one is freed and the arena has moved on (or
+  * was destroyed). So an Arena can be destroyed at any time, even while its nodes are still referenced elsewhere (e.g.
+  * a parameter expression copied into a caller); the chunks holding them stay until they are freed. As one such node
+  * keeps a whole chunk, what outlives the procedure (signatures, library signatures, patterns and other caches) is
+  * made under an Arena::Scope for the heap.
+  *
+  * One thread allocates from an arena at a time; nodes can be freed from any thread.
+  ******************************************************************************/
+class Arena {
+public:
+    /// Makes \a a the current arena of this thread for its lifetime; \a a may be nullptr, for the heap
+    class Scope {
+        Arena *saved;
+
+    public:
+        explicit Scope(Arena *a) : saved(currentArena) { currentArena = a; }
+        ~Scope() { currentArena = saved; }
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+    };
+
+    Arena() = default;
+    ~Arena();
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    static Arena *current() { return currentArena; }
+    static void *allocate(size_t size);
+    static void deallocate(void *p);
+
+    struct Chunk; //!< Opaque; see arena.cpp
+
+private:
+    static thread_local Arena *currentArena;
+
+    Chunk *chunk = nullptr; //!< The chunk being filled
+    size_t used = 0;        //!< Bytes of chunk handed out so far
+
+    void *take(size_t need);
+    static Chunk *newChunk(size_t size, size_t refs);
+    static void release(Chunk *c);
+};
+
+/// A minimal allocator over the current Arena, for std::allocate_shared
+template <class T> class ArenaAllocator {
+public:
+    typedef T value_type;
+    ArenaAllocator() = default;
+    template <class U> ArenaAllocator(const ArenaAllocator<U> &) {}
+    T *allocate(size_t n) { return static_cast<T *>(Arena::allocate(n * sizeof(T))); }
+    void deallocate(T *p, size_t) { Arena::deallocate(p); }
+    template <class U> bool operator==(const ArenaAllocator<U> &) const { return true; }
+    template <class U> bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+/// std::make_shared, with the object and its control block in the current Arena if there is one
+template <class T, class... Args> std::shared_ptr<T> makeArenaShared(Args &&... args) {
+    if (Arena::current() == nullptr)
+        return std::make_shared<T>(std::forward<Args>(args)...);
+    return std::allocate_shared<T>(ArenaAllocator<T>(), std::forward<Args>(args)...);
+}
+
+#endif // ARENA_H
@@ -288,8 +288,7 @@ class BasicBlock {
     void prependStmt(Instruction *s, UserProc *proc);
 
     // Liveness
-    bool calcLiveness(ConnectionGraph &ig, UserProc *proc);
-    void getLiveOut(LocationSet &live, LocationSet &phiLocs);
+    void getPhiLiveOut(LocationSet &phiLocs);
 
     bool decodeIndirectJmp(UserProc *proc);
     void processSwitch(UserProc *proc);
@@ -333,6 +332,7 @@ class BasicBlock {
         return false;
     }
     friend class XMLProgParser;
+    friend class ProgSerializer;
     bool isAncestorOf(BasicBlock *other);
     bool inLoop(BasicBlock *header, BasicBlock *latch);
     bool isIn(const std::list<BasicBlock *> &set, BasicBlock *bb) {
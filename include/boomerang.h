@@ -48,6 +48,7 @@ class SeparateLogger;
 class Log;
 class Prog;
 class Function;
+class FrontEnd;
 class UserProc;
 class HLLCode;
 class ObjcModule;
@@ -62,7 +63,13 @@ enum LogLevel {
 };
 #define LOG Boomerang::get()->log()
 #define LOG_SEPARATE(x) Boomerang::get()->separate_log(x)
-#define LOG_VERBOSE(x) Boomerang::get()->if_verbose_log(x)
+/// LOG, if verbosity level \a x is being logged (see Boomerang::isVerboseLogged). If it is not, the rest of the
+/// statement is not evaluated at all, so nothing is formatted. An expression, so it is safe in a brace-less if.
+#define LOG_VERBOSE(x) !Boomerang::get()->isVerboseLogged(x) ? (void)0 : LogVoidify() & LOG
+//! Turns a whole LOG << ... chain into void, to match the other arm of the ?: in LOG_VERBOSE; & binds looser than <<
+struct LogVoidify {
+    void operator&(Log &) {}
+};
 #define LOG_STREAM Boomerang::get()->getLogStream
 
 /// Virtual class to monitor the decompilation.
@@ -129,7 +136,10 @@ public:
     Log &log();
     SeparateLogger separate_log(const QString &);
     Log &if_verbose_log(int verbosity_level);
+    //! True if messages of \a verbosity_level are logged: level 2 always, level 1 with -v, others never
+    bool isVerboseLogged(int verbosity_level) const { return verbosity_level == 2 || (verbosity_level == 1 && vFlag); }
     void setLogger(Log *l);
+    void startFileLog();
     bool setOutputDirectory(const QString &path);
 
     HLLCode *getHLLCode(UserProc *p = nullptr);
@@ -143,12 +153,13 @@ public:
     void setOutputPath(const QString &p) { outputPath = p; }
     /// Returns the path to where the output files are saved.
     const QString &getOutputPath() { return outputPath; }
+    void loadSymbols(Prog *prog, FrontEnd *fe);
     Prog *loadAndDecode(const QString &fname, const char *pname = nullptr);
     int decompile(const QString &fname, const char *pname = nullptr);
     /// Add a Watcher to the set of Watchers for this Boomerang object.
     void addWatcher(Watcher *watcher) { watchers.insert(watcher); }
-    void persistToXML(Prog *prog);
-    Prog *loadFromXML(const char *fname);
+    bool saveProject(Prog *prog);
+    Prog *loadProject(const QString &fname);
     void objcDecode(const std::map<QString, ObjcModule> &modules, Prog *prog);
 
     /// Alert the watchers that decompilation has completed.
@@ -240,6 +251,7 @@ public:
     void alertDecompileDebugPoint(UserProc *p, const char *description);
 
     QTextStream &getLogStream(int level=LL_Default); //!< Return overall logging target
+    void redirectThreadLog(QTextStream *log_strm, QTextStream *err_strm);
     QString filename() const;
 
     // Command line flags
@@ -289,6 +301,12 @@ public:
     bool noGlobals = false;
     bool assumeABI = false;    ///< Assume ABI compliance
     bool experimental = false; ///< Activate experimental code. Caution!
+    int numThreads = 1;        ///< Number of worker threads used to decompile procedures and generate their code
+    QString cacheDir;          ///< Directory of the persistent decompile cache; empty if not used
+    QString statsFormat;       ///< Format of the decompilation statistics ("json"); empty if not collected
+    bool procArenas = false;   ///< Allocate the expressions, statements and RTLs of each procedure from its own Arena
+    bool streamProcs = false;  ///< Generate the code of each procedure as it leaves SSA form, then free its IR
+    bool useRules = false;     ///< Also simplify expressions with the rules in transformations/
     QTextStream LogStream;
     QTextStream ErrStream;
     std::vector<ADDRESS> entrypoints;       /// A vector which contains all know entrypoints for the Prog.
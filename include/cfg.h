@@ -70,6 +70,7 @@ class Cfg {
     BasicBlock *exitBB;
     sCallStatement CallSites;
     mExpStatement implicitMap;
+    unsigned stmtGeneration; //!< Bumped by stmtsChanged()
 
   public:
     class BBAlreadyExistsError : public std::exception {
@@ -80,9 +81,11 @@ class Cfg {
     Cfg();
     ~Cfg();
     void setProc(UserProc *proc);
+    void indexBB(BasicBlock *bb);
     void clear();
     size_t getNumBBs() { return m_listBB.size(); } //!<Get the number of BBs
     Cfg &operator=(const Cfg &other);        /* Copy constructor */
+    void copyBBs(const Cfg &other, std::map<const Instruction *, Instruction *> &stmts);
 
     BasicBlock *newBB(std::list<RTL *> *pRtls, BBTYPE bbType, uint32_t iNumOutEdges) noexcept(false);
     BasicBlock *newIncompleteBB(ADDRESS addr);
@@ -128,6 +131,9 @@ class Cfg {
     Exp *getReturnVal();
     void structure();
     void removeJunctionStatements();
+    //! Note that BBs were added, removed or reordered, or statements added to them; see UserProc::getStatementIndex
+    void stmtsChanged() { ++stmtGeneration; }
+    unsigned getStmtGeneration() const { return stmtGeneration; }
 
     //! return a bb given an address
     BasicBlock *bbForAddr(ADDRESS addr) { return m_mapBB[addr]; }
@@ -191,7 +197,6 @@ class Cfg {
     bool implicitsDone() { return ImplicitsDone; }    //!<  True if implicits have been created
     void setImplicitsDone() { ImplicitsDone = true; } //!< Call when implicits have been created
     void findInterferences(ConnectionGraph &ig);
-    void appendBBs(std::list<BasicBlock *> &worklist, std::set<BasicBlock *> &workset);
     void removeUsedGlobals(std::set<Global *> &unusedGlobals);
     void bbSearchAll(Exp *search, std::list<SharedExp> &result, bool ch);
 
@@ -199,6 +204,7 @@ class Cfg {
 protected:
     void addBB(BasicBlock *bb) { m_listBB.push_back(bb); }
     friend class XMLProgParser;
+    friend class ProgSerializer;
 }; /* Cfg */
 
 #endif
@@ -60,22 +60,22 @@ class DataFlow {
      * Inserting phi-functions
      */
     // Array of sets of locations defined in BB n
-    std::vector<std::set<SharedExp , lessExpStar>> A_orig;
-    // Map from expression to set of block numbers
+    std::vector<ExpHashSet> A_orig;
+    // Map from expression to set of block numbers. Ordered: phi functions are placed in this order
     std::map<SharedExp , std::set<int>, lessExpStar> defsites;
     // Set of block numbers defining all variables
     std::set<int> defallsites;
     // Array of sets of BBs needing phis
-    std::map<SharedExp , std::set<int>, lessExpStar> A_phi;
+    ExpHashMap<std::set<int>> A_phi;
     // A Boomerang requirement: Statements defining particular subscripted locations
-    std::map<SharedExp , Instruction *, lessExpStar> defStmts;
+    ExpHashMap<Instruction *> defStmts;
 
     /*
      * Renaming variables
      */
     // The stack which remembers the last definition of an expression.
     // A map from expression (Exp*) to a stack of (pointers to) Statements
-    std::map<SharedExp , std::deque<Instruction *>, lessExpStar> Stacks;
+    ExpHashMap<std::deque<Instruction *>> Stacks;
 
     // Initially false, meaning that locals and parameters are not renamed and hence not propagated.
     // When true, locals and parameters can be renamed if their address does not escape the local procedure.
@@ -180,7 +180,7 @@ class DefCollector {
      * Update the definitions with the current set of reaching definitions
      * proc is the enclosing procedure
      */
-    void updateDefs(std::map<SharedExp , std::deque<Instruction *>, lessExpStar> &Stacks, UserProc *proc);
+    void updateDefs(ExpHashMap<std::deque<Instruction *>> &Stacks, UserProc *proc);
 
     /**
      * Find the definition for a location. If not found, return nullptr
@@ -0,0 +1,165 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       decompilecache.h
+  * \brief   Persistent, content addressed cache of decompiled procedures (--cache <dir>).
+  ******************************************************************************/
+#ifndef DECOMPILECACHE_H
+#define DECOMPILECACHE_H
+
+#include "types.h"
+
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include <utility>
+#include <memory>
+
+class Prog;
+class Function;
+class UserProc;
+class Exp;
+class Instruction;
+class Signature;
+typedef std::shared_ptr<Exp> SharedExp;
+
+/***************************************************************************/ /**
+  * DecompileCache lets a re-run on a new build of the same program skip the procedures that did not change.
+  *
+  * A procedure is looked up just before UserProc::decompile would start on it, when all its callees are final.
+  * The key is a hash of its decoded instructions (RTLs, so a change to the bytes or to the SSL semantics both miss)
+  * and of the names and summaries of its callees. It does not depend on where the procedure is or on its name:
+  * addresses are taken relative to its entry, so a procedure that moved or was renamed still hits, and its code is
+  * renamed on restore. An entry holds what callers see of the
+  * procedure before the global passes (signature, parameters, returns, modifieds and proven facts), the liveness at
+  * its calls, its final returns and the generated C. Everything else the procedure read from the image (switch
+  * tables, strings, code decoded while decompiling) is recorded with the entry and checked before it is used.
+  *
+  * On a hit the summary is restored and the procedure becomes final without being decompiled; it is skipped by the
+  * per procedure global passes, and its cached C is emitted by Prog::generateCode. Whether a procedure is cached
+  * can only be confirmed after the returns of the whole program are known: if its callers now need different
+  * returns, or a callee's final interface changed, revalidate() undoes the restore and decompiles it after all.
+  * Such late procedures, recursion groups and anything that cannot be serialized are never stored.
+  ******************************************************************************/
+class DecompileCache {
+    friend class DecompileCacheTest;
+
+public:
+    /// Records the image reads made while working on one procedure (RAII). Nested scopes shadow outer ones;
+    /// a scope without a cache (or for a procedure that is not being recorded) suspends recording.
+    class ReadScope {
+        std::vector<std::pair<ADDRESS, size_t>> reads;
+        std::vector<std::pair<ADDRESS, size_t>> *saved;
+        DecompileCache *cache;
+        UserProc *proc;
+
+    public:
+        ReadScope(DecompileCache *c, UserProc *p);
+        ~ReadScope();
+    };
+
+    DecompileCache(Prog *prog, const QString &dir);
+    ~DecompileCache();
+
+    /// Note that \a len bytes of the image at \a addr were read on behalf of the current procedure
+    static void noteRead(ADDRESS addr, size_t len) {
+        if (currentReads)
+            currentReads->emplace_back(addr, len);
+    }
+
+    bool restore(UserProc *proc);
+    bool isCached(UserProc *proc);
+    void noteDecompiled(UserProc *proc);
+    void revalidate();
+    void captureInterfaces();
+    void addUsedGlobals(UserProc *proc, std::list<SharedExp> &used);
+    QString cachedCode(UserProc *proc);
+    void noteCode(UserProc *proc, const QString &code);
+    void flush();
+
+private:
+    struct CalleeRef {
+        QString name;
+        QByteArray summary; //!< digest of the callee's summary before the global passes
+        QByteArray iface;   //!< digest of the callee's final interface
+    };
+    struct GlobalRef {
+        QString name;
+        ADDRESS addr;
+        QByteArray type; //!< serialized type
+    };
+    struct Entry {
+        QByteArray key;
+        std::vector<std::pair<ADDRESS, quint32>> reads;
+        QByteArray readDigest;
+        std::vector<CalleeRef> callees;
+        std::vector<GlobalRef> globals;
+        QByteArray summary; //!< serialized summary before the global passes
+        QByteArray summaryDigest;
+        QByteArray finalReturns; //!< serialized locations of the final returns
+        QByteArray finalInterface;
+        std::vector<std::pair<qint64, QByteArray>> liveness; //!< serialized live locations, by call offset from the entry
+        QString name;         //!< of the procedure when its code was generated
+        QByteArray signature; //!< serialized signature at code generation
+        QString code;
+    };
+    /// State of a procedure that is being recorded, from its lookup to its code generation
+    struct Pending {
+        Entry entry;
+        std::vector<std::pair<ADDRESS, size_t>> reads;
+        bool summarised = false;
+        bool captured = false;
+        bool generated = false;
+        bool failed = false;
+    };
+    /// A procedure restored from the cache, with what is needed to undo the restore. The old parameter, return and
+    /// modified statements are owned here until undo() gives them back or release() deletes them
+    struct Restored {
+        Entry entry;
+        int oldStatus;
+        std::shared_ptr<Signature> oldSignature;
+        std::list<Instruction *> oldParameters;
+        std::list<Instruction *> oldReturns;
+        std::list<Instruction *> oldModifieds;
+        std::vector<std::pair<SharedExp, SharedExp>> oldProven;
+        std::shared_ptr<Signature> codeSignature;
+    };
+
+    static thread_local std::vector<std::pair<ADDRESS, size_t>> *currentReads;
+
+    Prog *prog;
+    QString dir;
+    QByteArray config; //!< options that affect the output; part of every key
+    QMutex lock {QMutex::Recursive};
+    std::map<UserProc *, Pending> pending;
+    std::map<UserProc *, Restored> cached;
+    std::map<Function *, QByteArray> summaryDigests;
+    std::set<UserProc *> late; //!< procedures whose restore was undone; never looked up or stored again
+    int hits = 0, misses = 0, stale = 0, stored = 0;
+
+    QByteArray computeKey(UserProc *proc);
+    QByteArray summaryDigest(Function *f);
+    QByteArray interfaceDigest(Function *f);
+    QByteArray serializeSummary(UserProc *proc);
+    bool applySummary(UserProc *proc, Restored &r);
+    bool claimGlobals(const std::vector<GlobalRef> &refs);
+    QByteArray returnLocations(UserProc *proc);
+    QByteArray readDigest(const std::vector<std::pair<ADDRESS, quint32>> &ranges);
+    bool readEntry(const QString &path, Entry &e);
+    bool writeEntry(const QString &path, const Entry &e);
+    bool isStale(UserProc *proc, Restored &r);
+    void undo(UserProc *proc, Restored &r);
+    void release(Restored &r);
+    QString entryPath(const QByteArray &key) const;
+};
+
+#endif // DECOMPILECACHE_H
@@ -0,0 +1,94 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       decompilestats.h
+  * \brief   Per procedure and per phase timings and counters of a decompilation (--stats=json).
+  ******************************************************************************/
+#ifndef DECOMPILESTATS_H
+#define DECOMPILESTATS_H
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+#include <map>
+
+class UserProc;
+
+/***************************************************************************/ /**
+  * DecompileStats collects, for every procedure, the wall time spent in each phase of the decompilation, the number
+  * of statements and phi statements left after it, how many statements propagation changed, how many proofs were
+  * attempted and how many of those the proof memo answered, and the peak memory use of the process when the phase
+  * ended.
+  *
+  * Phases are timed with a Phase object at the start of the function that implements them. Times are exclusive: a
+  * phase that starts while another is running on the same thread (type analysis within remUnusedStmtEtc, or the
+  * decompilation of a callee from within middleDecompile) is subtracted from the enclosing one, so that the phase
+  * times of all procedures add up to the time spent in them. A phase that runs more than once for a procedure (e.g.
+  * for a recursion group) accumulates.
+  * All methods can be called from the worker threads of a parallel decompile.
+  ******************************************************************************/
+class DecompileStats {
+public:
+    enum PhaseKind {
+        INITIALISE,    //!< UserProc::initialiseDecompile
+        EARLY,         //!< UserProc::earlyDecompile
+        MIDDLE,        //!< UserProc::middleDecompile
+        REM_UNUSED,    //!< UserProc::remUnusedStmtEtc
+        TYPE_ANALYSIS, //!< UserProc::typeAnalysis
+        FROM_SSA,      //!< UserProc::fromSSAform
+        CODEGEN,       //!< UserProc::generateCode
+        NUM_PHASES
+    };
+
+    /// Times one run of a phase for a procedure (RAII). Does nothing if \a stats is nullptr.
+    class Phase {
+        DecompileStats *stats;
+        UserProc *proc;
+        PhaseKind kind;
+        QElapsedTimer timer;
+        Phase *outer;            //!< The phase this one runs within, if any
+        qint64 nestedNsecs = 0;  //!< Time spent in phases that ran within this one
+        static thread_local Phase *current;
+
+    public:
+        Phase(DecompileStats *s, UserProc *p, PhaseKind k);
+        ~Phase();
+    };
+
+    DecompileStats() { total.start(); }
+
+    void addPropagations(UserProc *proc, int n);
+    void addProverCall(UserProc *proc);
+    void addProofMemoLookup(UserProc *proc, bool hit);
+    bool writeJson(const QString &path);
+
+private:
+    struct PhaseStats {
+        qint64 nsecs = 0;
+        int runs = 0;
+        int statements = 0; //!< after the last run
+        int phis = 0;       //!< after the last run
+        qint64 peakRss = 0; //!< kB
+    };
+    struct ProcStats {
+        PhaseStats phases[NUM_PHASES];
+        int propagations = 0;
+        int proverCalls = 0;
+        int proofMemoLookups = 0;
+        int proofMemoHits = 0;
+    };
+
+    QMutex lock;
+    QElapsedTimer total;
+    std::map<UserProc *, ProcStats> procs;
+
+    void endPhase(UserProc *proc, PhaseKind kind, qint64 nsecs);
+    static qint64 peakRss();
+};
+
+#endif // DECOMPILESTATS_H
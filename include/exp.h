@@ -21,6 +21,7 @@
 #include "types.h"    // For ADDRESS, etc
 #include "type.h"     // The Type class for typed expressions
 #include "util.h"
+#include "arena.h"
 //#include "statement.h"    // For StmtSet etc
 #include "exphelp.h"
 //#include "memo.h"
@@ -70,6 +71,9 @@ class Exp : public Printable, public std::enable_shared_from_this<Exp> {
 protected:
     OPER op; // The operator (e.g. opPlus)
     mutable unsigned lexBegin = 0, lexEnd = 0;
+    //! The outermost simplify() call that left this subtree simplified (0 if none). Only that call trusts it; see
+    //! simplifySubExp()
+    mutable unsigned simplifiedIn = 0;
     // Constructor, with ID
     Exp(OPER _op) : op(_op) {}
 
@@ -81,7 +85,10 @@ public:
     //! it (at least, for subexpressions)
     OPER getOper() const { return op; }
     const char *getOperName() const;
-    void setOper(OPER x) { op = x; } // A few simplifications use this
+    void setOper(OPER x) { // A few simplifications use this
+        op = x;
+        simplifiedIn = 0;
+    }
 
     void setLexBegin(unsigned int n) const { lexBegin = n; }
     void setLexEnd(unsigned int n) const { lexEnd = n; }
@@ -116,6 +123,8 @@ public:
     virtual bool operator<<(const Exp &o) const { return (*this < o); }
     //! Comparison ignoring subscripts
     virtual bool operator*=(const Exp &o) const = 0;
+    //! Structural hash, consistent with operator< (types and subscript definitions are not hashed)
+    virtual size_t hash() const;
 
     //! Return the number of subexpressions. This is only needed in rare cases.
     //! Could use polymorphism for all those cases, but this is easier
@@ -374,6 +383,7 @@ public:
     virtual void descendType(SharedType  /*parentType*/, bool & /*ch*/, Instruction * /*s*/) { assert(0); }
 
 protected:
+    static SharedExp simplifySubExp(const SharedExp &e, bool &bMod);
     template <typename CHILD>
     std::shared_ptr<CHILD> shared_from_base()
     {
@@ -418,7 +428,7 @@ public:
     Const(Function *p);
     // Copy constructor
     Const(const Const &o);
-    template <class T> static std::shared_ptr<Const> get(T i) { return std::make_shared<Const>(i); }
+    template <class T> static std::shared_ptr<Const> get(T i) { return makeArenaShared<Const>(i); }
 
     // Nothing to destruct: Don't deallocate the string passed to constructor
 
@@ -429,6 +439,7 @@ public:
     virtual bool operator==(const Exp &o) const;
     virtual bool operator<(const Exp &o) const;
     virtual bool operator*=(const Exp &o) const;
+    virtual size_t hash() const;
 
     // Get the constant
     int getInt() const { return u.i; }
@@ -482,7 +493,7 @@ public:
     // Constructors
     Terminal(OPER op);
     Terminal(const Terminal &o); // Copy constructor
-    static SharedExp get(OPER op) { return std::make_shared<Terminal>(op); }
+    static SharedExp get(OPER op) { return makeArenaShared<Terminal>(op); }
 
     // Clone
     SharedExp clone() const override;
@@ -524,7 +535,7 @@ public:
     Unary(OPER op, SharedExp e);
     // Copy constructor
     Unary(const Unary &o);
-    static SharedExp get(OPER op, SharedExp e1) { return std::make_shared<Unary>(op, e1); }
+    static SharedExp get(OPER op, SharedExp e1) { return makeArenaShared<Unary>(op, e1); }
 
     // Clone
     virtual SharedExp clone() const override;
@@ -533,6 +544,7 @@ public:
     virtual bool operator==(const Exp &o) const override;
     virtual bool operator<(const Exp &o) const override;
     bool operator*=(const Exp &o) const override;
+    size_t hash() const override;
 
     // Destructor
     virtual ~Unary();
@@ -594,7 +606,7 @@ public:
     Binary(OPER op, SharedExp e1, SharedExp e2);
     // Copy constructor
     Binary(const Binary &o);
-    static std::shared_ptr<Binary> get(OPER op, SharedExp e1, SharedExp e2) { return std::make_shared<Binary>(op, e1, e2); }
+    static std::shared_ptr<Binary> get(OPER op, SharedExp e1, SharedExp e2) { return makeArenaShared<Binary>(op, e1, e2); }
 
     // Clone
     virtual SharedExp clone() const override;
@@ -603,6 +615,7 @@ public:
     bool operator==(const Exp &o) const override;
     bool operator<(const Exp &o) const override;
     bool operator*=(const Exp &o) const override;
+    size_t hash() const override;
 
     // Destructor
     virtual ~Binary();
@@ -675,6 +688,7 @@ public:
     bool operator==(const Exp &o) const override;
     bool operator<(const Exp &o) const override;
     bool operator*=(const Exp &o) const override;
+    size_t hash() const override;
 
     // Destructor
     virtual ~Ternary();
@@ -851,7 +865,7 @@ class TypeVal : public Terminal {
 public:
     TypeVal(SharedType ty);
     ~TypeVal();
-    static std::shared_ptr<TypeVal> get(const SharedType &st) { return std::make_shared<TypeVal>(st);}
+    static std::shared_ptr<TypeVal> get(const SharedType &st) { return makeArenaShared<TypeVal>(st);}
     virtual SharedType getType() { return val; }
     virtual void setType(SharedType t) { val = t; }
     virtual SharedExp clone() const override;
@@ -884,11 +898,11 @@ public:
     // Copy constructor
     Location(Location &o);
     // Custom constructor
-    static SharedExp get(OPER op, SharedExp e, UserProc *proc) { return std::make_shared<Location>(op, e, proc); }
+    static SharedExp get(OPER op, SharedExp e, UserProc *proc) { return makeArenaShared<Location>(op, e, proc); }
     static SharedExp regOf(int r) { return get(opRegOf, Const::get(r), nullptr); }
     static SharedExp regOf(SharedExp e) { return get(opRegOf, e, nullptr); }
     static SharedExp memOf(SharedExp e, UserProc *p = nullptr) { return get(opMemOf, e, p); }
-    static std::shared_ptr<Location> tempOf(SharedExp e) { return std::make_shared<Location>(opTemp, e, nullptr); }
+    static std::shared_ptr<Location> tempOf(SharedExp e) { return makeArenaShared<Location>(opTemp, e, nullptr); }
     static SharedExp global(const char *nam, UserProc *p) { return get(opGlobal, Const::get(nam), p); }
     static SharedExp global(const QString &nam, UserProc *p) { return get(opGlobal, Const::get(nam), p); }
     static std::shared_ptr<Location> local(const QString &nam, UserProc *p);
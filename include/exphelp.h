@@ -17,6 +17,8 @@
 
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <unordered_set>
 class Exp;
 using SharedExp = std::shared_ptr<Exp>;
 using SharedConstExp = std::shared_ptr<const Exp>;
@@ -31,6 +33,28 @@ struct lessExpStar : public std::binary_function<const SharedConstExp &, const S
     bool operator()(const SharedConstExp &x, const SharedConstExp &y) const;
 };
 
+/**
+ * Structural hash of an expression, for use with hash containers. Consistent with lessExpStar: expressions that are
+ * neither less than the other hash equally. Wildcards are not supported.
+ */
+struct hashExpStar : public std::unary_function<const SharedConstExp &, size_t> {
+    size_t operator()(const SharedConstExp &x) const;
+    size_t operator()(const SharedExp &x) const; //!< Saves converting to SharedConstExp (a reference count update)
+};
+
+/**
+ * Structural equality matching hashExpStar; equivalent to !lessExpStar(x, y) && !lessExpStar(y, x)
+ */
+struct equalExpStar : public std::binary_function<const SharedConstExp &, const SharedConstExp &, bool> {
+    bool operator()(const SharedConstExp &x, const SharedConstExp &y) const;
+    bool operator()(const SharedExp &x, const SharedExp &y) const;
+};
+
+//! Hash set and map of expressions, by structure. Their order of iteration is arbitrary: use the ordered containers
+//! (with lessExpStar) where the order shows in the output
+using ExpHashSet = std::unordered_set<SharedExp, hashExpStar, equalExpStar>;
+template <class T> using ExpHashMap = std::unordered_map<SharedExp, T, hashExpStar, equalExpStar>;
+
 /**
  * A class for comparing Exp*s (comparing the actual expressions)
  * Type insensitive
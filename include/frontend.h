@@ -23,12 +23,17 @@
 #include "sigenum.h" // For enums platform and cc
 #include "BinaryFile.h"
 #include "TargetQueue.h"
+#include "signaturedb.h"
+#include "decoder.h" // For DecodeResult
 
 #include <list>
 #include <map>
 #include <queue>
 #include <fstream>
 #include <QMap>
+#include <QList>
+#include <QPair>
+#include <QMutex>
 #include <memory>
 
 class UserProc;
@@ -40,7 +45,6 @@ class Exp;
 class TypedExp;
 class Cfg;
 class Prog;
-struct DecodeResult;
 class Signature;
 class Instruction;
 class CallStatement;
@@ -80,10 +84,18 @@ protected:
     TargetQueue targetQueue;
     // Public map from function name (string) to signature.
     QMap<QString, std::shared_ptr<Signature> > LibrarySignatures;
+    // The compiled catalogs; signatures read from it are kept in LibrarySignatures
+    SignatureDb LibrarySignatureDb;
+    QMutex LibrarySignatureLock; //!< getLibSignature can fill LibrarySignatures from a worker thread
     // Map from address to meaningful name
     std::map<ADDRESS, QString> refHints;
     // Map from address to previously decoded RTLs for decoded indirect control transfer instructions
     std::map<ADDRESS, RTL *> previouslyDecoded;
+    // Map from address to what the decoder made of the instruction there, for decoding it again (decodeInstruction).
+    // The rtl of each result is a template, cloned for every use. An entry with reDecode set is never reused: the
+    // instruction is decoded in several steps (e.g. Pentium BSF/BSR), each giving a different RTL
+    std::map<ADDRESS, DecodeResult> decodeCache;
+    DecodeResult cachedResult; // What decodeInstruction returns for an instruction found in decodeCache
 
 public:
     /*
@@ -112,6 +124,7 @@ public:
     // virtual    int            getInst(int addr);
 
     virtual DecodeResult &decodeInstruction(ADDRESS pc);
+    void clearDecodeCache();
 
     virtual void extraProcessCall(CallStatement * /*call*/, std::list<RTL *> * /*BB_rtls*/) {}
 
@@ -121,6 +134,7 @@ public:
     void readLibrarySignatures(const char *sPath, callconv cc); //!< Read library signatures from a file.
     void readLibraryCatalog(const QString &sPath);                 //!< read from a catalog
     void readLibraryCatalog();                                  //!< read from default catalog
+    static QList<QPair<QString, callconv>> catalogHeaders(const QString &sPath); //!< headers a catalog lists
 
     // lookup a library signature by name
     std::shared_ptr<Signature> getLibSignature(const QString &name);
@@ -193,6 +207,11 @@ public:
      * incomplete in these cases, and needs to be restarted from scratch
      */
     void addDecodedRtl(ADDRESS a, RTL *rtl) { previouslyDecoded[a] = rtl; }
+    //! The RTL added for \a a, or nullptr
+    RTL *getDecodedRtl(ADDRESS a) {
+        std::map<ADDRESS, RTL *>::iterator ff = previouslyDecoded.find(a);
+        return ff == previouslyDecoded.end() ? nullptr : ff->second;
+    }
     void preprocessProcGoto(std::list<Instruction *>::iterator ss, ADDRESS dest, const std::list<Instruction *> &sl,
                             RTL *pRtl);
     void checkEntryPoint(std::vector<ADDRESS> &entrypoints, ADDRESS addr, const char *type);
@@ -3,15 +3,20 @@
 #define LOG_H
 
 #include <QString>
+#include <QMutex>
+#include <QWaitCondition>
+#include <map>
 #include <memory>
 #include <fstream>
+#include <vector>
+
+#include "types.h"
 
 class Instruction;
 class Exp;
 class LocationSet;
 class RTL;
 class Type;
-struct ADDRESS;
 struct Printable;
 using SharedType = std::shared_ptr<Type>;
 using SharedConstExp = std::shared_ptr<const Exp>;
@@ -31,30 +36,94 @@ public:
     virtual Log &operator<<(ADDRESS a);
     virtual Log &operator<<(const LocationSet *l);
     virtual ~Log() {}
+    //! False if everything written to this log is discarded, so there is no point in formatting it
+    virtual bool isEnabled() const { return true; }
+};
+
+class QThread;
+/***************************************************************************/ /**
+  * LogWriter writes the text of the loggers to their files on a thread of its own. Each file is a channel: a file
+  * descriptor, opened once. The text for all channels goes through one bounded ring of records, already encoded, in
+  * the order it was logged. A logger only waits when the ring is full, so logging costs little more than copying the
+  * text.
+  *
+  * Everything queued is written before the program exits. After installCrashHandlers(), a crash (SIGSEGV, SIGABRT,
+  * SIGFPE, SIGILL) first writes out what is still in the ring, with nothing but write(2).
+  ******************************************************************************/
+class LogWriter {
+public:
+    static LogWriter &get();
+    static void installCrashHandlers();
+    int open(const QString &path);
+    void write(int channel, const QString &text);
+    void close(int channel);
+    void shutdown();
+    void writeOnCrash();
+
+private:
+    enum RecordKind { TEXT, CLOSE };
+    struct Record {
+        int channel;
+        RecordKind kind;
+        QByteArray text; //!< UTF-8
+    };
+    static const int CAPACITY = 4096;        //!< Records in the ring
+    static const int MAX_PENDING = 16 << 20; //!< Bytes queued before loggers wait for the writer
+
+    std::vector<Record> ring;
+    int head = 0;            //!< The oldest record in the ring
+    int count = 0;           //!< Records in the ring
+    qint64 pendingChars = 0; //!< Bytes of text in the ring
+    quint64 queued = 0;      //!< Records queued so far
+    quint64 written = 0;     //!< Records written so far
+    bool stopped = false; //!< The writer thread has finished; records are written by whoever queues them
+    QMutex lock;
+    QWaitCondition notEmpty, notFull, progress;
+    QThread *thread;
+
+    LogWriter();
+    static LogWriter *start();
+    void flush();
+    void enqueue(int channel, RecordKind kind, const QByteArray &text);
+    void run();
+    void writeRecords(std::vector<Record> &batch);
+    friend class LogWriterThread;
 };
 
 class FileLogger : public Log {
 protected:
-    std::ofstream out;
+    int channel; //!< In LogWriter
 public:
     FileLogger(); // Implemented in boomerang.cpp
-    virtual ~FileLogger() {}
+    virtual ~FileLogger();
     Log &operator<<(const QString &str)  override;
 };
 class SeparateLogger : public Log {
 protected:
-    std::ofstream *out;
+    int channel; //!< In LogWriter; -1 once moved from
 
 public:
     SeparateLogger(const QString &); // Implemented in boomerang.cpp
+    SeparateLogger(SeparateLogger &&other) : channel(other.channel) { other.channel = -1; }
     virtual ~SeparateLogger();
     Log &operator<<(const QString &str) override;
 };
+/// Discards everything, without formatting it first
 class NullLogger : public Log {
 public:
-    virtual Log &operator<<(const QString & /*str*/) {
-        return *this;
-    }
+    Log &operator<<(const QString & /*str*/) override { return *this; }
+    Log &operator<<(const Instruction * /*s*/) override { return *this; }
+    Log &operator<<(const SharedConstExp & /*e*/) override { return *this; }
+    Log &operator<<(const SharedType & /*ty*/) override { return *this; }
+    Log &operator<<(const Printable & /*ty*/) override { return *this; }
+    Log &operator<<(const RTL * /*r*/) override { return *this; }
+    Log &operator<<(int /*i*/) override { return *this; }
+    Log &operator<<(size_t /*i*/) override { return *this; }
+    Log &operator<<(char /*c*/) override { return *this; }
+    Log &operator<<(double /*d*/) override { return *this; }
+    Log &operator<<(ADDRESS /*a*/) override { return *this; }
+    Log &operator<<(const LocationSet * /*l*/) override { return *this; }
+    bool isEnabled() const override { return false; }
 };
 
 #endif
@@ -15,18 +15,23 @@
 #ifndef MEMO_H
 #define MEMO_H
 #include <list>
+/// A snapshot of the state of a Memoisable object, made by its makeMemo()
 class Memo {
   public:
     Memo(int m) : mId(m) {}
-    int mId;
+    int mId; //!< What the memo was taken for; -1 for none in particular
     virtual void doNothing() {}
     virtual ~Memo() {} // Kill gcc warning
 };
 
+/***************************************************************************/ /**
+  * Memoisable objects keep a history of memos of their state, which they can go back (or forward) to.
+  * Taking a memo forgets the memos after the current one; restoring one makes it the current memo.
+  ******************************************************************************/
 class Memoisable {
   public:
     Memoisable() { cur_memo = memos.begin(); }
-    virtual ~Memoisable() {}
+    virtual ~Memoisable();
 
     void takeMemo(int mId);
     void restoreMemo(int mId, bool dec = false);
@@ -37,10 +42,12 @@ class Memoisable {
     void takeMemo();
     bool canRestore(bool dec = false);
     void restoreMemo(bool dec = false);
+    bool hasMemo(int mId);
+    void clearMemos();
 
   protected:
     std::list<Memo *> memos;
-    std::list<Memo *>::iterator cur_memo;
+    std::list<Memo *>::iterator cur_memo; //!< The current memo; end() if there are none
 };
 
 #endif
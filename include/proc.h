@@ -31,6 +31,7 @@
 #include <set>
 #include <string>
 #include <cassert>
+#include <QtCore/QStringList>
 
 class Prog;
 class UserProc;
@@ -58,6 +59,7 @@ class Log;
 class Function {
 protected:
     friend class XMLProgParser;
+    friend class ProgSerializer;
 
 public:
     Function(ADDRESS uNative, Signature *sig, Module *mod);
@@ -77,7 +79,7 @@ public:
             m_firstCaller = p;
     }
     std::shared_ptr<Signature> getSignature() { return signature; } //!< Returns a pointer to the Signature
-    void setSignature(std::shared_ptr<Signature> sig) { signature = sig; }
+    void setSignature(std::shared_ptr<Signature> sig);
 
     virtual void renameParam(const char *oldName, const char *newName);
 
@@ -104,7 +106,7 @@ public:
     std::set<CallStatement *> &getCallers() { return callerSet; }
 
     //! Add to the set of callers
-    void addCaller(CallStatement *caller) { callerSet.insert(caller); }
+    void addCaller(CallStatement *caller);
     void addCallers(std::set<UserProc *> &callers);
 
     void removeParameter(SharedExp e);
@@ -186,9 +188,11 @@ typedef std::list<UserProc *> ProcList;
   * UserProc class.
   ******************************************************************************/
 
-class UserProc : public Function {
+class UserProc : public Function, public Memoisable {
 protected:
     friend class XMLProgParser;
+    friend class DecompileCache;
+    friend class ProgSerializer;
     Cfg *cfg; //!< The control flow graph.
 
     /**
@@ -248,6 +252,45 @@ private:
     DataFlow df;
     int stmtNumber;
     std::shared_ptr<ProcSet> cycleGrp;
+    /// A statement the prover read, as it was printed then
+    struct ProofDep {
+        UserProc *proc;
+        Instruction *stmt; //!< nullptr if the proof read more than single statements; it is then not memoised
+        QString text;
+    };
+    /// A result of the prover, valid while the statements it read print as they did
+    struct ProofMemo {
+        bool result;
+        std::vector<ProofDep> deps;
+    };
+    /// Results, proven and refuted, of the prover while findPreserveds and findSpPreservation run. Keyed on the
+    /// query as given to the prover, so on the SSA versions of the definitions it starts from (and, in a recursion
+    /// group, on the premises and proven facts of the group); an entry is dropped when one of its statements changed
+    std::map<QString, ProofMemo> proofMemo;
+    bool proofMemoActive = false;
+    /// The statements of this procedure as of proofStmtsGeneration of the CFG, to tell whether a ProofDep is current
+    std::set<const Instruction *> proofStmts;
+    unsigned proofStmtsGeneration = ~0u;
+    /// Where the statements read by the proofs being memoised go, innermost last
+    static thread_local std::vector<std::vector<ProofDep> *> proofDepStack;
+    /// All the statements, in the order of getStatements; see getStatementIndex. Current while stmtIndexGeneration is
+    /// the generation of the CFG
+    std::shared_ptr<std::vector<Instruction *>> stmtIndex;
+    unsigned stmtIndexGeneration = 0;
+
+    void updateStatementIndex(Instruction *stmt, Instruction *after = nullptr);
+    std::unique_ptr<Arena> arena; //!< With --arena: where the IR of this procedure is allocated
+
+public:
+    /// With --stream: what is kept of the procedure once its code is generated (see releaseIR)
+    struct Released {
+        QString code;        //!< The C text of the procedure
+        QString prototype;   //!< Its declaration, as HLLCode::AddPrototype prints it
+        QStringList globals; //!< The names of the globals its code uses
+    };
+
+private:
+    std::unique_ptr<Released> released;
 
 public:
     UserProc(Module *mod, const QString &name, ADDRESS address);
@@ -296,6 +339,9 @@ public:
     void initialiseDecompile();
     void earlyDecompile();
     std::shared_ptr<ProcSet> middleDecompile(ProcList *path, int indent);
+    Memo *makeMemo(int mId) override;
+    void readMemo(Memo *m, bool dec) override;
+    bool restoreDecoded();
     void recursionGroupAnalysis(ProcList *path, int indent);
 
     void typeAnalysis();
@@ -311,6 +357,11 @@ public:
     void fixUglyBranches();
     void placePhiFunctions() { df.placePhiFunctions(this); }
     bool doRenameBlockVars(int pass, bool clearStacks = false);
+    void beginProofMemo() { proofMemoActive = true; }
+    void endProofMemo() { proofMemoActive = false; }
+    void noteProofDep(Instruction *s);
+    bool proofDepsCurrent(const std::vector<ProofDep> &deps);
+    void printProofContext(QTextStream &os);
     bool canRename(SharedExp e) { return df.canRename(e, this); }
 
     Instruction *getStmtAtLex(unsigned int begin, unsigned int end);
@@ -319,12 +370,12 @@ public:
     void numberStatements();
     bool nameStackLocations();
     void removeRedundantPhis();
-    void findPreserveds();
+    bool findPreserveds();
     void findSpPreservation();
     void removeSpAssignsIfPossible();
     void removeMatchingAssignsIfPossible(SharedExp e);
     void updateReturnTypes();
-    void fixCallAndPhiRefs();
+    bool fixCallAndPhiRefs();
     void initialParameters();
     void mapLocalsAndParams();
     void findFinalParameters();
@@ -333,7 +384,7 @@ public:
     void insertParameter(SharedExp e, SharedType ty);
     //        void        addNewReturns(int depth);
     void updateArguments();
-    void updateCallDefines();
+    bool updateCallDefines();
     void replaceSimpleGlobalConstants();
     void reverseStrengthReduction();
 
@@ -373,7 +424,7 @@ public:
 #if USE_DOMINANCE_NUMS
     void setDominanceNumbers();
 #endif
-    void propagateToCollector();
+    bool propagateToCollector();
     void clearUses();
 
     // int        findMaxDepth();                    ///< Find max memory nesting depth.
@@ -408,6 +459,12 @@ public:
                 PhiAssign *lastPhi = nullptr);
     void promoteSignature();
     void getStatements(StatementList &stmts) const;
+    std::shared_ptr<const std::vector<Instruction *>> getStatementIndex();
+    Arena *getArena();
+    void releaseIR(const QString &code);
+    //! True if only the code of this procedure is left; its Cfg and the rest of its IR are gone
+    bool isReleased() const { return released != nullptr; }
+    const Released *getReleased() const { return released.get(); }
     virtual void removeReturn(SharedExp e) override;
     void removeStatement(Instruction *stmt);
     bool searchAll(const Exp &search, std::list<SharedExp> &result);
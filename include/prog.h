@@ -17,12 +17,16 @@
 #define _PROG_H_
 
 #include <map>
+#include <set>
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
+#include <boost/icl/interval_map.hpp>
 #include "BinaryFile.h"
 #include "frontend.h"
 #include "type.h"
 #include "module.h"
 #include "util.h"
-// TODO: refactor Prog Global handling into separate class
 class RTLInstDict;
 class Function;
 class UserProc;
@@ -34,6 +38,8 @@ class Module;
 class XMLProgParser;
 struct BinarySymbol;
 class HLLCode;
+class DecompileCache;
+class DecompileStats;
 
 class Global : public Printable {
 private:
@@ -46,7 +52,7 @@ public:
     virtual ~Global();
 
     SharedType getType() { return type; }
-    void setType(SharedType ty) { type = ty; }
+    void setType(SharedType ty);
     void meetType(SharedType ty);
     ADDRESS getAddress() { return uaddr; }
     bool addressWithinGlobal(ADDRESS addr) {
@@ -60,10 +66,46 @@ public:
     QString toString() const;
 
 protected:
-    Global() : type(nullptr), uaddr(ADDRESS::g(0L)) {}
+    Global() : type(nullptr), uaddr(ADDRESS::g(0L)), Parent(nullptr) {}
     friend class XMLProgParser;
+    friend class ProgSerializer;
 }; // class Global
 
+/***************************************************************************/ /**
+  * The globals of a program, indexed by name and by the range of addresses each one covers.
+  *
+  * The ranges are kept in an interval map, so finding the globals that cover an address is logarithmic whatever
+  * their sizes. A global is indexed with the size of its type when it is inserted or retyped; a change to its size
+  * must therefore go through Global::setType or Global::meetType, which tell the table.
+  ******************************************************************************/
+class GlobalTable {
+public:
+    typedef std::set<Global *>::iterator iterator;
+    typedef std::set<Global *>::const_iterator const_iterator;
+
+    iterator begin() { return all.begin(); }
+    iterator end() { return all.end(); }
+    const_iterator begin() const { return all.begin(); }
+    const_iterator end() const { return all.end(); }
+    size_t size() const { return all.size(); }
+    bool empty() const { return all.empty(); }
+
+    void insert(Global *g);
+    void clear();
+    Global *find(const QString &nam) const;
+    Global *findContaining(ADDRESS addr) const;
+    void retyped(Global *g);
+
+private:
+    typedef boost::icl::interval_map<ADDRESS, std::set<Global *>> RangeIndex;
+    std::set<Global *> all;                 //!< every global, ordered by pointer (which is also the emission order)
+    RangeIndex byRange;                     //!< the globals that cover each address
+    std::map<Global *, ADDRESS> indexedEnd; //!< end (exclusive) of the range each global is indexed with
+    QHash<QString, Global *> byName;
+
+    static ADDRESS rangeEnd(Global *g);
+};
+
 class Prog : public QObject {
     Q_OBJECT
     class IBinaryImage *Image;
@@ -96,6 +138,11 @@ public:
     Function *findProc(const QString &name) const;
     Function *findContainingProc(ADDRESS uAddr) const;
     bool isProcLabel(ADDRESS addr);
+    // Keep the procedure indices up to date; called by Module, Function and Cfg
+    void indexProcEntry(ADDRESS addr, Function *proc);
+    void indexProcName(Function *proc, const QString &oldName = QString());
+    void indexProcRange(UserProc *proc, ADDRESS lo, ADDRESS hi);
+    void unindexProc(Function *proc);
     QString getNameNoPath() const;
     QString getNameNoPathNoExt() const;
     UserProc *getFirstUserProc(std::list<Function *>::iterator &it);
@@ -185,12 +232,16 @@ public:
     void printCallGraphXML();
 
     Module *getRootCluster() { return m_rootCluster; }
+    DecompileCache *getDecompileCache() { return m_decompileCache; }
+    DecompileStats *getStats() { return m_stats; }
     Module *findModule(const QString &name);
     Module *getDefaultModule(const QString &name);
     bool moduleUsed(Module *c);
 
     //! Add the given RTL to the front end's map from address to aldready-decoded-RTL
     void addDecodedRtl(ADDRESS a, RTL *rtl) { DefaultFrontend->addDecodedRtl(a, rtl); }
+    //! The RTL given to addDecodedRtl for address \a a, or nullptr
+    RTL *getDecodedRtl(ADDRESS a) { return DefaultFrontend->getDecodedRtl(a); }
 
     SharedExp addReloc(SharedExp e, ADDRESS lc);
 
@@ -203,6 +254,10 @@ public:
 
     Module *getOrInsertModule(const QString &name, const ModuleFactory &fact=DefaultModFactory(), FrontEnd *frontend=nullptr);
 
+    bool claimProc(UserProc *proc);
+    void releaseClaims();
+    static void waitForSerialTurn();
+
     const ModuleListType &  getModuleList() const { return ModuleList; }
     ModuleListType       &  getModuleList()       { return ModuleList; }
 
@@ -216,6 +271,13 @@ public:
 signals:
     void rereadLibSignatures();
 
+private:
+    void decompileParallel(int num_threads);
+    void generateCodeParallel(const std::vector<std::pair<Module *, UserProc *>> &procs, int num_threads);
+    void releaseProc(UserProc *proc);
+    void globalRetyped(Global *g);
+    void clearProcIndices();
+
 protected:
     QObject *pLoaderPlugin; //!< Pointer to the instance returned by loader plugin
     LoaderInterface *pLoaderIface = nullptr;
@@ -224,13 +286,33 @@ protected:
     /* Persistent state */
     QString m_name;            // name of the program
     QString m_path;            // its full path
-    // FIXME: is a set of Globals the most appropriate data structure? Surely not.
-    std::set<Global *> globals; //!< globals to print at code generation time
+    GlobalTable globals;        //!< globals to print at code generation time
     DataIntervalMap globalMap;  //!< Map from address to DataInterval (has size, name, type)
     int m_iNumberedProc;        //!< Next numbered proc will use this
     Module *m_rootCluster;     //!< Root of the cluster tree
+    QMutex m_globalsLock {QMutex::Recursive}; //!< Guards globals when procedures are decompiled in parallel
+    mutable QMutex m_decodeLock {QMutex::Recursive}; //!< Guards the front end and module lists against concurrent decodes
+    mutable QMutex m_procIndexLock;             //!< Guards the procedure indices below
+    std::map<ADDRESS, Function *> m_procsByEntry; //!< Entry points of the procs of all modules (-1 if deleted)
+    QMultiHash<QString, Function *> m_procsByName;
+    /// Address ranges of the decoded BBs of user procs, by low address (hi is the address of the last RTL).
+    /// Entries are only added, so they are checked against the proc before they are trusted.
+    std::multimap<ADDRESS, std::pair<ADDRESS, UserProc *>> m_procRanges;
+    ADDRESS::value_type m_longestProcRange = 0;
+    DecompileCache *m_decompileCache = nullptr; //!< Set by decompile() when --cache is given
+    DecompileStats *m_stats = nullptr;          //!< Set by decompile() when --stats is given
+    bool m_parallel = false;                    //!< Set while decompileParallel() runs its workers
+    QMutex m_claimLock;                         //!< Guards the members below
+    QWaitCondition m_claimsReleased;            //!< Signalled when a worker finishes its unit and releases its procs
+    std::map<UserProc *, size_t> m_procOwners;  //!< Procs claimed by the workers, by unit (see claimProc)
+    std::vector<bool> m_unitDone;               //!< The units of decompileParallel that have finished, in serial order
+    std::vector<size_t> m_unitsFinished;        //!< Units that finished since the scheduler last looked
+    size_t m_unitsDoneInOrder = 0;              //!< Number of units at the front of the serial order that have finished
 
     friend class XMLProgParser;
+    friend class DecompileCache;
+    friend class ProgSerializer;
+    friend class Global;
 }; // class Prog
 
 #endif
@@ -0,0 +1,112 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       progserializer.h
+  * \brief   Compact binary (QDataStream based) encoding of expressions, types, signatures and decoded programs.
+  ******************************************************************************/
+#ifndef PROGSERIALIZER_H
+#define PROGSERIALIZER_H
+
+#include <QtCore/QDataStream>
+#include <QtCore/QHash>
+#include <QtCore/QByteArray>
+#include <map>
+#include <memory>
+#include <vector>
+#include <utility>
+
+class Exp;
+class RefExp;
+class Type;
+class Signature;
+class Prog;
+class Function;
+class UserProc;
+class Instruction;
+class StatementList;
+typedef std::shared_ptr<Exp> SharedExp;
+typedef std::shared_ptr<const Exp> SharedConstExp;
+typedef std::shared_ptr<Type> SharedType;
+typedef std::shared_ptr<const Type> SharedConstType;
+
+/***************************************************************************/ /**
+  * ProgSerializer writes and reads the value parts of the intermediate representation. Each node is written as a
+  * one byte tag followed by its fields, so the encoding of a given tree is deterministic and can be hashed.
+  * Nodes that refer to other parts of the program are written by name or address, and are resolved against \a prog
+  * when read back:
+  *  - function constants by the native address of the procedure,
+  *  - Locations are reattached to \a proc,
+  *  - subscripts keep only the number of their definition; they read back as implicit ({-}) references, except
+  *    in writeProg() and readProg(), which write the position of the definition among the statements of its
+  *    procedure and restore it.
+  *
+  * Anything that cannot be encoded (e.g. a FlagDef) marks the serializer as failed; test ok() after writing.
+  * Reading corrupt data sets the status of the stream to QDataStream::ReadCorruptData.
+  *
+  * writeProg() saves a whole decoded program (modules, procedures, globals and the CFGs with their RTLs). While it
+  * runs, expressions and types are written once into dedup tables that are interleaved with the data: the first use
+  * of a distinct (sub)tree emits its definition, every use is then a table index. readProg() reads the stream
+  * front to back, so nothing has to be held in memory but the tables; each use reads back as a fresh copy.
+  ******************************************************************************/
+class ProgSerializer {
+    Prog *prog;
+    UserProc *proc;
+    bool failed = false;
+    QDataStream *defs = nullptr;              //!< Where table definitions go; set while writeProg runs
+    QHash<QByteArray, quint32> expIds;        //!< Encoded node -> table index, when writing
+    QHash<QByteArray, quint32> typeIds;
+    std::vector<std::pair<SharedExp, UserProc *>> expTable; //!< Table entries and the procedure they were read in
+    std::vector<SharedType> typeTable;
+    std::vector<Function *> procs;            //!< Procedures by index
+    std::map<Function *, qint32> procIds;
+    std::map<Instruction *, qint32> stmtIds;  //!< Position of the statements of the procedure writeProg is writing
+    bool readingProg = false;                 //!< Set while readProg runs
+    int defining = 0;                         //!< Nesting of table definitions being read
+    std::map<const Exp *, qint32> refDefs;    //!< Definition position of the subscripts in the expression table
+    std::vector<std::pair<std::shared_ptr<RefExp>, qint32>> procRefs; //!< Subscripts to resolve at the end of a CFG
+
+public:
+    ProgSerializer(Prog *_prog, UserProc *_proc = nullptr) : prog(_prog), proc(_proc) {}
+
+    bool ok() const { return !failed; }
+
+    void writeExp(QDataStream &os, const SharedConstExp &e);
+    SharedExp readExp(QDataStream &is);
+
+    void writeType(QDataStream &os, const SharedConstType &ty);
+    SharedType readType(QDataStream &is);
+
+    void writeSignature(QDataStream &os, const std::shared_ptr<Signature> &sig);
+    std::shared_ptr<Signature> readSignature(QDataStream &is);
+
+    bool writeProg(QDataStream &os);
+    bool readProg(QDataStream &is);
+
+private:
+    void writeExpNode(QDataStream &os, const SharedConstExp &e);
+    SharedExp readExpNode(QDataStream &is, quint8 tag);
+    void writeTypeNode(QDataStream &os, const SharedConstType &ty);
+    SharedType readTypeNode(QDataStream &is, quint8 id);
+    quint32 internExp(const SharedConstExp &e);
+    quint32 internType(const SharedConstType &ty);
+
+    bool readProgBody(QDataStream &is);
+    void writeProc(QDataStream &os, Function *f);
+    bool readProc(QDataStream &is, Function *f);
+    void writeCfg(QDataStream &os, UserProc *up);
+    bool readCfg(QDataStream &is, UserProc *up);
+    void writeStatement(QDataStream &os, Instruction *s);
+    Instruction *readStatement(QDataStream &is);
+    void writeStatements(QDataStream &os, StatementList &stmts);
+    bool readStatements(QDataStream &is, StatementList &stmts);
+    void noteRefs(const SharedExp &from, const SharedExp &to);
+    Function *procAt(QDataStream &is, qint32 idx);
+    qint32 procId(Function *f) const;
+};
+
+#endif // PROGSERIALIZER_H
@@ -19,6 +19,7 @@
 
 #include <QtCore/QObject>
 #include <QtCore/QIODevice>
+#include <QtCore/QFile>
 
 class Prog;
 class IBinaryImage;
@@ -26,18 +27,26 @@ class IBinaryImage;
 class Project : public QObject, public IProject {
     Q_OBJECT
     QByteArray file_bytes;
+    QFile mapped_file;           //!< Backing file of file_bytes when it is a view of a mapping
+    uchar *mapping = nullptr;    //!< Private (copy-on-write) mapping of mapped_file, or nullptr
     IBinaryImage *Image=nullptr; // raw memory interface
-    Prog *Program; // program interface
+    Prog *Program = nullptr; // program interface
     ITypeRecovery *type_recovery_engine;
 public:
     virtual ~Project();
     bool serializeTo(QIODevice &dev);
     bool serializeFrom(QIODevice &dev);
 
+    Prog *prog() { return Program; }
+    void setProg(Prog *p) { Program = p; }
+
     QByteArray &filedata() override { return file_bytes; }
+    bool loadFile(const QString &path) override;
     IBinaryImage *image() override;
 
     ITypeRecovery *typeEngine() override { return type_recovery_engine; }
     void typeEngine(ITypeRecovery *e) override { type_recovery_engine=e; }
+private:
+    void unloadFile();
 };
 #endif
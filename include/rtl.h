@@ -25,6 +25,7 @@
 #include "register.h"                   // for Register
 #include "type.h"                       // for Type
 #include "types.h"                      // for ADDRESS
+#include "arena.h"                      // for Arena
 
 #include <functional>                   // for less
 #include <list>                         // for list
@@ -58,6 +59,9 @@ public:
     RTL(const RTL &other); // Makes deep copy of "other"
     ~RTL();
 
+    static void *operator new(size_t size) { return Arena::allocate(size); } // from the current Arena, if any
+    static void operator delete(void *p) { Arena::deallocate(p); }
+
     RTL *clone() const;
     RTL &operator=(const RTL &other);
 
@@ -79,7 +83,7 @@ public:
     Instruction *getHlStmt();
     char *prints() const; // Print to a string (mainly for debugging)
 protected:
-    void simplify();
+    bool simplify(); //!< \returns true if statements were removed or replaced
     friend class XMLProgParser;
     friend class BasicBlock;
 };
@@ -103,10 +107,18 @@ public:
     // non-zero return indicates failure
     int appendRTL(std::list<QString> &p, RTL &rtl);
 
+    void compile();
+
 public:
     std::list<QString> params;
     RTL rtl;
 
+    //! Instantiation plan, built once by compile() after the SSL file is read
+    std::vector<SharedExp> formals;            //!< One opParam pattern per entry of params
+    std::vector<std::vector<int>> stmtParams;  //!< Per template statement: indices of the formals it uses
+    bool needsPostVars = true;                 //!< False if transformPostVars can never change an instance
+    bool compiled      = false;
+
 #define TEF_NEXTPC 1
     int flags; // aka required capabilities. Init. to 0
 };
@@ -152,12 +164,14 @@ public:
     std::list<Instruction *> *instantiateRTL(const QString &name, ADDRESS natPC, const std::vector<SharedExp> &actuals);
     std::list<Instruction *> *instantiateRTL(RTL &rtls, ADDRESS, std::list<QString> &params,
                                              const std::vector<SharedExp> &actuals);
+    std::list<Instruction *> *instantiateRTL(TableEntry &entry, const std::vector<SharedExp> &actuals);
 
     void transformPostVars(std::list<Instruction *> &rts, bool optimise);
     void print(QTextStream &os);
     void addRegister(const QString &name, int id, int size, bool flt);
     bool partialType(Exp *exp, Type &ty);
     void fixupParams();
+    void compileTemplates();
 
 public:
     //! A map from the symbolic representation of a register (e.g. "%g0") to its index within an array of registers.
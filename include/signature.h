@@ -121,11 +121,11 @@ class Signature : public std::enable_shared_from_this<Signature> {
     // get the return location
     virtual void addReturn(SharedType type, SharedExp e = nullptr);
     virtual void addReturn(SharedExp e);
-    virtual void addReturn(std::shared_ptr<Return> ret) { returns.emplace_back(ret); }
+    virtual void addReturn(std::shared_ptr<Return> ret);
     virtual void removeReturn(SharedExp e);
     virtual size_t getNumReturns() { return returns.size(); }
     virtual SharedExp getReturnExp(size_t n) { return returns[n]->exp; }
-    void setReturnExp(size_t n, SharedExp e) { returns[n]->exp = e; }
+    void setReturnExp(size_t n, SharedExp e);
     virtual SharedType getReturnType(size_t n) { return returns[n]->type; }
     virtual void setReturnType(size_t n, SharedType ty);
     int findReturn(SharedExp e);
@@ -246,6 +246,7 @@ class Signature : public std::enable_shared_from_this<Signature> {
 
   protected:
     friend class XMLProgParser;
+    friend class ProgSerializer;
     Signature() : name(""), rettype(nullptr), ellipsis(false), preferedReturn(nullptr), preferedName("") {}
     void appendParameter(std::shared_ptr<Parameter> p) { params.emplace_back(p); }
     // void        appendImplicitParameter(ImplicitParameter *p) { implicitParams.push_back(p); }
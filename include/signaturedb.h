@@ -0,0 +1,62 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       signaturedb.h
+  * \brief   Compiled, memory mapped form of the library signature catalogs.
+  ******************************************************************************/
+#ifndef SIGNATUREDB_H
+#define SIGNATUREDB_H
+
+#include <QtCore/QByteArray>
+#include <QtCore/QFile>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QString>
+#include <memory>
+#include <utility>
+
+class Type;
+class Signature;
+typedef std::shared_ptr<Type> SharedType;
+
+/***************************************************************************/ /**
+  * SignatureDb holds what parsing the library catalogs (the .hs files in signatures/) and the headers they list
+  * produces: the named types, and the signature of every library function. FrontEnd::readLibraryCatalog writes one
+  * on the first run with a given set of catalogs and headers, and opens it on later runs instead of parsing the
+  * headers again.
+  *
+  * The file starts with a key (a digest of the catalogs and of the names, sizes and times of the headers), so a
+  * changed header makes a new database. It is memory mapped when it is opened; only the named types and the index
+  * of function names are read then. A signature is decoded by get(), the first time a call needs it.
+  ******************************************************************************/
+class SignatureDb {
+public:
+    SignatureDb() = default;
+    ~SignatureDb() { close(); }
+
+    bool open(const QString &path, const QByteArray &key, QMap<QString, SharedType> &types);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+    std::shared_ptr<Signature> get(const QString &name) const;
+
+    static bool write(const QString &path, const QByteArray &key, const QMap<QString, SharedType> &types,
+                      const QMap<QString, std::shared_ptr<Signature>> &signatures);
+
+private:
+    QFile file;
+    QByteArray contents; //!< the file, where it could not be mapped
+    const uchar *data = nullptr;
+    qint64 size = 0;
+    qint64 recordsStart = 0;
+    QHash<QString, std::pair<quint32, quint32>> index; //!< function name -> offset and length of its signature
+
+    SignatureDb(const SignatureDb &) = delete;
+    SignatureDb &operator=(const SignatureDb &) = delete;
+};
+
+#endif // SIGNATUREDB_H
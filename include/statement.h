@@ -32,6 +32,7 @@
 #include "types.h"
 #include "managed.h"
 #include "dataflow.h"  // For embedded objects DefCollector and UseCollector
+#include "arena.h"
 //#include "boomerang.h" // For USE_DOMINANCE_NUMS etc
 
 #include <QtCore/QTextStream>
@@ -139,6 +140,12 @@ public:
     Instruction() : Parent(nullptr), proc(nullptr), Number(0) {} //, parent(nullptr)
     virtual ~Instruction() {}
 
+    // Statements come from the current Arena, if any
+    static void *operator new(size_t size) { return Arena::allocate(size); }
+    static void operator delete(void *p) { Arena::deallocate(p); }
+    static void *operator new(size_t, void *where) { return where; } // for PhiAssign::convertToAssign
+    static void operator delete(void *, void *) {}
+
     // get/set the enclosing BB, etc
     BasicBlock *getBB() { return Parent; }
     const BasicBlock *getBB() const { return Parent; }
@@ -285,7 +292,7 @@ public:
 
     void addUsedLocs(LocationSet &used, bool cc = false, bool memOnly = false);
     bool addUsedLocals(LocationSet &used);
-    void bypass();
+    bool bypass();
     bool replaceRef(SharedExp e, Assignment *def, bool &convert);
     void findConstants(std::list<std::shared_ptr<Const> > &lc);
     int setConscripts(int n);
@@ -898,6 +905,7 @@ public:
     void dfaTypeAnalysis(bool &ch) override;
 
     friend class XMLProgParser;
+    friend class ProgSerializer;
 }; // class BranchStatement
 
 /***************************************************************************/ /**
@@ -1020,7 +1028,7 @@ public:
     // void        ignoreReturn(SharedExp e);
     // void        ignoreReturn(int n);
     // void        addReturn(SharedExp e, Type* ty = nullptr);
-    void updateDefines();         // Update the defines based on a callee change
+    bool updateDefines();         // Update the defines based on a callee change
     StatementList *calcResults(); // Calculate defines(this) isect live(this)
     ReturnStatement *getCalleeReturn() { return calleeReturn; }
     void setCalleeReturn(ReturnStatement *ret) { calleeReturn = ret; }
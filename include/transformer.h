@@ -7,20 +7,29 @@
   ******************************************************************************/
 
 #pragma once
-#include <list>
+#include <vector>
 #include <memory>
 class Exp;
 using SharedExp = std::shared_ptr<Exp>;
+using SharedConstExp = std::shared_ptr<const Exp>;
 class ExpTransformer {
   protected:
-    static std::list<ExpTransformer *> transformers;
+    static std::vector<ExpTransformer *> transformers; //!< In the order they are applied
 
   public:
     ExpTransformer();
     virtual ~ExpTransformer() {} // Prevent gcc4 warning
 
     static void loadAll();
+    static bool isLoaded();
 
     virtual SharedExp applyTo(SharedExp e, bool &bMod) = 0;
+    //! The shape of the expressions this transformer can change (opVar matches anything); nullptr if not known
+    virtual SharedConstExp pattern() const { return nullptr; }
     static SharedExp applyAllTo(const SharedExp &e, bool &bMod);
+    friend class TransformerTest;
+
+  private:
+    static void load();
+    static void compileRules();
 };
@@ -189,6 +189,8 @@ public:
     // Clear the named type map. This is necessary when testing; the
     // type for the first parameter to 'main' is different for sparc and pentium
     static void clearNamedTypes();
+    static const QMap<QString, SharedType> &getNamedTypes() { return namedTypes; }
+    static void setNamedTypes(const QMap<QString, SharedType> &types) { namedTypes = types; }
 
     bool isPointerToAlpha();
 
@@ -581,6 +583,7 @@ public:
 
 protected:
     friend class XMLProgParser;
+    friend class ProgSerializer;
 }; // class CompoundType
 
 // The union type represents the union of any number of any other types
@@ -39,15 +39,12 @@ QObject *BinaryFileFactory::Load(const QString &sName) {
     }
     ldr_iface->initialize(boom);
     ldr_iface->Close();
-    QFile src_file(sName);
-    if(false==src_file.open(QFile::ReadOnly)) {
+    if(false==boom->project()->loadFile(sName)) {
         qWarning() << "Opening '" <<sName<< "' failed";
         delete pBF;
         return nullptr;
     }
 
-    boom->project()->filedata().clear();
-    boom->project()->filedata()=src_file.readAll();
     if (ldr_iface->LoadFromMemory(boom->project()->filedata()) == 0) {
         qWarning() << "Loading '" <<sName<< "' failed";
         delete pBF;
@@ -127,9 +127,9 @@ bool ElfBinaryFile::LoadFromMemory(QByteArray &img) {
 
     m_lImageSize = img.size();
 
-    // Allocate memory to hold the file
-    m_pImage = img.data();
-    Elf32_Ehdr *pHeader = (Elf32_Ehdr *)img.data(); // Save a lot of casts
+    // Work directly on the (copy-on-write) view of the file; img.data() would force a private copy of all of it
+    m_pImage = const_cast<char *>(img.constData());
+    Elf32_Ehdr *pHeader = (Elf32_Ehdr *)m_pImage; // Save a lot of casts
 
     // Basic checks
     if (strncmp(m_pImage, "\x7F"
@@ -439,7 +439,9 @@ bool Win32BinaryFile::LoadFromMemory(QByteArray &arr) {
 
     // Note: all tmphdr fields will be little endian
 
-    base = (char *)malloc(LMMH(tmphdr->ImageSize));
+    // calloc'd memory is zero already and, for large sizes, only committed when touched; so BSS and the tails of
+    // sections past their raw data cost nothing until they are used
+    base = (char *)calloc(LMMH(tmphdr->ImageSize), 1);
 
     if (!base) {
         fprintf(stderr, "Cannot allocate memory for copy of image\n");
@@ -472,7 +474,6 @@ bool Win32BinaryFile::LoadFromMemory(QByteArray &arr) {
     for (unsigned i = 0; i < numSections; i++, o++) {
         SectionParam sect;
         // TODO: Check for unreadable sections (!IMAGE_SCN_MEM_READ)?
-        memset(base + LMMH(o->RVA), 0, LMMH(o->VirtualSize));
         memcpy(base + LMMH(o->RVA), data+LMMH(o->PhysicalOffset), LMMH(o->PhysicalSize));
 
         sect.Name = QByteArray(o->ObjectName,8);
@@ -24,7 +24,6 @@
 #include <cassert>
 #include <cstring>
 #include <QFile>
-#include <QBuffer>
 
 // Macro to convert a pointer to a Big Endian integer into a host integer
 #define UC(p) ((unsigned char *)p)
@@ -35,7 +34,6 @@ HpSomBinaryFile::HpSomBinaryFile() : m_pImage(0) {
 }
 
 HpSomBinaryFile::~HpSomBinaryFile() {
-    delete [] m_pImage;
 }
 
 void HpSomBinaryFile::initialize(IBoomerang *sys)
@@ -182,29 +180,14 @@ void HpSomBinaryFile::processSymbols()
 }
 
 bool HpSomBinaryFile::LoadFromMemory(QByteArray &imgdata) {
-    QBuffer fp(&imgdata);
-    fp.open(QBuffer::ReadOnly);
-    if (!fp.open(QFile::ReadOnly)) {
-        fprintf(stderr, "Could not open binary file \n");
-        return false;
-    }
-
-    long size = fp.size();
-
-    // Allocate a buffer for the image
-    m_pImage = new unsigned char[size];
-    if (m_pImage == 0) {
-        fprintf(stderr, "Could not allocate %ld bytes for image\n", size);
-        return false;
-    }
-    memset(m_pImage, 0, size);
-
-
-    if (fp.read((char *)m_pImage, size) != (unsigned)size) {
+    if (imgdata.size() < 0x70) {
         fprintf(stderr, "Error reading binary file\n");
         return false;
     }
 
+    // The image is used in place; it is owned by the project, so it is not freed here
+    m_pImage = (unsigned char *)imgdata.constData();
+
     // Check type at offset 0x0; should be 0x0210 or 0x20B then
     // 0107, 0108, or 010B
     unsigned magic = UINT4(m_pImage);
@@ -402,10 +385,7 @@ int HpSomBinaryFile::canLoad(QIODevice & dev) const
 }
 
 void HpSomBinaryFile::UnLoad() {
-    if (m_pImage) {
-        delete[] m_pImage;
-        m_pImage = 0;
-    }
+    m_pImage = 0;
 }
 
 ADDRESS HpSomBinaryFile::GetEntryPoint() {
@@ -98,7 +98,7 @@ bool MachOBinaryFile::LoadFromMemory(QByteArray &img) {
         return false;
     unsigned int imgoffs = 0;
 
-    unsigned char *magic = (uint8_t *)img.data();
+    const unsigned char *magic = (const uint8_t *)img.constData();
     struct mach_header *header; // The Mach-O header
 
     if (magic[0] == 0xca && magic[1] == 0xfe && magic[2] == 0xba && magic[3] == 0xbe) {
@@ -122,7 +122,7 @@ bool MachOBinaryFile::LoadFromMemory(QByteArray &img) {
         }
     }
 
-    header = (mach_header *)(img.data() + imgoffs);// new mach_header;
+    header = (mach_header *)(img.constData() + imgoffs);// new mach_header;
     //fp.read((char *)header, sizeof(mach_header));
 
     if ((header->magic != MH_MAGIC) && (_BMMH(header->magic) != MH_MAGIC)) {
@@ -251,7 +251,9 @@ bool MachOBinaryFile::LoadFromMemory(QByteArray &img) {
     loaded_addr = BMMH(lowest->vmaddr);
     loaded_size = BMMH(highest->vmaddr) - BMMH(lowest->vmaddr) + BMMH(highest->vmsize);
 
-    base = (char *)malloc(loaded_size);
+    // calloc'd memory is zero already and, for large sizes, only committed when touched, so zerofill segments cost
+    // nothing until they are read
+    base = (char *)calloc(loaded_size, 1);
 
     if (!base) {
         qWarning() << "Cannot allocate memory for copy of image";
@@ -263,7 +265,6 @@ bool MachOBinaryFile::LoadFromMemory(QByteArray &img) {
         ADDRESS a = ADDRESS::g(BMMH(segments[i].vmaddr));
         unsigned sz = BMMH(segments[i].vmsize);
         unsigned fsz = BMMH(segments[i].filesize);
-        memset(base + a.m_value - loaded_addr.m_value, 0, sz);
         fp.read(base + a.m_value - loaded_addr.m_value, fsz);
         DEBUG_PRINT("loaded segment %tx %i in mem %i in file\n", a.m_value, sz, fsz);
         QString name = QByteArray(segments[i].segname,17);
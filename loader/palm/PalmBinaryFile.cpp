@@ -81,7 +81,7 @@ struct SectionParams {
 bool PalmBinaryFile::LoadFromMemory(QByteArray &img) {
     long size = img.size();
 
-    m_pImage = (uint8_t *)img.data();
+    m_pImage = (uint8_t *)img.constData(); // img.data() would copy the whole mapped file
 
     // Check type at offset 0x3C; should be "appl" (or "palm"; ugh!)
     if ((strncmp((char *)(m_pImage + 0x3C), "appl", 4) != 0) && (strncmp((char *)(m_pImage + 0x3C), "panl", 4) != 0) &&
@@ -5,8 +5,21 @@
 #include "managed.h"
 #include "boomerang.h"
 
+#include <QFile>
 #include <QTextStream>
+#include <QThread>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
 #include <sstream>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 Log &Log::operator<<(const Instruction *s) {
     QString tgt;
     QTextStream st(&tgt);
@@ -76,15 +89,194 @@ Log &Log::operator<<(ADDRESS a) {
 }
 
 Log &FileLogger::operator<<(const QString &str) {
-    out << str.toStdString() << std::flush;
+    LogWriter::get().write(channel, str);
     return *this;
 }
+FileLogger::~FileLogger() { LogWriter::get().close(channel); }
 
 Log &SeparateLogger::operator<<(const QString &str) {
-    (*out) << str.toStdString() << std::flush;
+    LogWriter::get().write(channel, str);
     return *this;
 }
 SeparateLogger::~SeparateLogger() {
-    out->close();
-    out = nullptr;
+    if (channel >= 0)
+        LogWriter::get().close(channel);
+}
+
+class LogWriterThread : public QThread {
+    LogWriter *writer;
+
+public:
+    explicit LogWriterThread(LogWriter *w) : writer(w) {}
+    void run() override { writer->run(); }
+};
+
+namespace {
+LogWriter *crashWriter = nullptr; //!< Set by installCrashHandlers()
+
+//! write(2) all of \a n bytes at \a p to \a fd; usable from a signal handler
+void writeAll(int fd, const char *p, size_t n) {
+    while (n > 0) {
+        auto done = ::write(fd, p, n);
+        if (done < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        p += done;
+        n -= size_t(done);
+    }
+}
+
+void writeLogOnCrash(int sig) {
+    if (crashWriter)
+        crashWriter->writeOnCrash();
+    std::signal(sig, SIG_DFL);
+    std::raise(sig);
+}
+}
+
+LogWriter::LogWriter() : ring(CAPACITY) {
+    thread = new LogWriterThread(this);
+    thread->start();
+}
+
+/// \returns the writer, started the first time
+LogWriter &LogWriter::get() {
+    // Never destroyed: loggers may still write from static destructors, after shutdown()
+    static LogWriter *writer = start();
+    return *writer;
+}
+
+LogWriter *LogWriter::start() {
+    LogWriter *writer = new LogWriter;
+    std::atexit([] { LogWriter::get().shutdown(); });
+    return writer;
+}
+
+/// Have a crash write out what is still queued before the program dies. The handlers are process wide, so this is
+/// for the program to ask for (see Boomerang::startFileLog), not for whoever happens to log first
+void LogWriter::installCrashHandlers() {
+    crashWriter = &get();
+#ifdef _WIN32
+    for (int sig : {SIGSEGV, SIGABRT, SIGFPE, SIGILL})
+        std::signal(sig, writeLogOnCrash);
+#else
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = writeLogOnCrash;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESETHAND | SA_NODEFER; // The handler raises the signal again, for its default action
+    for (int sig : {SIGSEGV, SIGABRT, SIGFPE, SIGILL})
+        sigaction(sig, &sa, nullptr);
+#endif
+}
+
+/// \returns a new channel, for the file at \a path, or -1 if it cannot be opened (the text for it is dropped)
+int LogWriter::open(const QString &path) {
+    // Anything still queued for an earlier file at the same path goes out before it is truncated
+    flush();
+    return ::open(QFile::encodeName(path).constData(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+void LogWriter::write(int channel, const QString &text) {
+    if (channel >= 0 && !text.isEmpty())
+        enqueue(channel, TEXT, text.toUtf8());
+}
+
+/// Close the file of \a channel, once the text queued for it is written
+void LogWriter::close(int channel) {
+    if (channel >= 0)
+        enqueue(channel, CLOSE, QByteArray());
+}
+
+void LogWriter::enqueue(int channel, RecordKind kind, const QByteArray &text) {
+    QMutexLocker locker(&lock);
+    if (stopped) {
+        std::vector<Record> batch{Record{channel, kind, text}};
+        writeRecords(batch);
+        return;
+    }
+    if (kind == TEXT && count > 0) {
+        // Append to the last record if it is for the same channel, so a message logged piecemeal is one record
+        Record &last(ring[(head + count - 1) % CAPACITY]);
+        if (last.kind == TEXT && last.channel == channel && pendingChars + text.size() <= MAX_PENDING) {
+            last.text += text;
+            pendingChars += text.size();
+            return;
+        }
+    }
+    while (count == CAPACITY || (count > 0 && pendingChars + text.size() > MAX_PENDING))
+        notFull.wait(&lock);
+    ring[(head + count) % CAPACITY] = Record{channel, kind, text};
+    ++count;
+    ++queued;
+    pendingChars += text.size();
+    notEmpty.wakeOne();
+}
+
+/// Wait until everything queued so far is written
+void LogWriter::flush() {
+    QMutexLocker locker(&lock);
+    quint64 target = queued;
+    while (written < target && !stopped)
+        progress.wait(&lock);
+}
+
+/// Write everything queued and stop the writer thread; later records are written as they are queued
+void LogWriter::shutdown() {
+    {
+        QMutexLocker locker(&lock);
+        if (stopped)
+            return;
+        stopped = true; // Tells the writer to stop once the ring is empty
+        notEmpty.wakeAll();
+    }
+    thread->wait();
+}
+
+/// From a signal handler: write(2) the text still in the ring. Nothing else is safe there, so the ring is read
+/// without the lock; best effort, since the crash may be in the middle of logging, and text the writer thread has just
+/// taken from the ring may be lost.
+void LogWriter::writeOnCrash() {
+    static std::atomic_flag once = ATOMIC_FLAG_INIT;
+    if (once.test_and_set())
+        return; // Another thread crashed as well
+    int n = count, first = head;
+    for (int i = 0; i < n; ++i) {
+        const Record &r(ring[(first + i) % CAPACITY]);
+        if (r.kind == TEXT)
+            writeAll(r.channel, r.text.constData(), size_t(r.text.size()));
+    }
+}
+
+void LogWriter::run() {
+    std::vector<Record> batch;
+    QMutexLocker locker(&lock);
+    for (;;) {
+        while (count == 0 && !stopped)
+            notEmpty.wait(&lock);
+        if (count == 0)
+            return; // Stopped, and all written
+        for (; count > 0; --count, head = (head + 1) % CAPACITY)
+            batch.push_back(std::move(ring[head]));
+        pendingChars = 0;
+        notFull.wakeAll();
+        locker.unlock();
+        writeRecords(batch);
+        locker.relock();
+        written += batch.size();
+        batch.clear();
+        progress.wakeAll();
+    }
+}
+
+void LogWriter::writeRecords(std::vector<Record> &batch) {
+    // Straight to the file descriptors: nothing is buffered in the process, so little is lost if it dies
+    for (Record &r : batch) {
+        if (r.kind == TEXT)
+            writeAll(r.channel, r.text.constData(), size_t(r.text.size()));
+        else
+            ::close(r.channel);
+    }
 }
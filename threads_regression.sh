@@ -0,0 +1,9 @@
+#!/bin/bash
+# Decompile the regression inputs one procedure at a time, then with --threads, and compare the generated code:
+# the two runs should give the same output, byte for byte.
+THREADS=${1:-4}
+
+./regression_tester.py ./out/boomerang || exit 1
+./regression_tester.py ./out/boomerang --threads $THREADS || exit 1
+# regression_tester.py moves the outputs of the previous run to tests/outputs_prev
+diff -r -x '*.log' -x '*.stdout' -x '*.stderr' tests/outputs_prev tests/outputs
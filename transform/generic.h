@@ -21,6 +21,7 @@ class GenericExpTransformer : public ExpTransformer {
   public:
     GenericExpTransformer(SharedExp _match, SharedExp _where, SharedExp _become) : match(_match), where(_where), become(_become) {}
     virtual SharedExp applyTo(SharedExp e, bool &bMod);
+    SharedConstExp pattern() const override { return match; }
 };
 
 #endif
@@ -30,3 +30,11 @@ SharedExp RDIExpTransformer::applyTo(SharedExp e, bool &bMod) {
     }
     return e;
 }
+
+SharedConstExp RDIExpTransformer::pattern() const {
+    static SharedConstExp addrOfMemOf = [] {
+        Arena::Scope heap(nullptr); // The first call may come while a procedure's arena is current
+        return Unary::get(opAddrOf, Location::memOf(Terminal::get(opWild)));
+    }();
+    return addrOfMemOf;
+}
@@ -16,6 +16,7 @@ class RDIExpTransformer : public ExpTransformer {
   public:
     RDIExpTransformer() {}
     virtual SharedExp applyTo(SharedExp e, bool &bMod);
+    SharedConstExp pattern() const override;
 };
 
 #endif
@@ -0,0 +1,103 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       ruleindex.cpp
+  * \brief   Implementation of the RuleIndex class.
+  ******************************************************************************/
+
+#include "ruleindex.h"
+
+#include "exp.h"
+
+#include <algorithm>
+
+namespace {
+//! True for the parts of a pattern that match any subexpression
+bool isVariable(const Exp *e) { return e->getOper() == opVar || e->getOper() == opWild; }
+}
+
+void RuleIndex::clear() {
+    root.children.clear();
+    root.any.reset();
+    root.rules.clear();
+    anywhere.clear();
+    numRules = 0;
+}
+
+/// Add \a rule, which can only match expressions of the shape of \a pattern (anything, if \a pattern is nullptr)
+void RuleIndex::add(const SharedConstExp &pattern, size_t rule) {
+    ++numRules;
+    if (pattern == nullptr) {
+        anywhere.push_back(rule);
+        return;
+    }
+    Node *n = &root;
+    std::vector<const Exp *> todo{pattern.get()};
+    while (!todo.empty()) {
+        const Exp *p = todo.back();
+        todo.pop_back();
+        if (isVariable(p)) {
+            if (n->any == nullptr)
+                n->any.reset(new Node);
+            n = n->any.get();
+            continue;
+        }
+        int arity = p->getArity();
+        std::unique_ptr<Node> &child(n->children[Key(p->getOper(), arity)]);
+        if (child == nullptr)
+            child.reset(new Node);
+        n = child.get();
+        // Subexpressions in preorder, so the first is taken next
+        if (arity >= 3)
+            todo.push_back(p->getSubExp3().get());
+        if (arity >= 2)
+            todo.push_back(p->getSubExp2().get());
+        if (arity >= 1)
+            todo.push_back(p->getSubExp1().get());
+    }
+    n->rules.push_back(rule);
+}
+
+/// Set \a result to the rules that may match \a e, in increasing order
+void RuleIndex::candidates(const SharedConstExp &e, std::vector<size_t> &result) const {
+    result = anywhere;
+    std::vector<Symbol> symbols;
+    flatten(e.get(), symbols);
+    collect(&root, symbols, 0, result);
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+}
+
+void RuleIndex::flatten(const Exp *e, std::vector<Symbol> &symbols) {
+    size_t at = symbols.size();
+    int arity = e->getArity();
+    symbols.push_back(Symbol{Key(e->getOper(), arity), 0});
+    SharedConstExp subs[3];
+    if (arity >= 1)
+        subs[0] = e->getSubExp1();
+    if (arity >= 2)
+        subs[1] = e->getSubExp2();
+    if (arity >= 3)
+        subs[2] = e->getSubExp3();
+    for (const SharedConstExp &sub : subs)
+        if (sub)
+            flatten(sub.get(), symbols);
+    symbols[at].end = symbols.size();
+}
+
+void RuleIndex::collect(const Node *n, const std::vector<Symbol> &symbols, size_t pos, std::vector<size_t> &result) {
+    if (pos == symbols.size()) {
+        result.insert(result.end(), n->rules.begin(), n->rules.end());
+        return;
+    }
+    if (n->any)
+        collect(n->any.get(), symbols, symbols[pos].end, result);
+    auto it = n->children.find(symbols[pos].key);
+    if (it != n->children.end())
+        collect(it->second.get(), symbols, pos + 1, result);
+}
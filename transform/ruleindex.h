@@ -0,0 +1,62 @@
+/*
+ * See the file "LICENSE.TERMS" for information on usage and
+ * redistribution of this file, and for a DISCLAIMER OF ALL
+ * WARRANTIES.
+ *
+ */
+
+/***************************************************************************/ /**
+  * \file       ruleindex.h
+  * \brief   Provides the definition of the RuleIndex class, a discrimination tree over transformer patterns.
+  ******************************************************************************/
+
+#ifndef RULEINDEX_H
+#define RULEINDEX_H
+
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+class Exp;
+using SharedConstExp = std::shared_ptr<const Exp>;
+
+/***************************************************************************/ /**
+  * RuleIndex finds the rules whose pattern may match an expression, without trying each one. Patterns are stored in a
+  * discrimination tree: the path to a rule is its pattern in preorder, one (operator, arity) key per node, with a
+  * wildcard edge for each variable (which matches a whole subexpression). An expression is looked up along the same
+  * keys, following the wildcard edges as well.
+  *
+  * Constants, types and the like are not part of the keys, so the candidates are a superset of the rules that match;
+  * the rule itself still has to check (Exp::match and its where clause).
+  ******************************************************************************/
+class RuleIndex {
+public:
+    void clear();
+    void add(const SharedConstExp &pattern, size_t rule);
+    void candidates(const SharedConstExp &e, std::vector<size_t> &result) const;
+    //! Number of rules added
+    size_t size() const { return numRules; }
+
+private:
+    typedef std::pair<int, int> Key; //!< Operator and arity
+    struct Node {
+        std::map<Key, std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> any; //!< A variable: skips one whole subexpression
+        std::vector<size_t> rules; //!< Rules whose pattern ends here
+    };
+    //! A node of the expression looked up, in preorder
+    struct Symbol {
+        Key key;
+        size_t end; //!< Index of the first symbol after this subexpression
+    };
+
+    Node root;
+    std::vector<size_t> anywhere; //!< Rules without a pattern, candidates for every expression
+    size_t numRules = 0;
+
+    static void flatten(const Exp *e, std::vector<Symbol> &symbols);
+    static void collect(const Node *n, const std::vector<Symbol> &symbols, size_t pos, std::vector<size_t> &result);
+};
+
+#endif
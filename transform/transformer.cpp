@@ -12,11 +12,13 @@
 #include "statement.h"
 #include "cfg.h"
 #include "exp.h"
+#include "exphelp.h"
 #include "register.h"
 #include "rtl.h"
 #include "proc.h"
 #include "boomerang.h"
 #include "rdi.h"
+#include "ruleindex.h"
 #include "log.h"
 #include "transformation-parser.h"
 
@@ -28,23 +30,56 @@
 #include <algorithm> // For std::max()
 #include <map>       // In decideType()
 #include <sstream>   // Need gcc 3.0 or better
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
 
-std::list<ExpTransformer *> ExpTransformer::transformers;
+std::vector<ExpTransformer *> ExpTransformer::transformers;
 
 ExpTransformer::ExpTransformer() { transformers.push_back(this); }
 
-std::list<SharedExp> cache;
+namespace {
+//! The transformers that may apply to an expression, by the shape of their patterns; see compileRules. Built once by
+//! loadAll, before any thread reads it
+RuleIndex ruleIndex;
+std::once_flag loadOnce;
+std::atomic<bool> rulesLoaded(false);
 
+//! Results of applyAllTo, and whether they differ from the input
+struct MemoEntry {
+    SharedExp result;
+    bool modified;
+};
+const size_t MEMO_CAPACITY = 1 << 16; //!< Entries kept per thread; the memo starts afresh when it is full
+thread_local std::unordered_map<SharedConstExp, MemoEntry, hashExpStar, equalExpStar> memo;
+}
+
+/// Index the transformers by their patterns; done once, by loadAll
+void ExpTransformer::compileRules() {
+    ruleIndex.clear();
+    for (size_t i = 0; i < transformers.size(); ++i)
+        ruleIndex.add(transformers[i]->pattern(), i);
+    memo.clear();
+}
+
+//! \returns true once loadAll has loaded and indexed the transformers
+bool ExpTransformer::isLoaded() { return rulesLoaded.load(std::memory_order_acquire); }
+
+/// Apply the loaded transformers to \a p and its subexpressions. \pre isLoaded()
 SharedExp ExpTransformer::applyAllTo(const SharedExp &p, bool &bMod) {
-    for (auto &elem : cache)
-        if (*(elem)->getSubExp1() == *p)
-            return (elem)->getSubExp2()->clone();
+    assert(isLoaded());
+    auto mm = memo.find(p);
+    if (mm != memo.end()) {
+        bMod |= mm->second.modified;
+        return mm->second.result->clone();
+    }
 
     SharedExp e = p->clone();
     SharedExp subs[3];
     subs[0] = e->getSubExp1();
     subs[1] = e->getSubExp2();
     subs[2] = e->getSubExp3();
+    bool modified = false;
 
     for (int i = 0; i < 3; i++)
         if (subs[i]) {
@@ -56,27 +91,46 @@ SharedExp ExpTransformer::applyAllTo(const SharedExp &p, bool &bMod) {
                 e->setSubExp2(subs[i]);
             if (mod && i == 2)
                 e->setSubExp3(subs[i]);
-            bMod |= mod;
+            modified |= mod;
             //            if (mod) i--;
         }
 
 #if 0
     LOG << "applyAllTo called on " << e << "\n";
 #endif
-    bool mod;
-    // do {
-    mod = false;
-    for (auto &transformer : transformers) {
-        e = (transformer)->applyTo(e, mod);
-        bMod |= mod;
+    // Apply the transformers in order, as if each were tried in turn; only those whose pattern fits are tried, and
+    // the candidates are looked up again after a change
+    std::vector<size_t> candidates;
+    size_t next = 0;
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        ruleIndex.candidates(e, candidates);
+        for (auto cc = std::lower_bound(candidates.begin(), candidates.end(), next); cc != candidates.end(); ++cc) {
+            bool mod = false;
+            e = transformers[*cc]->applyTo(e, mod);
+            next = *cc + 1;
+            if (mod) {
+                modified = changed = true;
+                break;
+            }
+        }
     }
-    //} while (mod);
 
-    cache.push_back(Binary::get(opEquals, p->clone(), e->clone()));
+    bMod |= modified;
+    if (memo.size() >= MEMO_CAPACITY)
+        memo.clear();
+    Arena::Scope heap(nullptr); // The memo outlives the procedure being simplified
+    memo[p->clone()] = MemoEntry{e->clone(), modified};
     return e;
 }
 
+/// Load the transformers listed in transformations/exp.ts, and index them. Only the first call does anything
 void ExpTransformer::loadAll() {
+    std::call_once(loadOnce, load);
+}
+
+void ExpTransformer::load() {
     QDir transformations_dir = Boomerang::get()->getProgDir();
     if(!transformations_dir.cd("transformations")) {
         qDebug() << "Transformations directory does not exist";
@@ -110,4 +164,6 @@ void ExpTransformer::loadAll() {
         p->yyparse();
         ifs1.close();
     }
+    compileRules();
+    rulesLoaded.store(true, std::memory_order_release);
 }
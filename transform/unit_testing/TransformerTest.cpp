@@ -0,0 +1,133 @@
+/***************************************************************************/ /**
+  * \file       TransformerTest.cpp
+  * OVERVIEW:   Provides the implementation for the TransformerTest class, which
+  *                tests the expression transformers loaded from transformations/
+  ******************************************************************************/
+
+#include "TransformerTest.h"
+
+#include "transformer.h"
+#include "boomerang.h"
+#include "log.h"
+#include "exp.h"
+#include "operator.h"
+
+#include <QtCore/QDir>
+#include <QtCore/QProcessEnvironment>
+#include <QtCore/QTextStream>
+#include <QtCore/QDebug>
+
+static bool logset = false;
+static QString TEST_BASE;
+static QDir baseDir;
+
+void TransformerTest::initTestCase() {
+    if (!logset) {
+        TEST_BASE = QProcessEnvironment::systemEnvironment().value("BOOMERANG_TEST_BASE", "");
+        baseDir = QDir(TEST_BASE);
+        if (TEST_BASE.isEmpty()) {
+            qWarning() << "BOOMERANG_TEST_BASE environment variable not set, will assume '..', many test may fail";
+            TEST_BASE = "..";
+            baseDir = QDir("..");
+        }
+        logset = true;
+        Boomerang::get()->setProgPath(TEST_BASE);
+        Boomerang::get()->setPluginPath(TEST_BASE + "/out");
+        Boomerang::get()->setLogger(new NullLogger());
+        ExpTransformer::loadAll(); // transformations/exp.ts, and the .t files it lists
+    }
+}
+
+//! What ExpTransformer::applyAllTo did before the rule index: the subexpressions first, then every transformer in turn
+SharedExp TransformerTest::applyInTurn(const SharedExp &p, bool &bMod) {
+    SharedExp e = p->clone();
+    if (e->getSubExp1()) {
+        bool mod = false;
+        SharedExp sub = applyInTurn(e->getSubExp1(), mod);
+        if (mod)
+            e->setSubExp1(sub);
+        bMod |= mod;
+    }
+    if (e->getSubExp2()) {
+        bool mod = false;
+        SharedExp sub = applyInTurn(e->getSubExp2(), mod);
+        if (mod)
+            e->setSubExp2(sub);
+        bMod |= mod;
+    }
+    if (e->getSubExp3()) {
+        bool mod = false;
+        SharedExp sub = applyInTurn(e->getSubExp3(), mod);
+        if (mod)
+            e->setSubExp3(sub);
+        bMod |= mod;
+    }
+    for (ExpTransformer *t : ExpTransformer::transformers) {
+        bool mod = false;
+        e = t->applyTo(e, mod);
+        bMod |= mod;
+    }
+    return e;
+}
+
+/***************************************************************************/ /**
+  * \fn        TransformerTest::testIndexedMatchesInTurn
+  * OVERVIEW:        applyAllTo, which only tries the rules the index picks for each expression, gives the same
+  *                  results as trying every rule in turn
+  ******************************************************************************/
+void TransformerTest::testIndexedMatchesInTurn() {
+    QVERIFY(!ExpTransformer::transformers.empty());
+    SharedExp r24 = Location::regOf(24);
+    SharedExp r25 = Location::regOf(25);
+    SharedExp r28 = Location::regOf(28);
+    std::vector<SharedExp> exps = {
+        Binary::get(opPlus, Const::get(3), Const::get(4)),
+        Binary::get(opMinus, Const::get(3), Const::get(4)),
+        Unary::get(opNeg, Const::get(5)),
+        Binary::get(opPlus, r24->clone(), Const::get(0)),
+        Binary::get(opMinus, r24->clone(), Const::get(5)),
+        Binary::get(opMinus, r24->clone(), r24->clone()),
+        Binary::get(opPlus, Binary::get(opPlus, r24->clone(), Const::get(4)), Const::get(8)),
+        Binary::get(opMinus, Binary::get(opMult, r24->clone(), Const::get(4)), r24->clone()),
+        Binary::get(opPlus, r24->clone(), Binary::get(opMult, r24->clone(), Const::get(3))),
+        Binary::get(opMult, Binary::get(opMult, r25->clone(), Const::get(2)), Const::get(3)),
+        Binary::get(opBitAnd, r24->clone(), r24->clone()),
+        Binary::get(opBitXor, r24->clone(), r24->clone()),
+        Unary::get(opLNot, Binary::get(opEquals, r24->clone(), r25->clone())),
+        Unary::get(opLNot, Binary::get(opNotEqual, r24->clone(), r25->clone())),
+        Binary::get(opEquals, r24->clone(), r24->clone()),
+        Unary::get(opAddrOf, Location::memOf(r24->clone())),
+        Location::memOf(Unary::get(opAddrOf, r28->clone())),
+        Location::memOf(Binary::get(opMinus, Binary::get(opPlus, r28->clone(), Const::get(4)), Const::get(12))),
+        Binary::get(opMult, r24->clone(), r25->clone()),
+    };
+    for (const SharedExp &e : exps) {
+        bool indexedMod = false, inTurnMod = false;
+        SharedExp indexed = ExpTransformer::applyAllTo(e, indexedMod);
+        SharedExp inTurn = applyInTurn(e, inTurnMod);
+        QString msg;
+        QTextStream os(&msg);
+        os << e << ": indexed " << indexed << ", in turn " << inTurn;
+        os.flush();
+        QVERIFY2(*indexed == *inTurn, qPrintable(msg));
+        QCOMPARE(indexedMod, inTurnMod);
+        // Again, from the memo
+        indexedMod = false;
+        indexed = ExpTransformer::applyAllTo(e, indexedMod);
+        QVERIFY2(*indexed == *inTurn, qPrintable(msg));
+        QCOMPARE(indexedMod, inTurnMod);
+    }
+}
+
+/***************************************************************************/ /**
+  * \fn        TransformerTest::testLoadOnce
+  * OVERVIEW:        loadAll only loads the rules the first time; later calls (e.g. from each decompile) add nothing
+  ******************************************************************************/
+void TransformerTest::testLoadOnce() {
+    QVERIFY(ExpTransformer::isLoaded());
+    size_t loaded = ExpTransformer::transformers.size();
+    ExpTransformer::loadAll();
+    QCOMPARE(ExpTransformer::transformers.size(), loaded);
+}
+
+QTEST_MAIN(TransformerTest)
@@ -0,0 +1,15 @@
+#include <QtTest/QTest>
+
+#include <memory>
+
+class Exp;
+class TransformerTest : public QObject {
+    Q_OBJECT
+  private:
+    static std::shared_ptr<Exp> applyInTurn(const std::shared_ptr<Exp> &p, bool &bMod);
+
+  private slots:
+    void initTestCase();
+    void testIndexedMatchesInTurn();
+    void testLoadOnce();
+};
@@ -409,7 +409,7 @@ bool Constraints::solve(std::list<ConstraintMap> &solns) {
     return ret;
 }
 
-static int level = 0;
+static thread_local int level = 0;
 // Constraints up to but not including iterator it have been unified.
 // The current solution is soln
 // The set of all solutions is in solns
@@ -28,19 +28,31 @@
 #include <sstream>
 #include <cstring>
 #include <utility>
+#include <deque>
+#include <set>
+#include <map>
+#include <atomic>
 #include <QDebug>
 
-static int nextUnionNumber = 0;
-
 #define DFA_ITER_LIMIT 20
 
+static std::atomic<int> nextUnionNumber(0);
+
+//! The name of a new union member. Members are numbered across the whole program; with --threads, a number is only
+//! taken in the turn of the procedure in the serial order (see Prog::waitForSerialTurn), so it is the same as in a
+//! serial run.
+static QString newUnionMemberName() {
+    Prog::waitForSerialTurn();
+    return QString("x%1").arg(++nextUnionNumber);
+}
+
 // idx + K; leave idx wild
 static const Binary unscaledArrayPat(opPlus, Terminal::get(opWild), Terminal::get(opWildIntConst));
 
 static DFA_TypeRecovery s_type_recovery;
-static int dfa_progress = 0;
+static thread_local int dfa_progress = 0;
 
-void DFA_TypeRecovery::dumpResults(StatementList & stmts, int iter)
+void DFA_TypeRecovery::dumpResults(const std::vector<Instruction *> &stmts, int iter)
 {
     LOG << iter << " iterations\n";
     for (Instruction *s : stmts) {
@@ -169,6 +181,28 @@ void DFA_TypeRecovery::recoverFunctionTypes(Function *)
     assert(false);
 }
 
+/***************************************************************************/ /**
+  * \brief Run one step of type analysis on statement \a it
+  * \returns true if any type in the statement changed
+  ******************************************************************************/
+bool DFA_TypeRecovery::visitStatement(Instruction *it) {
+    if (++dfa_progress >= 2000) {
+        dfa_progress = 0;
+        LOG_STREAM() << "t";
+        LOG_STREAM().flush();
+    }
+    bool thisCh = false;
+    Instruction *before = nullptr;
+    if (DEBUG_TA)
+        before = it->clone();
+    it->dfaTypeAnalysis(thisCh);
+    if (thisCh && DEBUG_TA)
+        LOG << " caused change: FROM: " << before << "TO: \n" << it << "\n";
+    if (DEBUG_TA)
+        delete before;
+    return thisCh;
+}
+
 void DFA_TypeRecovery::dfaTypeAnalysis(Function * f) {
     assert(not f->isLib());
     UserProc *proc = static_cast<UserProc *>(f);
@@ -178,37 +212,69 @@ void DFA_TypeRecovery::dfaTypeAnalysis(Function * f) {
     // First use the type information from the signature. Sometimes needed to split variables (e.g. argc as a
     // int and char* in sparc/switch_gcc)
     bool ch = proc->getSignature()->dfaTypeAnalysis(cfg);
-    StatementList stmts;
-    proc->getStatements(stmts);
+    auto index = proc->getStatementIndex();
+    const std::vector<Instruction *> &stmts(*index);
 
-    int iter;
-    for (iter = 1; iter <= DFA_ITER_LIMIT; ++iter) {
+    // Sparse worklist solver. A statement's types only depend on the statements that define what it uses, and on the
+    // statements that use what it defines (types flow both ways), so when a statement changes only those neighbours
+    // need another look. The SSA def-use chains give the neighbours directly.
+    std::map<Instruction *, std::vector<Instruction *>> neighbours;
+    for (Instruction *s : stmts) {
+        LocationSet used;
+        s->addUsedLocs(used);
+        for (const SharedExp &u : used) {
+            if (!u->isSubscript())
+                continue;
+            Instruction *def = u->access<RefExp>()->getDef();
+            if (def == nullptr || def == s)
+                continue;
+            neighbours[def].push_back(s);
+            neighbours[s].push_back(def);
+        }
+    }
+
+    std::deque<Instruction *> worklist(stmts.begin(), stmts.end());
+    std::set<Instruction *> queued(stmts.begin(), stmts.end());
+    const size_t visitLimit = DFA_ITER_LIMIT * (stmts.size() + 1);
+    size_t visits = 0;
+    int iter = 0; // Number of full sweeps
+    while (visits < visitLimit) {
+        // Run the worklist dry
+        while (!worklist.empty() && visits < visitLimit) {
+            Instruction *it = worklist.front();
+            worklist.pop_front();
+            queued.erase(it);
+            ++visits;
+            if (visitStatement(it)) {
+                for (Instruction *n : neighbours[it])
+                    if (queued.insert(n).second)
+                        worklist.push_back(n);
+            }
+        }
+        if (!worklist.empty())
+            break;
+        // The chains do not capture everything (e.g. call collectors and signature types), so confirm the fixed
+        // point with a full sweep, as the old round robin algorithm did, and go round again if it is not one.
+        ++iter;
         ch = false;
         for (Instruction *it : stmts) {
-            if (++dfa_progress >= 2000) {
-                dfa_progress = 0;
-                LOG_STREAM() << "t";
-                LOG_STREAM().flush();
-            }
-            bool thisCh = false;
-            Instruction *before = nullptr;
-            if (DEBUG_TA)
-                before = it->clone();
-            it->dfaTypeAnalysis(thisCh);
-            if (thisCh) {
+            ++visits;
+            if (visitStatement(it)) {
                 ch = true;
-                if (DEBUG_TA)
-                    LOG << " caused change: FROM: " << before << "TO: \n" << it << "\n";
+                if (queued.insert(it).second)
+                    worklist.push_back(it);
+                for (Instruction *n : neighbours[it])
+                    if (queued.insert(n).second)
+                        worklist.push_back(n);
             }
-            if (DEBUG_TA)
-                delete before;
         }
         if (!ch)
-            // No more changes: round robin algorithm terminates
             break;
     }
-    if (ch)
+    if (ch || !worklist.empty())
         LOG << "### WARNING: iteration limit exceeded for dfaTypeAnalysis of procedure " << proc->getName() << " ###\n";
+    LOG_VERBOSE(1) << "dfa type analysis of " << proc->getName() << ": " << (int)visits << " statement visits for "
+                   << (int)stmts.size() << " statements, " << iter << " full sweeps\n";
 
     if (DEBUG_TA) {
         LOG << "\n ### results for data flow based type analysis for " << proc->getName() << " ###\n";
@@ -737,7 +803,7 @@ SharedType UnionType::meetWith(SharedType other, bool &ch, bool bHighestPtr) con
         LOG_STREAM() << "createUnion breakpokint\n"; // Note: you need two breakpoints (also in Type::createUnion)
     LOG_STREAM() << "  " << ++unionCount << " Created union from " << getCtype() << " and " << other->getCtype();
 #endif
-    ((UnionType *)this)->addType(other->clone(), QString("x%1").arg(++nextUnionNumber));
+    ((UnionType *)this)->addType(other->clone(), newUnionMemberName());
 #if PRINT_UNION
     LOG_STREAM() << ", result is " << getCtype() << "\n";
 #endif
@@ -836,16 +902,13 @@ SharedType Type::createUnion(SharedType other, bool &ch, bool bHighestPtr /* = f
             return other->clone();
     }
 
-    char name[20];
 #if PRINT_UNION
     if (unionCount == 999)                        // Adjust the count to catch the one you want
         LOG_STREAM() << "createUnion breakpokint\n"; // Note: you need two breakpoints (also in UnionType::meetWith)
 #endif
-    sprintf(name, "x%d", ++nextUnionNumber);
     auto u = std::make_shared<UnionType>();
-    u->addType(this->clone(), name);
-    sprintf(name, "x%d", ++nextUnionNumber);
-    u->addType(other->clone(), name);
+    u->addType(this->clone(), newUnionMemberName());
+    u->addType(other->clone(), newUnionMemberName());
     ch = true;
 #if PRINT_UNION
     LOG_STREAM() << "  " << ++unionCount << " Created union from " << getCtype() << " and " << other->getCtype()
@@ -1737,14 +1800,12 @@ SharedType Type::dereference() {
 // (note: should probably be bottom)
 SharedType UnionType::dereferenceUnion() {
     auto ret = UnionType::get();
-    char name[20];
     UnionEntrySet::iterator it;
     for (it = li.begin(); it != li.end(); ++it) {
         SharedType elem = it->type->dereference();
         if (elem->resolvesToVoid())
             return elem; // Return void for the whole thing
-        sprintf(name, "x%d", ++nextUnionNumber);
-        ret->addType(elem->clone(), name);
+        ret->addType(elem->clone(), newUnionMemberName());
     }
     return ret;
 }
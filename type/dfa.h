@@ -1,5 +1,8 @@
 #pragma once
 #include "TypeRecovery.h"
+
+#include <vector>
+
 class Signature;
 class Cfg;
 class StatementList;
@@ -13,8 +16,9 @@ public:
     bool dfaTypeAnalysis(Signature * sig, Cfg * cfg);
     bool dfaTypeAnalysis(Instruction * i);
 protected:
-    void dumpResults(StatementList & stmts, int iter);
+    void dumpResults(const std::vector<Instruction *> &stmts, int iter);
 private:
+    bool visitStatement(Instruction *it);
     void dfa_analyze_scaled_array_ref(Instruction * s);
     void dfa_analyze_implict_assigns(Instruction * s);
 };
@@ -368,13 +368,14 @@ bool FuncType::operator==(const Type &other) const {
     return *signature == *((FuncType &)other).signature;
 }
 
-static int pointerCompareNest = 0;
+static thread_local int pointerCompareNest = 0; // Per thread, as procedures can be decompiled in parallel
 bool PointerType::operator==(const Type &other) const {
     //    return other.isPointer() && (*points_to == *((PointerType&)other).points_to);
     if (!other.isPointer())
         return false;
     if (++pointerCompareNest >= 20) {
         LOG_STREAM() << "PointerType operator== nesting depth exceeded!\n";
+        pointerCompareNest--;
         return true;
     }
     bool ret = (*points_to == *((PointerType &)other).points_to);
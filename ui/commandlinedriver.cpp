@@ -1,5 +1,6 @@
 #include <QtCore>
 #include <cstdio>
+#include <algorithm>
 
 #include "config.h"
 #include "boomerang.h"
@@ -27,9 +28,15 @@ static void help() {
     q_cout << "  -t               : Trace (print address of) every instruction decoded\n";
     q_cout << "  -Tc              : Use old constraint-based type analysis\n";
     q_cout << "  -Td              : Use data-flow-based type analysis\n";
-    q_cout << "  -LD              : Load before decompile (<program> becomes xml input file)\n";
-    q_cout << "  -SD              : Save before decompile\n";
+    q_cout << "  -LD              : Load before decompile (<program> becomes project file input)\n";
+    q_cout << "  -SD              : Save before decompile (to <output>/<name>/<name>.bpj)\n";
     q_cout << "  -a               : Assume ABI compliance\n";
+    q_cout << "  --threads <num>  : Decompile and generate code for independent procedures on <num> threads\n";
+    q_cout << "  --cache <dir>    : Reuse procedures that did not change since a run with the same <dir>\n";
+    q_cout << "  --stats=json     : Write per procedure and per phase statistics to <name>.stats.json\n";
+    q_cout << "  --arena          : Allocate the intermediate representation of each procedure from an arena\n";
+    q_cout << "  --stream         : Keep only the code of each procedure once it is generated (less memory)\n";
+    q_cout << "  --rules          : Also simplify expressions with the rules in transformations/\n";
     q_cout << "  -W               : Windows specific decompilation mode (requires pdb information)\n";
     //    q_cout << "  -pa              : only propagate if can propagate to all\n";
     q_cout << "Output\n";
@@ -174,7 +181,32 @@ int CommandlineDriver::applyCommandline(const QStringList &args) {
                 boom.decodeThruIndCall = true; // -ic;
             break;
         case '-':
-            break; // No effect: ignored
+            if (arg == "--threads") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.numThreads = std::max(1, args[i].toInt());
+            } else if (arg == "--cache") {
+                if (++i == args.size()) {
+                    usage();
+                    return 1;
+                }
+                boom.cacheDir = args[i];
+            } else if (arg == "--arena") {
+                boom.procArenas = true;
+            } else if (arg == "--stream") {
+                boom.streamProcs = true;
+            } else if (arg == "--rules") {
+                boom.useRules = true;
+            } else if (arg.startsWith("--stats=")) {
+                boom.statsFormat = arg.mid(8);
+                if (boom.statsFormat != "json") {
+                    usage();
+                    return 1;
+                }
+            }
+            break; // Otherwise no effect: ignored
         case 'L':
             if (arg[2] == 'D')
                 boom.loadBeforeDecompile = true;
@@ -320,6 +352,11 @@ int CommandlineDriver::applyCommandline(const QStringList &args) {
             help();
         }
     }
+    if (boom.numThreads > 1 && (kmd || boom.stopAtDebugPoints)) {
+        // Both read commands from stdin while a procedure is being decompiled, which needs a single worker
+        LOG_STREAM(LL_Error) << "--threads can not be used together with -k or -ds\n";
+        return 1;
+    }
     if (kmd)
         return console();
 